@@ -0,0 +1,378 @@
+#ifndef AVL_AUGMENTED_H
+#define AVL_AUGMENTED_H
+
+#include <limits>
+#include <utility>
+#include <vector>
+#include "avlbst.h"
+
+/**
+* Aggregate policies for AugmentedAVLTree. A policy supplies the aggregate
+* type, an identity element, lift() to turn one node's key and value into an
+* aggregate and an associative combine(). combine() does not have to be
+* commutative: arguments are always passed in key order. The policies here
+* aggregate values and ignore the key; IntervalTree's looks at keys only.
+*/
+template <class V>
+struct SumAggregate
+{
+    typedef V type;
+    static type identity() { return V(); }
+    template<class K>
+    static type lift(const K&, const V& v) { return v; }
+    static type combine(const type& a, const type& b) { return a + b; }
+};
+
+template <class V>
+struct MinAggregate
+{
+    typedef V type;
+    static type identity() { return std::numeric_limits<V>::max(); }
+    template<class K>
+    static type lift(const K&, const V& v) { return v; }
+    static type combine(const type& a, const type& b) { return (b < a) ? b : a; }
+};
+
+template <class V>
+struct MaxAggregate
+{
+    typedef V type;
+    static type identity() { return std::numeric_limits<V>::lowest(); }
+    template<class K>
+    static type lift(const K&, const V& v) { return v; }
+    static type combine(const type& a, const type& b) { return (a < b) ? b : a; }
+};
+
+/**
+* An AVLNode that also stores the aggregate of every item in its subtree.
+*/
+template <typename Key, typename Value, typename Agg>
+class AugmentedAVLNode : public AVLNode<Key, Value>
+{
+public:
+    AugmentedAVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
+    virtual ~AugmentedAVLNode();
+
+    const typename Agg::type& getAggregate() const;
+    void recompute();
+
+protected:
+    template <class K, class V, class A> friend class AugmentedAVLTree;
+    typename Agg::type aggregate_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the AugmentedAVLNode class.
+  -------------------------------------------------
+*/
+
+template<class Key, class Value, class Agg>
+AugmentedAVLNode<Key, Value, Agg>::AugmentedAVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent) :
+    AVLNode<Key, Value>(key, value, parent), aggregate_(Agg::lift(key, value))
+{
+
+}
+
+template<class Key, class Value, class Agg>
+AugmentedAVLNode<Key, Value, Agg>::~AugmentedAVLNode()
+{
+
+}
+
+template<class Key, class Value, class Agg>
+const typename Agg::type& AugmentedAVLNode<Key, Value, Agg>::getAggregate() const
+{
+    return aggregate_;
+}
+
+/**
+* Recomputes this node's aggregate from its item and its children's
+* aggregates, which must already be up to date.
+*/
+template<class Key, class Value, class Agg>
+void AugmentedAVLNode<Key, Value, Agg>::recompute()
+{
+    typename Agg::type result = Agg::lift(this->item_.first, this->item_.second);
+    if (this->left_ != nullptr)
+    {
+        result = Agg::combine(static_cast<AugmentedAVLNode*>(this->left_)->aggregate_, result);
+    }
+    if (this->right_ != nullptr)
+    {
+        result = Agg::combine(result, static_cast<AugmentedAVLNode*>(this->right_)->aggregate_);
+    }
+    aggregate_ = result;
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the AugmentedAVLNode class.
+  -----------------------------------------------
+*/
+
+/**
+* An AVLTree that keeps Agg (see SumAggregate above) of the items in every
+* subtree, so the aggregate over any key range takes O(log n) instead of a
+* walk over the range.
+*
+* Values must only be changed through insert(), which keeps the aggregates
+* current; operator[] is read-only here, and writing through an iterator's
+* ->second leaves stale aggregates behind.
+*/
+template <class Key, class Value, class Agg>
+class AugmentedAVLTree : public AVLTree<Key, Value>
+{
+public:
+    AugmentedAVLTree();
+    AugmentedAVLTree(const AugmentedAVLTree& other);
+    AugmentedAVLTree(AugmentedAVLTree&& other) noexcept;
+    AugmentedAVLTree& operator=(const AugmentedAVLTree& other);
+    AugmentedAVLTree& operator=(AugmentedAVLTree&& other) noexcept;
+    void swap(AugmentedAVLTree& other) noexcept;
+
+    typename Agg::type aggregate() const;
+    typename Agg::type aggregate(const Key& lo, const Key& hi) const;
+    Value const & operator[](const Key& key) const;
+
+protected:
+    typedef AugmentedAVLNode<Key, Value, Agg> AugNode;
+
+    virtual AugNode* createNode(const Key& key, const Value& value, Node<Key, Value>* parent) override;
+    virtual AugNode* cloneNode(const Node<Key, Value>* src, Node<Key, Value>* parent) const override;
+    virtual void nodeSwap(AVLNode<Key, Value>* n1, AVLNode<Key, Value>* n2) override;
+    virtual void rotateRight(AVLNode<Key, Value>* n) override;
+    virtual void rotateLeft(AVLNode<Key, Value>* n) override;
+    virtual void refreshPath(AVLNode<Key, Value>* n) override;
+    virtual void refreshNode(AVLNode<Key, Value>* n) override;
+    virtual void refreshAll() override;
+    static typename Agg::type aggregateOf(AVLNode<Key, Value>* n);
+};
+
+template<class Key, class Value, class Agg>
+AugmentedAVLTree<Key, Value, Agg>::AugmentedAVLTree() :
+    AVLTree<Key, Value>()
+{
+
+}
+
+template<class Key, class Value, class Agg>
+AugmentedAVLTree<Key, Value, Agg>::AugmentedAVLTree(const AugmentedAVLTree<Key, Value, Agg>& other) :
+    AVLTree<Key, Value>()
+{
+    this->copyFrom(other);
+}
+
+template<class Key, class Value, class Agg>
+AugmentedAVLTree<Key, Value, Agg>::AugmentedAVLTree(AugmentedAVLTree<Key, Value, Agg>&& other) noexcept :
+    AVLTree<Key, Value>()
+{
+    swap(other);
+}
+
+template<class Key, class Value, class Agg>
+AugmentedAVLTree<Key, Value, Agg>& AugmentedAVLTree<Key, Value, Agg>::operator=(const AugmentedAVLTree<Key, Value, Agg>& other)
+{
+    BinarySearchTree<Key, Value>::operator=(other);
+    return *this;
+}
+
+template<class Key, class Value, class Agg>
+AugmentedAVLTree<Key, Value, Agg>& AugmentedAVLTree<Key, Value, Agg>::operator=(AugmentedAVLTree<Key, Value, Agg>&& other) noexcept
+{
+    if (this != &other)
+    {
+        this->clear();
+        swap(other);
+    }
+    return *this;
+}
+
+template<class Key, class Value, class Agg>
+void AugmentedAVLTree<Key, Value, Agg>::swap(AugmentedAVLTree<Key, Value, Agg>& other) noexcept
+{
+    this->swapTree(other);
+}
+
+/**
+* Aggregate of every value in the tree, in O(1).
+*/
+template<class Key, class Value, class Agg>
+typename Agg::type AugmentedAVLTree<Key, Value, Agg>::aggregate() const
+{
+    return aggregateOf(static_cast<AVLNode<Key, Value>*>(this->root_));
+}
+
+/**
+* Aggregate of the values whose keys lie in the closed range [lo, hi], or
+* Agg::identity() if there are none. O(log n): only the two search paths to
+* lo and hi are walked, whole subtrees in between are taken from their
+* stored aggregates.
+*/
+template<class Key, class Value, class Agg>
+typename Agg::type AugmentedAVLTree<Key, Value, Agg>::aggregate(const Key& lo, const Key& hi) const
+{
+    if (hi < lo)
+    {
+        return Agg::identity();
+    }
+
+    //find the topmost node inside the range, where the paths to lo and hi split
+    AVLNode<Key, Value>* split = static_cast<AVLNode<Key, Value>*>(this->root_);
+    while (split != nullptr && (split->getKey() < lo || hi < split->getKey()))
+    {
+        split = (split->getKey() < lo) ? split->getRight() : split->getLeft();
+    }
+    if (split == nullptr)
+    {
+        return Agg::identity();
+    }
+
+    //left of the split: every node >= lo is in range together with its right subtree
+    typename Agg::type leftPart = Agg::identity();
+    for (AVLNode<Key, Value>* curr = split->getLeft(); curr != nullptr; )
+    {
+        if (curr->getKey() < lo)
+        {
+            curr = curr->getRight();
+        }
+        else
+        {
+            leftPart = Agg::combine(Agg::lift(curr->getKey(), curr->getValue()), Agg::combine(aggregateOf(curr->getRight()), leftPart));
+            curr = curr->getLeft();
+        }
+    }
+
+    //right of the split: mirror image, every node <= hi comes with its left subtree
+    typename Agg::type rightPart = Agg::identity();
+    for (AVLNode<Key, Value>* curr = split->getRight(); curr != nullptr; )
+    {
+        if (hi < curr->getKey())
+        {
+            curr = curr->getLeft();
+        }
+        else
+        {
+            rightPart = Agg::combine(rightPart, Agg::combine(aggregateOf(curr->getLeft()), Agg::lift(curr->getKey(), curr->getValue())));
+            curr = curr->getRight();
+        }
+    }
+
+    return Agg::combine(leftPart, Agg::combine(Agg::lift(split->getKey(), split->getValue()), rightPart));
+}
+
+/**
+* Read-only lookup; use insert() to change a value.
+*/
+template<class Key, class Value, class Agg>
+Value const & AugmentedAVLTree<Key, Value, Agg>::operator[](const Key& key) const
+{
+    return BinarySearchTree<Key, Value>::operator[](key);
+}
+
+template<class Key, class Value, class Agg>
+AugmentedAVLNode<Key, Value, Agg>* AugmentedAVLTree<Key, Value, Agg>::createNode(const Key& key, const Value& value, Node<Key, Value>* parent)
+{
+    return new AugNode(key, value, static_cast<AVLNode<Key, Value>*>(parent));
+}
+
+/**
+* Copies src's key, value, balance factor and aggregate. The aggregate
+* stays valid because the copy gets the same subtree shape.
+*/
+template<class Key, class Value, class Agg>
+AugmentedAVLNode<Key, Value, Agg>* AugmentedAVLTree<Key, Value, Agg>::cloneNode(const Node<Key, Value>* src, Node<Key, Value>* parent) const
+{
+    const AugNode* from = static_cast<const AugNode*>(src);
+    AugNode* copy = new AugNode(from->getKey(), from->getValue(), static_cast<AVLNode<Key, Value>*>(parent));
+    copy->setBalance(from->getBalance());
+    copy->aggregate_ = from->aggregate_;
+    return copy;
+}
+
+/**
+* Both nodes' ancestors now see a different value at the swapped spots.
+*/
+template<class Key, class Value, class Agg>
+void AugmentedAVLTree<Key, Value, Agg>::nodeSwap(AVLNode<Key, Value>* n1, AVLNode<Key, Value>* n2)
+{
+    AVLTree<Key, Value>::nodeSwap(n1, n2);
+    refreshPath(n1);
+    refreshPath(n2);
+}
+
+/**
+* After the rotation n sits below its old child, so n is recomputed first.
+*/
+template<class Key, class Value, class Agg>
+void AugmentedAVLTree<Key, Value, Agg>::rotateRight(AVLNode<Key, Value>* n)
+{
+    AVLTree<Key, Value>::rotateRight(n);
+    static_cast<AugNode*>(n)->recompute();
+    static_cast<AugNode*>(n->getParent())->recompute();
+}
+
+template<class Key, class Value, class Agg>
+void AugmentedAVLTree<Key, Value, Agg>::rotateLeft(AVLNode<Key, Value>* n)
+{
+    AVLTree<Key, Value>::rotateLeft(n);
+    static_cast<AugNode*>(n)->recompute();
+    static_cast<AugNode*>(n->getParent())->recompute();
+}
+
+template<class Key, class Value, class Agg>
+void AugmentedAVLTree<Key, Value, Agg>::refreshPath(AVLNode<Key, Value>* n)
+{
+    for (; n != nullptr; n = n->getParent())
+    {
+        static_cast<AugNode*>(n)->recompute();
+    }
+}
+
+template<class Key, class Value, class Agg>
+void AugmentedAVLTree<Key, Value, Agg>::refreshNode(AVLNode<Key, Value>* n)
+{
+    static_cast<AugNode*>(n)->recompute();
+}
+
+/**
+* Recomputes every aggregate in postorder, O(n).
+*/
+template<class Key, class Value, class Agg>
+void AugmentedAVLTree<Key, Value, Agg>::refreshAll()
+{
+    std::vector<AVLNode<Key, Value>*> order;
+    std::vector<AVLNode<Key, Value>*> stack;
+    if (this->root_ != nullptr)
+    {
+        stack.push_back(static_cast<AVLNode<Key, Value>*>(this->root_));
+    }
+
+    //reverse of a root, right, left preorder is a left, right, root postorder
+    while (!stack.empty())
+    {
+        AVLNode<Key, Value>* curr = stack.back();
+        stack.pop_back();
+        order.push_back(curr);
+        if (curr->getLeft() != nullptr)
+        {
+            stack.push_back(curr->getLeft());
+        }
+        if (curr->getRight() != nullptr)
+        {
+            stack.push_back(curr->getRight());
+        }
+    }
+    for (size_t i = order.size(); i-- > 0; )
+    {
+        static_cast<AugNode*>(order[i])->recompute();
+    }
+}
+
+template<class Key, class Value, class Agg>
+typename Agg::type AugmentedAVLTree<Key, Value, Agg>::aggregateOf(AVLNode<Key, Value>* n)
+{
+    return (n == nullptr) ? Agg::identity() : static_cast<AugNode*>(n)->getAggregate();
+}
+
+#endif
@@ -0,0 +1,386 @@
+#ifndef AVL_COMPACT_H
+#define AVL_COMPACT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+#include "avlbst.h"
+
+/**
+* An AVLNode that knows which arena chunk holds it (0: it came from new).
+* The id fits in the padding after balance_, so it costs no memory.
+*/
+template <typename Key, typename Value>
+class CompactAVLNode : public AVLNode<Key, Value>
+{
+public:
+    CompactAVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent, uint32_t chunk);
+    virtual ~CompactAVLNode();
+
+    uint32_t getChunk() const;
+
+protected:
+    uint32_t chunk_;
+};
+
+template<class Key, class Value>
+CompactAVLNode<Key, Value>::CompactAVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent, uint32_t chunk) :
+    AVLNode<Key, Value>(key, value, parent), chunk_(chunk)
+{
+
+}
+
+template<class Key, class Value>
+CompactAVLNode<Key, Value>::~CompactAVLNode()
+{
+
+}
+
+template<class Key, class Value>
+uint32_t CompactAVLNode<Key, Value>::getChunk() const
+{
+    return chunk_;
+}
+
+/**
+* An AVLTree that can move its nodes back together after long runs of
+* inserts and removes have scattered them over the heap.
+*
+* A compaction pass walks the keys in order and moves every node into the
+* next free slot of an arena made of large chunks, fixing up the links of
+* its parent and children, so neighbouring keys end up neighbours in
+* memory. compactStep() moves at most a given number of nodes and returns,
+* so a pass can be spread over quiet periods; the tree is fully usable
+* between steps. The pass resumes after the last node it moved, a node
+* that removals keep valid. New nodes still come from new until the next
+* pass picks them up, and a chunk is freed as soon as its last node moves
+* out or is removed.
+*
+* Moving a node invalidates iterators and pointers to it, as erase() does.
+*/
+template <class Key, class Value>
+class CompactingAVLTree : public AVLTree<Key, Value>
+{
+public:
+    CompactingAVLTree();
+    CompactingAVLTree(const CompactingAVLTree& other);
+    CompactingAVLTree(CompactingAVLTree&& other) noexcept;
+    virtual ~CompactingAVLTree();
+    CompactingAVLTree& operator=(const CompactingAVLTree& other);
+    CompactingAVLTree& operator=(CompactingAVLTree&& other) noexcept;
+    void swap(CompactingAVLTree& other) noexcept;
+
+    void compact();
+    bool compactStep(size_t maxNodes);
+    bool compacting() const;
+
+protected:
+    virtual CompactAVLNode<Key, Value>* createNode(const Key& key, const Value& value, Node<Key, Value>* parent) override;
+    virtual CompactAVLNode<Key, Value>* cloneNode(const Node<Key, Value>* src, Node<Key, Value>* parent) const override;
+    virtual void removeNode(Node<Key, Value>* node) override;
+    virtual void destroyNode(Node<Key, Value>* node) override;
+    virtual void swapTree(BinarySearchTree<Key, Value>& other) noexcept override;
+    CompactAVLNode<Key, Value>* relocate(CompactAVLNode<Key, Value>* node);
+    void releaseChunk(uint32_t id);
+    void finishPass();
+
+    static const size_t CHUNK_NODES = 4096;
+
+    struct Chunk
+    {
+        void* storage;  // nullptr once released
+        size_t used;    // slots handed out, never reused within a chunk
+        size_t live;    // slots still holding a node
+    };
+
+    std::vector<Chunk> chunks_;         // node chunk ids are indexes + 1
+    std::vector<uint32_t> freeChunks_;  // released entries of chunks_
+    uint32_t fillChunk_;                // chunk the current pass moves nodes into, 0 for none
+    bool inPass_;
+    CompactAVLNode<Key, Value>* cursor_;    // last node the pass moved, nullptr to start at the smallest
+};
+
+template<class Key, class Value>
+CompactingAVLTree<Key, Value>::CompactingAVLTree() :
+    AVLTree<Key, Value>(), fillChunk_(0), inPass_(false), cursor_(nullptr)
+{
+
+}
+
+/**
+* The copy's nodes come from new; its first pass packs them.
+*/
+template<class Key, class Value>
+CompactingAVLTree<Key, Value>::CompactingAVLTree(const CompactingAVLTree<Key, Value>& other) :
+    AVLTree<Key, Value>(), fillChunk_(0), inPass_(false), cursor_(nullptr)
+{
+    this->copyFrom(other);
+}
+
+template<class Key, class Value>
+CompactingAVLTree<Key, Value>::CompactingAVLTree(CompactingAVLTree<Key, Value>&& other) noexcept :
+    AVLTree<Key, Value>(), fillChunk_(0), inPass_(false), cursor_(nullptr)
+{
+    swap(other);
+}
+
+/**
+* Clears while this is still a CompactingAVLTree, since the base
+* destructor would delete arena nodes as if they came from new.
+*/
+template<class Key, class Value>
+CompactingAVLTree<Key, Value>::~CompactingAVLTree()
+{
+    this->clear();
+    for (size_t i = 0; i < chunks_.size(); ++i)
+    {
+        ::operator delete(chunks_[i].storage);
+    }
+}
+
+template<class Key, class Value>
+CompactingAVLTree<Key, Value>& CompactingAVLTree<Key, Value>::operator=(const CompactingAVLTree<Key, Value>& other)
+{
+    if (this != &other)
+    {
+        BinarySearchTree<Key, Value>::operator=(other);
+    }
+    return *this;
+}
+
+template<class Key, class Value>
+CompactingAVLTree<Key, Value>& CompactingAVLTree<Key, Value>::operator=(CompactingAVLTree<Key, Value>&& other) noexcept
+{
+    if (this != &other)
+    {
+        this->clear();
+        swap(other);
+    }
+    return *this;
+}
+
+template<class Key, class Value>
+void CompactingAVLTree<Key, Value>::swap(CompactingAVLTree<Key, Value>& other) noexcept
+{
+    this->swapTree(other);
+}
+
+/**
+* O(1) exchange of two trees, arenas and pass state included, so the
+* chunks go wherever their nodes go.
+*/
+template<class Key, class Value>
+void CompactingAVLTree<Key, Value>::swapTree(BinarySearchTree<Key, Value>& other) noexcept
+{
+    CompactingAVLTree<Key, Value>& that = static_cast<CompactingAVLTree<Key, Value>&>(other);
+    AVLTree<Key, Value>::swapTree(that);
+    chunks_.swap(that.chunks_);
+    freeChunks_.swap(that.freeChunks_);
+    std::swap(fillChunk_, that.fillChunk_);
+    std::swap(inPass_, that.inPass_);
+    std::swap(cursor_, that.cursor_);
+}
+
+/**
+* Runs a whole compaction pass (finishing the current one if a pass is
+* under way).
+*/
+template<class Key, class Value>
+void CompactingAVLTree<Key, Value>::compact()
+{
+    while (!compactStep((size_t)-1))
+    {
+    }
+}
+
+/**
+* Moves up to maxNodes more nodes into place, starting a new pass if none
+* is under way. Returns true once the pass has reached the largest key.
+*/
+template<class Key, class Value>
+bool CompactingAVLTree<Key, Value>::compactStep(size_t maxNodes)
+{
+    if (!inPass_)
+    {
+        finishPass();
+        inPass_ = true;
+    }
+
+    for (size_t moved = 0; moved < maxNodes; ++moved)
+    {
+        Node<Key, Value>* next = (cursor_ != nullptr) ? this->successor(cursor_) : this->getSmallestNode();
+        if (next == nullptr)
+        {
+            finishPass();
+            return true;
+        }
+        cursor_ = relocate(static_cast<CompactAVLNode<Key, Value>*>(next));
+    }
+    return false;
+}
+
+/**
+* True while a pass started by compactStep() has not finished.
+*/
+template<class Key, class Value>
+bool CompactingAVLTree<Key, Value>::compacting() const
+{
+    return inPass_;
+}
+
+template<class Key, class Value>
+CompactAVLNode<Key, Value>* CompactingAVLTree<Key, Value>::createNode(const Key& key, const Value& value, Node<Key, Value>* parent)
+{
+    return new CompactAVLNode<Key, Value>(key, value, static_cast<AVLNode<Key, Value>*>(parent), 0);
+}
+
+/**
+* Copies src and its balance factor into a node from new.
+*/
+template<class Key, class Value>
+CompactAVLNode<Key, Value>* CompactingAVLTree<Key, Value>::cloneNode(const Node<Key, Value>* src, Node<Key, Value>* parent) const
+{
+    const AVLNode<Key, Value>* from = static_cast<const AVLNode<Key, Value>*>(src);
+    CompactAVLNode<Key, Value>* copy = new CompactAVLNode<Key, Value>(from->getKey(), from->getValue(), static_cast<AVLNode<Key, Value>*>(parent), 0);
+    copy->setBalance(from->getBalance());
+    return copy;
+}
+
+/**
+* Keeps the pass cursor valid: if the last moved node goes, the pass
+* resumes after its predecessor instead.
+*/
+template<class Key, class Value>
+void CompactingAVLTree<Key, Value>::removeNode(Node<Key, Value>* node)
+{
+    if (node != nullptr && node == cursor_)
+    {
+        cursor_ = static_cast<CompactAVLNode<Key, Value>*>(this->predecessor(node));
+    }
+    AVLTree<Key, Value>::removeNode(node);
+}
+
+/**
+* Frees a node from new with delete and an arena node in place, releasing
+* its chunk once empty. A cursor freed some other way (apply_batch(),
+* clear()) ends the pass.
+*/
+template<class Key, class Value>
+void CompactingAVLTree<Key, Value>::destroyNode(Node<Key, Value>* node)
+{
+    CompactAVLNode<Key, Value>* n = static_cast<CompactAVLNode<Key, Value>*>(node);
+    if (n == cursor_)
+    {
+        cursor_ = nullptr;
+        inPass_ = false;
+    }
+
+    uint32_t id = n->getChunk();
+    if (id == 0)
+    {
+        delete n;
+        return;
+    }
+    n->~CompactAVLNode<Key, Value>();
+    if (--chunks_[id - 1].live == 0 && id != fillChunk_)
+    {
+        releaseChunk(id);
+    }
+}
+
+/**
+* Moves node into the next arena slot and points its parent, children,
+* the root and the finger at the new copy. Returns the copy.
+*/
+template<class Key, class Value>
+CompactAVLNode<Key, Value>* CompactingAVLTree<Key, Value>::relocate(CompactAVLNode<Key, Value>* node)
+{
+    if (fillChunk_ == 0 || chunks_[fillChunk_ - 1].used == CHUNK_NODES)
+    {
+        Chunk fresh = { ::operator new(CHUNK_NODES * sizeof(CompactAVLNode<Key, Value>)), 0, 0 };
+        if (fillChunk_ != 0 && chunks_[fillChunk_ - 1].live == 0)
+        {
+            releaseChunk(fillChunk_);
+        }
+        if (!freeChunks_.empty())
+        {
+            fillChunk_ = freeChunks_.back();
+            freeChunks_.pop_back();
+            chunks_[fillChunk_ - 1] = fresh;
+        }
+        else
+        {
+            chunks_.push_back(fresh);
+            fillChunk_ = (uint32_t)chunks_.size();
+        }
+    }
+
+    Chunk& chunk = chunks_[fillChunk_ - 1];
+    void* slot = static_cast<char*>(chunk.storage) + chunk.used * sizeof(CompactAVLNode<Key, Value>);
+    CompactAVLNode<Key, Value>* copy = new (slot) CompactAVLNode<Key, Value>(node->getKey(), node->getValue(), node->getParent(), fillChunk_);
+    ++chunk.used;
+    ++chunk.live;
+
+    copy->setBalance(node->getBalance());
+    copy->setLeft(node->getLeft());
+    copy->setRight(node->getRight());
+
+    AVLNode<Key, Value>* parent = node->getParent();
+    if (parent == nullptr)
+    {
+        this->root_ = copy;
+    }
+    else if (parent->getLeft() == node)
+    {
+        parent->setLeft(copy);
+    }
+    else
+    {
+        parent->setRight(copy);
+    }
+    if (copy->getLeft() != nullptr)
+    {
+        copy->getLeft()->setParent(copy);
+    }
+    if (copy->getRight() != nullptr)
+    {
+        copy->getRight()->setParent(copy);
+    }
+    if (this->finger_ == node)
+    {
+        this->finger_ = copy;
+    }
+
+    destroyNode(node);
+    return copy;
+}
+
+template<class Key, class Value>
+void CompactingAVLTree<Key, Value>::releaseChunk(uint32_t id)
+{
+    ::operator delete(chunks_[id - 1].storage);
+    chunks_[id - 1].storage = nullptr;
+    chunks_[id - 1].used = 0;
+    chunks_[id - 1].live = 0;
+    freeChunks_.push_back(id);
+}
+
+/**
+* Ends the pass (or tidies up after one a removal cut short); the next one
+* starts filling a fresh chunk.
+*/
+template<class Key, class Value>
+void CompactingAVLTree<Key, Value>::finishPass()
+{
+    if (fillChunk_ != 0 && chunks_[fillChunk_ - 1].live == 0)
+    {
+        releaseChunk(fillChunk_);
+    }
+    fillChunk_ = 0;
+    inPass_ = false;
+    cursor_ = nullptr;
+}
+
+#endif
@@ -0,0 +1,565 @@
+#ifndef AVL_LAZY_H
+#define AVL_LAZY_H
+
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "avlbst.h"
+
+/**
+* An AVLNode that can be marked dead instead of being unlinked. The flag
+* fits in the padding after balance_, so it costs no memory.
+*/
+template <typename Key, typename Value>
+class LazyAVLNode : public AVLNode<Key, Value>
+{
+public:
+    LazyAVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
+    virtual ~LazyAVLNode();
+
+    bool isDead() const;
+    void setDead(bool dead);
+
+protected:
+    bool dead_;
+};
+
+template<class Key, class Value>
+LazyAVLNode<Key, Value>::LazyAVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent) :
+    AVLNode<Key, Value>(key, value, parent), dead_(false)
+{
+
+}
+
+template<class Key, class Value>
+LazyAVLNode<Key, Value>::~LazyAVLNode()
+{
+
+}
+
+template<class Key, class Value>
+bool LazyAVLNode<Key, Value>::isDead() const
+{
+    return dead_;
+}
+
+template<class Key, class Value>
+void LazyAVLNode<Key, Value>::setDead(bool dead)
+{
+    dead_ = dead;
+}
+
+/**
+* An AVLTree whose remove() only marks the node dead (one O(log n) search,
+* no unlinking, no rotations). Dead nodes are invisible to find(),
+* operator[] and iteration. Once the dead fraction of all nodes passes the
+* compaction threshold, the tree is rebuilt from its live nodes in one O(n)
+* pass, which is much cheaper than unlinking a burst of keys one by one.
+*
+* Live nodes are reused by compaction, so iterators to live keys stay valid
+* across it.
+*
+* The AVLTree base is protected: its find(), iteration, copying and saving
+* walk raw nodes and would hand back dead ones, so a LazyAVLTree cannot be
+* used through an AVLTree or BinarySearchTree reference, nor copied into
+* one. The parts of the base interface that are safe are brought back with
+* using-declarations.
+*/
+template <class Key, class Value>
+class LazyAVLTree : protected AVLTree<Key, Value>
+{
+public:
+    /**
+    * Iterator that skips dead nodes.
+    */
+    class iterator : public BinarySearchTree<Key, Value>::iterator
+    {
+    public:
+        iterator();
+        iterator& operator++();
+
+    protected:
+        friend class LazyAVLTree<Key, Value>;
+        iterator(Node<Key, Value>* ptr);
+    };
+
+    LazyAVLTree();
+    LazyAVLTree(const LazyAVLTree& other);
+    LazyAVLTree(LazyAVLTree&& other) noexcept;
+    virtual ~LazyAVLTree();
+    LazyAVLTree& operator=(const LazyAVLTree& other);
+    LazyAVLTree& operator=(LazyAVLTree&& other) noexcept;
+    void swap(LazyAVLTree& other) noexcept;
+
+    virtual void insert (const std::pair<const Key, Value> &new_item) override;
+    virtual void remove(const Key& key) override;
+    virtual void clear() override;
+    void compact();
+    void setCompactThreshold(double deadFraction);
+    size_t size() const;
+    bool empty() const;
+    size_t deadCount() const;
+    using AVLTree<Key, Value>::isBalanced;
+    using AVLTree<Key, Value>::print;
+    using AVLTree<Key, Value>::setFingerSearch;
+    using AVLTree<Key, Value>::build_parallel;
+
+    virtual void apply_batch(const std::vector<BatchOp<Key, Value> >& sorted_ops) override;
+    // the format has no room for the dead flag, so saving would bring removed keys back
+    template<class KeyCodec = BinaryCodec<Key>, class ValueCodec = BinaryCodec<Value> >
+    void save(std::ostream& out) const = delete;
+    template<class KeyCodec = BinaryCodec<Key>, class ValueCodec = BinaryCodec<Value> >
+    bool load(std::istream& in) = delete;
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    iterator erase(iterator pos);
+    iterator erase(iterator first, iterator last);
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+protected:
+    virtual void buildSorted(const std::vector<std::pair<Key, Value> >& items, unsigned threads) override;
+    virtual LazyAVLNode<Key, Value>* createNode(const Key& key, const Value& value, Node<Key, Value>* parent) override;
+    virtual LazyAVLNode<Key, Value>* cloneNode(const Node<Key, Value>* src, Node<Key, Value>* parent) const override;
+    virtual void removeNode(Node<Key, Value>* node) override;
+    virtual void swapTree(BinarySearchTree<Key, Value>& other) noexcept override;
+    virtual char saveKind() const override;
+    LazyAVLNode<Key, Value>* findLive(const Key& key) const;
+    static Node<Key, Value>* skipDead(Node<Key, Value>* n);
+
+    size_t liveCount_;
+    size_t deadCount_;
+    double compactThreshold_;   // fraction of dead nodes that triggers compact()
+};
+
+/*
+--------------------------------------------------------------
+Begin implementations for the LazyAVLTree::iterator class.
+--------------------------------------------------------------
+*/
+
+template<class Key, class Value>
+LazyAVLTree<Key, Value>::iterator::iterator() :
+    BinarySearchTree<Key, Value>::iterator()
+{
+
+}
+
+template<class Key, class Value>
+LazyAVLTree<Key, Value>::iterator::iterator(Node<Key, Value>* ptr) :
+    BinarySearchTree<Key, Value>::iterator(ptr)
+{
+
+}
+
+/**
+* Advances to the next live node in key order.
+*/
+template<class Key, class Value>
+typename LazyAVLTree<Key, Value>::iterator&
+LazyAVLTree<Key, Value>::iterator::operator++()
+{
+    this->current_ = skipDead(LazyAVLTree<Key, Value>::successor(this->current_));
+    return *this;
+}
+
+/*
+------------------------------------------------------------
+End implementations for the LazyAVLTree::iterator class.
+------------------------------------------------------------
+*/
+
+template<class Key, class Value>
+LazyAVLTree<Key, Value>::LazyAVLTree() :
+    AVLTree<Key, Value>(), liveCount_(0), deadCount_(0), compactThreshold_(0.5)
+{
+
+}
+
+/**
+* Dead nodes are copied as dead nodes.
+*/
+template<class Key, class Value>
+LazyAVLTree<Key, Value>::LazyAVLTree(const LazyAVLTree<Key, Value>& other) :
+    AVLTree<Key, Value>(), liveCount_(other.liveCount_), deadCount_(other.deadCount_),
+    compactThreshold_(other.compactThreshold_)
+{
+    this->copyFrom(other);
+}
+
+template<class Key, class Value>
+LazyAVLTree<Key, Value>::LazyAVLTree(LazyAVLTree<Key, Value>&& other) noexcept :
+    AVLTree<Key, Value>(), liveCount_(0), deadCount_(0), compactThreshold_(0.5)
+{
+    swap(other);
+}
+
+template<class Key, class Value>
+LazyAVLTree<Key, Value>::~LazyAVLTree()
+{
+
+}
+
+template<class Key, class Value>
+LazyAVLTree<Key, Value>& LazyAVLTree<Key, Value>::operator=(const LazyAVLTree<Key, Value>& other)
+{
+    if (this != &other)
+    {
+        BinarySearchTree<Key, Value>::operator=(other);
+        liveCount_ = other.liveCount_;
+        deadCount_ = other.deadCount_;
+        compactThreshold_ = other.compactThreshold_;
+    }
+    return *this;
+}
+
+template<class Key, class Value>
+LazyAVLTree<Key, Value>& LazyAVLTree<Key, Value>::operator=(LazyAVLTree<Key, Value>&& other) noexcept
+{
+    if (this != &other)
+    {
+        clear();
+        swap(other);
+    }
+    return *this;
+}
+
+template<class Key, class Value>
+void LazyAVLTree<Key, Value>::swap(LazyAVLTree<Key, Value>& other) noexcept
+{
+    this->swapTree(other);
+}
+
+/**
+* O(1) exchange of two lazy trees, counts included.
+*/
+template<class Key, class Value>
+void LazyAVLTree<Key, Value>::swapTree(BinarySearchTree<Key, Value>& other) noexcept
+{
+    LazyAVLTree<Key, Value>& that = static_cast<LazyAVLTree<Key, Value>&>(other);
+    AVLTree<Key, Value>::swapTree(that);
+    std::swap(liveCount_, that.liveCount_);
+    std::swap(deadCount_, that.deadCount_);
+    std::swap(compactThreshold_, that.compactThreshold_);
+}
+
+/**
+* Inserts or overwrites like AVLTree::insert. Inserting a key whose node
+* is dead brings that node back to life with the new value.
+*/
+template<class Key, class Value>
+void LazyAVLTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
+{
+    bool inserted = false;
+    LazyAVLNode<Key, Value>* node = static_cast<LazyAVLNode<Key, Value>*>(this->insertOrFind(new_item, inserted));
+    if (inserted)
+    {
+        ++liveCount_;
+        return;
+    }
+
+    if (node->isDead())
+    {
+        node->setDead(false);
+        --deadCount_;
+        ++liveCount_;
+    }
+    node->setValue(new_item.second);
+}
+
+/**
+* Marks key's node dead without touching the tree structure, then compacts
+* if the dead fraction has crossed the threshold.
+*/
+template<class Key, class Value>
+void LazyAVLTree<Key, Value>::remove(const Key& key)
+{
+    removeNode(findLive(key));
+}
+
+/**
+* The tombstone version of AVLTree::removeNode(), used by both remove() and
+* erase(). Dead or NULL nodes are ignored.
+*/
+template<class Key, class Value>
+void LazyAVLTree<Key, Value>::removeNode(Node<Key, Value>* n)
+{
+    LazyAVLNode<Key, Value>* node = static_cast<LazyAVLNode<Key, Value>*>(n);
+    if (node == nullptr || node->isDead())
+    {
+        return;
+    }
+
+    node->setDead(true);
+    --liveCount_;
+    ++deadCount_;
+
+    //tiny trees are not worth rebuilding
+    const size_t MIN_COMPACT_NODES = 64;
+    size_t total = liveCount_ + deadCount_;
+    if (total >= MIN_COMPACT_NODES && deadCount_ > compactThreshold_ * total)
+    {
+        compact();
+    }
+}
+
+/**
+* Plays the ops through insert() and remove(), which is what this tree is
+* cheap at; the base version's bulk relinking would not know about dead
+* nodes or the counts.
+*/
+template<class Key, class Value>
+void LazyAVLTree<Key, Value>::apply_batch(const std::vector<BatchOp<Key, Value> >& sorted_ops)
+{
+    for (size_t i = 0; i < sorted_ops.size(); ++i)
+    {
+        if (sorted_ops[i].kind == BatchOp<Key, Value>::UPSERT)
+        {
+            insert(std::make_pair(sorted_ops[i].key, sorted_ops[i].value));
+        }
+        else
+        {
+            remove(sorted_ops[i].key);
+        }
+    }
+}
+
+/**
+* The base rebuild, which starts from clear() and so from zero counts; every
+* node it makes is live.
+*/
+template<class Key, class Value>
+void LazyAVLTree<Key, Value>::buildSorted(const std::vector<std::pair<Key, Value> >& items, unsigned threads)
+{
+    AVLTree<Key, Value>::buildSorted(items, threads);
+    for (size_t i = 0; i < items.size(); ++i)
+    {
+        if (i + 1 == items.size() || items[i].first < items[i + 1].first)
+        {
+            ++liveCount_;
+        }
+    }
+}
+
+/**
+* Removes everything, dead nodes included.
+*/
+template<class Key, class Value>
+void LazyAVLTree<Key, Value>::clear()
+{
+    BinarySearchTree<Key, Value>::clear();
+    liveCount_ = 0;
+    deadCount_ = 0;
+}
+
+/**
+* Frees all dead nodes and relinks the live ones into a perfectly balanced
+* tree in O(n), with no rotations.
+*/
+template<class Key, class Value>
+void LazyAVLTree<Key, Value>::compact()
+{
+    if (deadCount_ == 0)
+    {
+        return;
+    }
+
+    std::vector<AVLNode<Key, Value>*> nodes;
+    nodes.reserve(liveCount_ + deadCount_);
+    this->flattenInOrder(nodes);
+    this->finger_ = nullptr;
+
+    //keep the live nodes in order, free the dead ones
+    size_t live = 0;
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        if (static_cast<LazyAVLNode<Key, Value>*>(nodes[i])->isDead())
+        {
+            this->destroyNode(nodes[i]);
+        }
+        else
+        {
+            nodes[live++] = nodes[i];
+        }
+    }
+    nodes.resize(live);
+
+    int height = 0;
+    this->root_ = AVLTree<Key, Value>::buildBalanced(nodes, 0, nodes.size(), nullptr, height);
+    deadCount_ = 0;
+}
+
+/**
+* Sets the fraction of dead nodes (0 to 1) at which remove() compacts the
+* tree. 1 or more turns automatic compaction off.
+*/
+template<class Key, class Value>
+void LazyAVLTree<Key, Value>::setCompactThreshold(double deadFraction)
+{
+    compactThreshold_ = deadFraction;
+}
+
+/**
+* Number of live keys.
+*/
+template<class Key, class Value>
+size_t LazyAVLTree<Key, Value>::size() const
+{
+    return liveCount_;
+}
+
+/**
+* True when every node is dead, or there are none.
+*/
+template<class Key, class Value>
+bool LazyAVLTree<Key, Value>::empty() const
+{
+    return liveCount_ == 0;
+}
+
+/**
+* Number of dead nodes waiting for compaction.
+*/
+template<class Key, class Value>
+size_t LazyAVLTree<Key, Value>::deadCount() const
+{
+    return deadCount_;
+}
+
+template<class Key, class Value>
+typename LazyAVLTree<Key, Value>::iterator
+LazyAVLTree<Key, Value>::begin() const
+{
+    return iterator(skipDead(this->getSmallestNode()));
+}
+
+template<class Key, class Value>
+typename LazyAVLTree<Key, Value>::iterator
+LazyAVLTree<Key, Value>::end() const
+{
+    return iterator(nullptr);
+}
+
+template<class Key, class Value>
+typename LazyAVLTree<Key, Value>::iterator
+LazyAVLTree<Key, Value>::find(const Key& key) const
+{
+    return iterator(findLive(key));
+}
+
+/**
+* First live item whose key is not less than key.
+*/
+template<class Key, class Value>
+typename LazyAVLTree<Key, Value>::iterator
+LazyAVLTree<Key, Value>::lower_bound(const Key& key) const
+{
+    return iterator(skipDead(this->nodeOf(AVLTree<Key, Value>::lower_bound(key))));
+}
+
+/**
+* Kills the item pos points at and returns an iterator to the next live
+* item. That item is found before a compaction can run, and compaction keeps
+* live nodes, so the returned iterator is always valid.
+*/
+template<class Key, class Value>
+typename LazyAVLTree<Key, Value>::iterator
+LazyAVLTree<Key, Value>::erase(iterator pos)
+{
+    Node<Key, Value>* node = this->nodeOf(pos);
+    Node<Key, Value>* next = skipDead(LazyAVLTree<Key, Value>::successor(node));
+    removeNode(node);
+    return iterator(next);
+}
+
+/**
+* Kills the items in [first, last) and returns last.
+*/
+template<class Key, class Value>
+typename LazyAVLTree<Key, Value>::iterator
+LazyAVLTree<Key, Value>::erase(iterator first, iterator last)
+{
+    while (first != last)
+    {
+        first = erase(first);
+    }
+    return last;
+}
+
+template<class Key, class Value>
+Value& LazyAVLTree<Key, Value>::operator[](const Key& key)
+{
+    LazyAVLNode<Key, Value>* curr = findLive(key);
+    if(curr == NULL) throw std::out_of_range("Invalid key");
+    return curr->getValue();
+}
+
+template<class Key, class Value>
+Value const & LazyAVLTree<Key, Value>::operator[](const Key& key) const
+{
+    LazyAVLNode<Key, Value>* curr = findLive(key);
+    if(curr == NULL) throw std::out_of_range("Invalid key");
+    return curr->getValue();
+}
+
+template<class Key, class Value>
+LazyAVLNode<Key, Value>* LazyAVLTree<Key, Value>::createNode(const Key& key, const Value& value, Node<Key, Value>* parent)
+{
+    return new LazyAVLNode<Key, Value>(key, value, static_cast<AVLNode<Key, Value>*>(parent));
+}
+
+/**
+* Copies src, its balance factor and its dead flag.
+*/
+template<class Key, class Value>
+LazyAVLNode<Key, Value>* LazyAVLTree<Key, Value>::cloneNode(const Node<Key, Value>* src, Node<Key, Value>* parent) const
+{
+    const LazyAVLNode<Key, Value>* from = static_cast<const LazyAVLNode<Key, Value>*>(src);
+    LazyAVLNode<Key, Value>* copy = new LazyAVLNode<Key, Value>(from->getKey(), from->getValue(), static_cast<AVLNode<Key, Value>*>(parent));
+    copy->setBalance(from->getBalance());
+    copy->setDead(from->isDead());
+    return copy;
+}
+
+/**
+* Not saveable (see the deleted save()), even through a base reference.
+*/
+template<class Key, class Value>
+char LazyAVLTree<Key, Value>::saveKind() const
+{
+    return 0;
+}
+
+/**
+* internalFind() that treats dead nodes as absent.
+*/
+template<class Key, class Value>
+LazyAVLNode<Key, Value>* LazyAVLTree<Key, Value>::findLive(const Key& key) const
+{
+    LazyAVLNode<Key, Value>* node = static_cast<LazyAVLNode<Key, Value>*>(this->internalFind(key));
+    if (node == nullptr || node->isDead())
+    {
+        return nullptr;
+    }
+    return node;
+}
+
+/**
+* Returns n if it is live, otherwise the next live node after it in key
+* order (or NULL).
+*/
+template<class Key, class Value>
+Node<Key, Value>* LazyAVLTree<Key, Value>::skipDead(Node<Key, Value>* n)
+{
+    while (n != nullptr && static_cast<LazyAVLNode<Key, Value>*>(n)->isDead())
+    {
+        n = LazyAVLTree<Key, Value>::successor(n);
+    }
+    return n;
+}
+
+#endif
@@ -0,0 +1,415 @@
+#ifndef AVL_MULTIMAP_H
+#define AVL_MULTIMAP_H
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "avlbst.h"
+
+/**
+* An AVLNode that can hold several values for its key. The first value
+* lives in the node's item as usual; any further ones go in a run that is
+* only allocated once the key is actually repeated, so unique keys cost a
+* single extra pointer.
+*/
+template <typename Key, typename Value>
+class AVLMultiNode : public AVLNode<Key, Value>
+{
+public:
+    AVLMultiNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
+    virtual ~AVLMultiNode();
+
+    size_t valueCount() const;
+    void appendValue(const Value& value);
+    const Value& valueAt(size_t i) const;
+    Value& valueAt(size_t i);
+
+    // The value run is owned by the node, so nodes are not copyable.
+    AVLMultiNode(const AVLMultiNode&) = delete;
+    AVLMultiNode& operator=(const AVLMultiNode&) = delete;
+
+protected:
+    std::vector<Value>* extra_;    // values 2..n, in insertion order
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the AVLMultiNode class.
+  -------------------------------------------------
+*/
+
+template<class Key, class Value>
+AVLMultiNode<Key, Value>::AVLMultiNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent) :
+    AVLNode<Key, Value>(key, value, parent), extra_(nullptr)
+{
+
+}
+
+/**
+* Frees the value run, if one was ever needed.
+*/
+template<class Key, class Value>
+AVLMultiNode<Key, Value>::~AVLMultiNode()
+{
+    delete extra_;
+}
+
+/**
+* Number of values stored under this node's key.
+*/
+template<class Key, class Value>
+size_t AVLMultiNode<Key, Value>::valueCount() const
+{
+    return (extra_ == nullptr) ? 1 : extra_->size() + 1;
+}
+
+/**
+* Adds another value for this key after the existing ones, amortized O(1).
+*/
+template<class Key, class Value>
+void AVLMultiNode<Key, Value>::appendValue(const Value& value)
+{
+    if (extra_ == nullptr)
+    {
+        extra_ = new std::vector<Value>();
+    }
+    extra_->push_back(value);
+}
+
+/**
+* The i'th value stored for this key, 0 being the first one inserted.
+*/
+template<class Key, class Value>
+const Value& AVLMultiNode<Key, Value>::valueAt(size_t i) const
+{
+    return (i == 0) ? this->item_.second : (*extra_)[i - 1];
+}
+
+template<class Key, class Value>
+Value& AVLMultiNode<Key, Value>::valueAt(size_t i)
+{
+    return (i == 0) ? this->item_.second : (*extra_)[i - 1];
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the AVLMultiNode class.
+  -----------------------------------------------
+*/
+
+/**
+* An AVLTree that keeps every value inserted under a key instead of
+* overwriting. Repeated keys do not add tree nodes: the values pile up in
+* the key's node, in insertion order.
+*
+* The inherited iterator still visits each key once and its ->second is the
+* first value; use equal_range() to see all of them. remove() drops a key
+* together with all its values, and build_parallel() keeps every pair it is
+* given, repeated keys included.
+*/
+template <class Key, class Value>
+class AVLMultiMap : public AVLTree<Key, Value>
+{
+public:
+    /**
+    * Iterates over the values stored under one key.
+    */
+    class value_iterator
+    {
+    public:
+        value_iterator();
+
+        Value& operator*() const;
+        Value* operator->() const;
+
+        bool operator==(const value_iterator& rhs) const;
+        bool operator!=(const value_iterator& rhs) const;
+
+        value_iterator& operator++();
+
+    protected:
+        friend class AVLMultiMap<Key, Value>;
+        value_iterator(AVLMultiNode<Key, Value>* node, size_t index);
+        AVLMultiNode<Key, Value>* node_;
+        size_t index_;
+    };
+
+    AVLMultiMap();
+    AVLMultiMap(const AVLMultiMap& other);
+    AVLMultiMap(AVLMultiMap&& other) noexcept;
+    AVLMultiMap& operator=(const AVLMultiMap& other);
+    AVLMultiMap& operator=(AVLMultiMap&& other) noexcept;
+    void swap(AVLMultiMap& other) noexcept;
+
+    virtual void insert (const std::pair<const Key, Value> &new_item) override;
+    void append(typename BinarySearchTree<Key, Value>::iterator pos, const Value& value);
+    size_t count(const Key& key) const;
+    std::pair<value_iterator, value_iterator> equal_range(const Key& key) const;
+
+    virtual void apply_batch(const std::vector<BatchOp<Key, Value> >& sorted_ops) override;
+    // the format holds one value per node, so every value but the first would be lost
+    template<class KeyCodec = BinaryCodec<Key>, class ValueCodec = BinaryCodec<Value> >
+    void save(std::ostream& out) const = delete;
+    template<class KeyCodec = BinaryCodec<Key>, class ValueCodec = BinaryCodec<Value> >
+    bool load(std::istream& in) = delete;
+
+protected:
+    virtual void buildSorted(const std::vector<std::pair<Key, Value> >& items, unsigned threads) override;
+    virtual AVLMultiNode<Key, Value>* createNode(const Key& key, const Value& value, Node<Key, Value>* parent) override;
+    virtual AVLMultiNode<Key, Value>* cloneNode(const Node<Key, Value>* src, Node<Key, Value>* parent) const override;
+    virtual void collectItems(std::vector<std::pair<Key, Value> >& out) const override;
+    virtual char saveKind() const override;
+};
+
+/*
+--------------------------------------------------------------
+Begin implementations for the AVLMultiMap::value_iterator class.
+--------------------------------------------------------------
+*/
+
+template<class Key, class Value>
+AVLMultiMap<Key, Value>::value_iterator::value_iterator() :
+    node_(nullptr), index_(0)
+{
+
+}
+
+template<class Key, class Value>
+AVLMultiMap<Key, Value>::value_iterator::value_iterator(AVLMultiNode<Key, Value>* node, size_t index) :
+    node_(node), index_(index)
+{
+
+}
+
+template<class Key, class Value>
+Value& AVLMultiMap<Key, Value>::value_iterator::operator*() const
+{
+    return node_->valueAt(index_);
+}
+
+template<class Key, class Value>
+Value* AVLMultiMap<Key, Value>::value_iterator::operator->() const
+{
+    return &(node_->valueAt(index_));
+}
+
+template<class Key, class Value>
+bool AVLMultiMap<Key, Value>::value_iterator::operator==(const value_iterator& rhs) const
+{
+    return node_ == rhs.node_ && index_ == rhs.index_;
+}
+
+template<class Key, class Value>
+bool AVLMultiMap<Key, Value>::value_iterator::operator!=(const value_iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+template<class Key, class Value>
+typename AVLMultiMap<Key, Value>::value_iterator&
+AVLMultiMap<Key, Value>::value_iterator::operator++()
+{
+    ++index_;
+    return *this;
+}
+
+/*
+------------------------------------------------------------
+End implementations for the AVLMultiMap::value_iterator class.
+------------------------------------------------------------
+*/
+
+template<class Key, class Value>
+AVLMultiMap<Key, Value>::AVLMultiMap() :
+    AVLTree<Key, Value>()
+{
+
+}
+
+template<class Key, class Value>
+AVLMultiMap<Key, Value>::AVLMultiMap(const AVLMultiMap<Key, Value>& other) :
+    AVLTree<Key, Value>()
+{
+    this->copyFrom(other);
+}
+
+template<class Key, class Value>
+AVLMultiMap<Key, Value>::AVLMultiMap(AVLMultiMap<Key, Value>&& other) noexcept :
+    AVLTree<Key, Value>()
+{
+    swap(other);
+}
+
+template<class Key, class Value>
+AVLMultiMap<Key, Value>& AVLMultiMap<Key, Value>::operator=(const AVLMultiMap<Key, Value>& other)
+{
+    BinarySearchTree<Key, Value>::operator=(other);
+    return *this;
+}
+
+template<class Key, class Value>
+AVLMultiMap<Key, Value>& AVLMultiMap<Key, Value>::operator=(AVLMultiMap<Key, Value>&& other) noexcept
+{
+    if (this != &other)
+    {
+        this->clear();
+        swap(other);
+    }
+    return *this;
+}
+
+template<class Key, class Value>
+void AVLMultiMap<Key, Value>::swap(AVLMultiMap<Key, Value>& other) noexcept
+{
+    this->swapTree(other);
+}
+
+/**
+* Inserts new_item. If the key is already present its value is added to the
+* key's run with the same single descent that found it.
+*/
+template<class Key, class Value>
+void AVLMultiMap<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
+{
+    bool inserted = false;
+    AVLNode<Key, Value>* node = this->insertOrFind(new_item, inserted);
+    if (!inserted)
+    {
+        static_cast<AVLMultiNode<Key, Value>*>(node)->appendValue(new_item.second);
+    }
+}
+
+/**
+* Plays the ops in order: an upsert adds its value to the key like
+* insert(), an erase drops the key with all its values like remove().
+*/
+template<class Key, class Value>
+void AVLMultiMap<Key, Value>::apply_batch(const std::vector<BatchOp<Key, Value> >& sorted_ops)
+{
+    for (size_t i = 0; i < sorted_ops.size(); ++i)
+    {
+        if (sorted_ops[i].kind == BatchOp<Key, Value>::UPSERT)
+        {
+            insert(std::make_pair(sorted_ops[i].key, sorted_ops[i].value));
+        }
+        else
+        {
+            this->remove(sorted_ops[i].key);
+        }
+    }
+}
+
+/**
+* Adds value to the key pos points at, without searching the tree.
+* @precondition pos is a valid, dereferenceable iterator into this tree
+*/
+template<class Key, class Value>
+void AVLMultiMap<Key, Value>::append(typename BinarySearchTree<Key, Value>::iterator pos, const Value& value)
+{
+    static_cast<AVLMultiNode<Key, Value>*>(this->nodeOf(pos))->appendValue(value);
+}
+
+/**
+* Number of values stored under key (0 if the key is absent).
+*/
+template<class Key, class Value>
+size_t AVLMultiMap<Key, Value>::count(const Key& key) const
+{
+    Node<Key, Value>* node = this->internalFind(key);
+    if (node == nullptr)
+    {
+        return 0;
+    }
+    return static_cast<AVLMultiNode<Key, Value>*>(node)->valueCount();
+}
+
+/**
+* Returns the range of values stored under key, in insertion order. Both
+* iterators compare equal when the key is absent.
+*/
+template<class Key, class Value>
+std::pair<typename AVLMultiMap<Key, Value>::value_iterator, typename AVLMultiMap<Key, Value>::value_iterator>
+AVLMultiMap<Key, Value>::equal_range(const Key& key) const
+{
+    AVLMultiNode<Key, Value>* node = static_cast<AVLMultiNode<Key, Value>*>(this->internalFind(key));
+    if (node == nullptr)
+    {
+        return std::make_pair(value_iterator(), value_iterator());
+    }
+    return std::make_pair(value_iterator(node, 0), value_iterator(node, node->valueCount()));
+}
+
+/**
+* One node per key, with the values of a repeated key appended in input
+* order instead of the last one winning.
+*/
+template<class Key, class Value>
+void AVLMultiMap<Key, Value>::buildSorted(const std::vector<std::pair<Key, Value> >& items, unsigned threads)
+{
+    this->clear();
+
+    std::vector<AVLNode<Key, Value>*> nodes;
+    for (size_t i = 0; i < items.size(); ++i)
+    {
+        if (nodes.empty() || nodes.back()->getKey() < items[i].first)
+        {
+            nodes.push_back(createNode(items[i].first, items[i].second, nullptr));
+        }
+        else
+        {
+            static_cast<AVLMultiNode<Key, Value>*>(nodes.back())->appendValue(items[i].second);
+        }
+    }
+    this->linkBalanced(nodes, threads);
+}
+
+template<class Key, class Value>
+AVLMultiNode<Key, Value>* AVLMultiMap<Key, Value>::createNode(const Key& key, const Value& value, Node<Key, Value>* parent)
+{
+    return new AVLMultiNode<Key, Value>(key, value, static_cast<AVLNode<Key, Value>*>(parent));
+}
+
+/**
+* Copies src, its balance factor and its whole value run.
+*/
+template<class Key, class Value>
+AVLMultiNode<Key, Value>* AVLMultiMap<Key, Value>::cloneNode(const Node<Key, Value>* src, Node<Key, Value>* parent) const
+{
+    const AVLMultiNode<Key, Value>* from = static_cast<const AVLMultiNode<Key, Value>*>(src);
+    AVLMultiNode<Key, Value>* copy = new AVLMultiNode<Key, Value>(from->getKey(), from->getValue(), static_cast<AVLNode<Key, Value>*>(parent));
+    copy->setBalance(from->getBalance());
+    for (size_t i = 1; i < from->valueCount(); ++i)
+    {
+        copy->appendValue(from->valueAt(i));
+    }
+    return copy;
+}
+
+/**
+* Every value of every key, so a swap with another kind of tree through a
+* base reference moves whole runs. The values live in the nodes, so an
+* ordinary swap needs nothing beyond the base swapTree().
+*/
+template<class Key, class Value>
+void AVLMultiMap<Key, Value>::collectItems(std::vector<std::pair<Key, Value> >& out) const
+{
+    for (typename BinarySearchTree<Key, Value>::iterator it = this->begin(); it != this->end(); ++it)
+    {
+        const AVLMultiNode<Key, Value>* node = static_cast<const AVLMultiNode<Key, Value>*>(this->nodeOf(it));
+        for (size_t i = 0; i < node->valueCount(); ++i)
+        {
+            out.push_back(std::make_pair(it->first, node->valueAt(i)));
+        }
+    }
+}
+
+/**
+* Not saveable (see the deleted save()), even through a base reference.
+*/
+template<class Key, class Value>
+char AVLMultiMap<Key, Value>::saveKind() const
+{
+    return 0;
+}
+
+#endif
@@ -0,0 +1,535 @@
+#ifndef AVL_SEQLOCK_H
+#define AVL_SEQLOCK_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "avlbst.h"
+
+/**
+* An AVLTree for one writer thread and any number of reader threads, where
+* readers never take a lock or write a shared cache line.
+*
+* Every write (insert, remove, erase, apply_batch, build_parallel, clear),
+* rotations included, runs inside a sequence counter that is odd while the write is in
+* progress. lookup() and contains() search optimistically and retry if the
+* counter was odd or changed under them; a cap on the number of steps stops
+* a search that wandered into a half-rotated spot.
+*
+* Link and value loads in the search are plain, not atomic, so a reader
+* racing the writer is formally a data race (and ThreadSanitizer will say
+* so). This is the usual seqlock exception, taken on purpose: the nodes are
+* shared with AVLTree and cannot hold atomics, and a torn read is always
+* thrown away by the counter check before it is used, which is why Value
+* must be trivially copyable.
+*
+* Removed nodes are not freed straight away but retired through
+* destroyNode(). Readers announce themselves in a per-thread slot tagged
+* with the parity of a global epoch, and reclaim() only frees retired nodes
+* once every reader that could still be looking at them has left.
+*
+* Only lookup() and contains() may be called from reader threads; the rest
+* of the interface (find, iterators, operator[], ...) is for the writer.
+* Iterators have a const item and only the const operator[] is offered,
+* since a value written through either would bypass the sequence counter.
+*/
+template <class Key, class Value>
+class SeqlockAVLTree : public AVLTree<Key, Value>
+{
+    static_assert(std::is_trivially_copyable<Value>::value,
+        "SeqlockAVLTree readers copy values while they may be overwritten");
+
+public:
+    SeqlockAVLTree();
+    virtual ~SeqlockAVLTree();
+
+    // The counters and reader slots are tied to this instance.
+    SeqlockAVLTree(const SeqlockAVLTree&) = delete;
+    SeqlockAVLTree& operator=(const SeqlockAVLTree&) = delete;
+    void swap(SeqlockAVLTree& other) = delete;
+    // load() would relink the whole tree outside a write section
+    template<class KeyCodec = BinaryCodec<Key>, class ValueCodec = BinaryCodec<Value> >
+    void save(std::ostream& out) const = delete;
+    template<class KeyCodec = BinaryCodec<Key>, class ValueCodec = BinaryCodec<Value> >
+    bool load(std::istream& in) = delete;
+
+    /**
+    * AVLTree's iterator with a const item, since a write through it would
+    * not be inside a write section.
+    */
+    class iterator : public AVLTree<Key, Value>::iterator
+    {
+    public:
+        iterator();
+        iterator(const typename AVLTree<Key, Value>::iterator& it);
+
+        const std::pair<const Key, Value>& operator*() const;
+        const std::pair<const Key, Value>* operator->() const;
+
+        iterator& operator++();
+    };
+
+    // writer thread only
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    iterator erase(iterator pos);
+    iterator erase(iterator first, iterator last);
+    Value const & operator[](const Key& key) const;
+    virtual void insert (const std::pair<const Key, Value> &new_item) override;
+    virtual void remove(const Key& key) override;
+    virtual void clear() override;
+    virtual void apply_batch(const std::vector<BatchOp<Key, Value> >& sorted_ops) override;
+    void reclaim();
+
+    // any thread
+    bool lookup(const Key& key, Value& out) const;
+    bool contains(const Key& key) const;
+
+protected:
+    virtual void buildSorted(const std::vector<std::pair<Key, Value> >& items, unsigned threads) override;
+    virtual AVLNode<Key, Value>* createNode(const Key& key, const Value& value, Node<Key, Value>* parent) override;
+    virtual void removeNode(Node<Key, Value>* node) override;
+    virtual void destroyNode(Node<Key, Value>* node) override;
+    virtual void swapTree(BinarySearchTree<Key, Value>& other) noexcept override;
+    virtual char saveKind() const override;
+    void beginWrite();
+    void endWrite();
+    uint64_t enterRead(size_t slot) const;
+    void exitRead(size_t slot, uint64_t epoch) const;
+    bool optimisticFind(const Key& key, void* valueOut) const;
+    static size_t slotIndex();
+
+    static const size_t READER_SLOTS = 64;
+    static const size_t MAX_STEPS = 128;        // deeper than any AVL tree that fits in memory
+    static const size_t RECLAIM_BATCH = 256;    // retired nodes kept before reclaim() runs by itself
+
+    /**
+    * Readers active in each epoch parity. Padded to a cache line so readers
+    * in different slots do not share one.
+    */
+    struct ReaderSlot
+    {
+        ReaderSlot() { active[0] = 0; active[1] = 0; }
+
+        std::atomic<uint32_t> active[2];
+        char pad[64 - 2 * sizeof(std::atomic<uint32_t>)];
+    };
+
+    mutable ReaderSlot slots_[READER_SLOTS];
+    std::atomic<uint64_t> seq_;         // odd while a write is in progress
+    std::atomic<uint64_t> epoch_;       // bumped by reclaim()
+    std::vector<Node<Key, Value>*> retired_;
+    size_t writeDepth_;                 // remove() nests removeNode()
+};
+
+/*
+-------------------------------------------------------------
+Begin implementations for the SeqlockAVLTree::iterator class.
+-------------------------------------------------------------
+*/
+
+template<class Key, class Value>
+SeqlockAVLTree<Key, Value>::iterator::iterator() :
+    AVLTree<Key, Value>::iterator()
+{
+
+}
+
+template<class Key, class Value>
+SeqlockAVLTree<Key, Value>::iterator::iterator(const typename AVLTree<Key, Value>::iterator& it) :
+    AVLTree<Key, Value>::iterator(it)
+{
+
+}
+
+template<class Key, class Value>
+const std::pair<const Key, Value>&
+SeqlockAVLTree<Key, Value>::iterator::operator*() const
+{
+    return AVLTree<Key, Value>::iterator::operator*();
+}
+
+template<class Key, class Value>
+const std::pair<const Key, Value>*
+SeqlockAVLTree<Key, Value>::iterator::operator->() const
+{
+    return AVLTree<Key, Value>::iterator::operator->();
+}
+
+template<class Key, class Value>
+typename SeqlockAVLTree<Key, Value>::iterator&
+SeqlockAVLTree<Key, Value>::iterator::operator++()
+{
+    AVLTree<Key, Value>::iterator::operator++();
+    return *this;
+}
+
+/*
+-----------------------------------------------------------
+End implementations for the SeqlockAVLTree::iterator class.
+-----------------------------------------------------------
+*/
+
+template<class Key, class Value>
+SeqlockAVLTree<Key, Value>::SeqlockAVLTree() :
+    AVLTree<Key, Value>(), seq_(0), epoch_(0), writeDepth_(0)
+{
+
+}
+
+/**
+* No reader may still be running, so retired nodes can go straight away;
+* the base destructor frees the rest.
+*/
+template<class Key, class Value>
+SeqlockAVLTree<Key, Value>::~SeqlockAVLTree()
+{
+    for (size_t i = 0; i < retired_.size(); ++i)
+    {
+        delete retired_[i];
+    }
+}
+
+template<class Key, class Value>
+typename SeqlockAVLTree<Key, Value>::iterator
+SeqlockAVLTree<Key, Value>::begin() const
+{
+    return AVLTree<Key, Value>::begin();
+}
+
+template<class Key, class Value>
+typename SeqlockAVLTree<Key, Value>::iterator
+SeqlockAVLTree<Key, Value>::end() const
+{
+    return AVLTree<Key, Value>::end();
+}
+
+template<class Key, class Value>
+typename SeqlockAVLTree<Key, Value>::iterator
+SeqlockAVLTree<Key, Value>::find(const Key& key) const
+{
+    return AVLTree<Key, Value>::find(key);
+}
+
+template<class Key, class Value>
+typename SeqlockAVLTree<Key, Value>::iterator
+SeqlockAVLTree<Key, Value>::lower_bound(const Key& key) const
+{
+    return AVLTree<Key, Value>::lower_bound(key);
+}
+
+/**
+* Both erase()s remove through removeNode(), which opens a write section.
+*/
+template<class Key, class Value>
+typename SeqlockAVLTree<Key, Value>::iterator
+SeqlockAVLTree<Key, Value>::erase(iterator pos)
+{
+    return AVLTree<Key, Value>::erase(pos);
+}
+
+template<class Key, class Value>
+typename SeqlockAVLTree<Key, Value>::iterator
+SeqlockAVLTree<Key, Value>::erase(iterator first, iterator last)
+{
+    return AVLTree<Key, Value>::erase(first, last);
+}
+
+/**
+* Only the const lookup: it throws std::out_of_range for a missing key, and
+* a writable reference would let a value change outside a write section.
+* Values are replaced through insert().
+*/
+template<class Key, class Value>
+Value const & SeqlockAVLTree<Key, Value>::operator[](const Key& key) const
+{
+    return AVLTree<Key, Value>::operator[](key);
+}
+
+template<class Key, class Value>
+void SeqlockAVLTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
+{
+    beginWrite();
+    AVLTree<Key, Value>::insert(new_item);
+    endWrite();
+}
+
+template<class Key, class Value>
+void SeqlockAVLTree<Key, Value>::remove(const Key& key)
+{
+    beginWrite();
+    AVLTree<Key, Value>::remove(key);
+    endWrite();
+}
+
+template<class Key, class Value>
+void SeqlockAVLTree<Key, Value>::clear()
+{
+    beginWrite();
+    AVLTree<Key, Value>::clear();
+    endWrite();
+    //inside a longer write, readers are parked until it ends, so reclaiming now would wait forever
+    if (writeDepth_ == 0)
+    {
+        reclaim();
+    }
+}
+
+template<class Key, class Value>
+void SeqlockAVLTree<Key, Value>::apply_batch(const std::vector<BatchOp<Key, Value> >& sorted_ops)
+{
+    beginWrite();
+    AVLTree<Key, Value>::apply_batch(sorted_ops);
+    endWrite();
+}
+
+/**
+* Rebuilds in one write section, so readers wait for the new tree instead
+* of seeing it half linked.
+*/
+template<class Key, class Value>
+void SeqlockAVLTree<Key, Value>::buildSorted(const std::vector<std::pair<Key, Value> >& items, unsigned threads)
+{
+    beginWrite();
+    AVLTree<Key, Value>::buildSorted(items, threads);
+    endWrite();
+    reclaim();
+}
+
+/**
+* Frees every retired node. Starts a new epoch, then waits for the readers
+* that entered in the old one (the only ones that can still hold a retired
+* node) to leave, which takes no longer than one search.
+*/
+template<class Key, class Value>
+void SeqlockAVLTree<Key, Value>::reclaim()
+{
+    if (retired_.empty())
+    {
+        return;
+    }
+
+    uint64_t old = epoch_.load();
+    epoch_.store(old + 1);
+    for (size_t i = 0; i < READER_SLOTS; ++i)
+    {
+        while (slots_[i].active[old & 1].load() != 0)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    for (size_t i = 0; i < retired_.size(); ++i)
+    {
+        delete retired_[i];
+    }
+    retired_.clear();
+}
+
+/**
+* Copies the value for key into out and returns true, or returns false if
+* the key is absent. Safe to call from any thread, concurrently with the
+* writer.
+*/
+template<class Key, class Value>
+bool SeqlockAVLTree<Key, Value>::lookup(const Key& key, Value& out) const
+{
+    return optimisticFind(key, &out);
+}
+
+template<class Key, class Value>
+bool SeqlockAVLTree<Key, Value>::contains(const Key& key) const
+{
+    return optimisticFind(key, nullptr);
+}
+
+/**
+* Makes the new node's contents visible before any link to it, so a reader
+* that follows a fresh link never sees an unconstructed node.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* SeqlockAVLTree<Key, Value>::createNode(const Key& key, const Value& value, Node<Key, Value>* parent)
+{
+    AVLNode<Key, Value>* node = AVLTree<Key, Value>::createNode(key, value, parent);
+    std::atomic_thread_fence(std::memory_order_release);
+    return node;
+}
+
+/**
+* erase(iterator) reaches the tree through here, so it gets a write section
+* too (nested inside remove()'s one otherwise).
+*/
+template<class Key, class Value>
+void SeqlockAVLTree<Key, Value>::removeNode(Node<Key, Value>* node)
+{
+    beginWrite();
+    AVLTree<Key, Value>::removeNode(node);
+    endWrite();
+}
+
+/**
+* Retires node instead of freeing it; a reader may still be on it.
+*/
+template<class Key, class Value>
+void SeqlockAVLTree<Key, Value>::destroyNode(Node<Key, Value>* node)
+{
+    retired_.push_back(node);
+}
+
+/**
+* Only reachable through a base reference, since swap() is deleted. Both
+* trees get a write section, but readers of either may be standing on
+* nodes that change owner, so no reader of either tree may be running.
+* Retired nodes stay with the tree whose readers might still see them.
+*/
+template<class Key, class Value>
+void SeqlockAVLTree<Key, Value>::swapTree(BinarySearchTree<Key, Value>& other) noexcept
+{
+    SeqlockAVLTree<Key, Value>& that = static_cast<SeqlockAVLTree<Key, Value>&>(other);
+    beginWrite();
+    that.beginWrite();
+    AVLTree<Key, Value>::swapTree(that);
+    that.endWrite();
+    endWrite();
+}
+
+/**
+* Not saveable (see the deleted load()), even through a base reference.
+*/
+template<class Key, class Value>
+char SeqlockAVLTree<Key, Value>::saveKind() const
+{
+    return 0;
+}
+
+template<class Key, class Value>
+void SeqlockAVLTree<Key, Value>::beginWrite()
+{
+    if (writeDepth_++ == 0)
+    {
+        seq_.store(seq_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        //keeps the tree stores below from becoming visible before the odd count
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+}
+
+template<class Key, class Value>
+void SeqlockAVLTree<Key, Value>::endWrite()
+{
+    if (--writeDepth_ == 0)
+    {
+        seq_.store(seq_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        if (retired_.size() >= RECLAIM_BATCH)
+        {
+            reclaim();
+        }
+    }
+}
+
+/**
+* Marks this thread's slot active for the current epoch and returns it. If
+* reclaim() moved the epoch on in between, the reader might have been missed,
+* so it backs out and tries again.
+*/
+template<class Key, class Value>
+uint64_t SeqlockAVLTree<Key, Value>::enterRead(size_t slot) const
+{
+    while (true)
+    {
+        uint64_t epoch = epoch_.load();
+        slots_[slot].active[epoch & 1].fetch_add(1);
+        if (epoch_.load() == epoch)
+        {
+            return epoch;
+        }
+        slots_[slot].active[epoch & 1].fetch_sub(1);
+    }
+}
+
+template<class Key, class Value>
+void SeqlockAVLTree<Key, Value>::exitRead(size_t slot, uint64_t epoch) const
+{
+    slots_[slot].active[epoch & 1].fetch_sub(1, std::memory_order_release);
+}
+
+/**
+* The reader side of the seqlock: searches without locking and copies the
+* value into valueOut (if not null), then keeps the result only if no write
+* started or finished meanwhile.
+*/
+template<class Key, class Value>
+bool SeqlockAVLTree<Key, Value>::optimisticFind(const Key& key, void* valueOut) const
+{
+    size_t slot = slotIndex();
+    uint64_t epoch = enterRead(slot);
+    typename std::aligned_storage<sizeof(Value), alignof(Value)>::type copy;
+
+    while (true)
+    {
+        uint64_t before = seq_.load(std::memory_order_acquire);
+        if (before & 1)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        bool found = false;
+        size_t steps = 0;
+        //the Node versions of the getters load each link once and skip the
+        //checked downcast, which would read it a second time
+        Node<Key, Value>* curr = this->root_;
+        while (curr != nullptr && steps++ < MAX_STEPS)
+        {
+            if (key < curr->getKey())
+            {
+                curr = curr->Node<Key, Value>::getLeft();
+            }
+            else if (curr->getKey() < key)
+            {
+                curr = curr->Node<Key, Value>::getRight();
+            }
+            else
+            {
+                if (valueOut != nullptr)
+                {
+                    memcpy(&copy, &curr->getValue(), sizeof(Value));
+                }
+                found = true;
+                break;
+            }
+        }
+        bool finished = found || curr == nullptr;
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (finished && seq_.load(std::memory_order_relaxed) == before)
+        {
+            exitRead(slot, epoch);
+            if (found && valueOut != nullptr)
+            {
+                memcpy(valueOut, &copy, sizeof(Value));
+            }
+            return found;
+        }
+    }
+}
+
+/**
+* Slot used by the calling thread, handed out round robin the first time a
+* thread reads. Threads that end up sharing a slot stay correct, they just
+* share its cache line.
+*/
+template<class Key, class Value>
+size_t SeqlockAVLTree<Key, Value>::slotIndex()
+{
+    static std::atomic<size_t> next(0);
+    static thread_local size_t index = next++ % READER_SLOTS;
+    return index;
+}
+
+#endif
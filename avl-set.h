@@ -0,0 +1,584 @@
+#ifndef AVL_SET_H
+#define AVL_SET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+#include "avlbst.h"
+#include "intrusive-avl.h"
+
+/**
+* Node of a KeySet: the intrusive hook's links and balance factor followed
+* by the key and nothing else. There is no value and no vtable, so for a
+* small key the node is three pointers plus the key (the balance byte and a
+* 4-byte key share the hook's tail padding).
+*/
+template <class Key>
+struct SetNode : public AVLHook<>
+{
+    explicit SetNode(const Key& key);
+
+    Key key_;
+};
+
+template<class Key>
+SetNode<Key>::SetNode(const Key& key) :
+    AVLHook<>(), key_(key)
+{
+
+}
+
+/**
+* An ordered set of unique keys with the find/iterator interface of
+* BinarySearchTree, for code that used AVLTree<Key, bool> or
+* BinarySearchTree<Key, char> only for the keys. Dropping the value, the
+* pair and the vptr takes an int node from 48 bytes down to 32.
+*
+* Balanced picks the tree: true rebalances through AVLAlgo like AVLTree
+* (AVLSet), false is a plain unbalanced search tree like BinarySearchTree
+* (BSTSet). Both share the node layout, the unbalanced one just never
+* looks at the balance byte.
+*/
+template <class Key, bool Balanced>
+class KeySet
+{
+public:
+    typedef AVLHook<> Hook;
+
+    /**
+    * In-order iterator over the keys, which are read-only.
+    */
+    class iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef Key value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const Key* pointer;
+        typedef const Key& reference;
+
+        iterator();
+
+        const Key& operator*() const;
+        const Key* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class KeySet<Key, Balanced>;
+        explicit iterator(Hook* ptr);
+        Hook* current_;
+    };
+
+    KeySet();
+    KeySet(const KeySet& other);
+    KeySet(KeySet&& other) noexcept;
+    ~KeySet();
+    KeySet& operator=(const KeySet& other);
+    KeySet& operator=(KeySet&& other) noexcept;
+    void swap(KeySet& other) noexcept;
+
+    bool insert(const Key& key);
+    void remove(const Key& key);
+    void clear();
+    bool isBalanced() const;
+    bool empty() const;
+    size_t size() const;
+    bool contains(const Key& key) const;
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    iterator erase(iterator pos);
+
+protected:
+    static SetNode<Key>* nodeOf(Hook* h);
+    static const Key& keyOf(Hook* h);
+    void copyFrom(const KeySet& other);
+    int heightOf(Hook* n, bool& balanced) const;
+
+    // Used by AVLAlgo during rebalancing
+    void rotateLeft(Hook* n);
+    void rotateRight(Hook* n);
+    void nodeSwap(Hook* n1, Hook* n2);
+    friend struct AVLAlgo;
+
+    Hook* root_;
+    size_t size_;
+};
+
+/**
+* The set counterparts of AVLTree and BinarySearchTree.
+*/
+template <class Key>
+using AVLSet = KeySet<Key, true>;
+
+template <class Key>
+using BSTSet = KeySet<Key, false>;
+
+/*
+------------------------------------------------------
+Begin implementations for the KeySet::iterator class.
+------------------------------------------------------
+*/
+
+template<class Key, bool Balanced>
+KeySet<Key, Balanced>::iterator::iterator() :
+    current_(nullptr)
+{
+
+}
+
+template<class Key, bool Balanced>
+KeySet<Key, Balanced>::iterator::iterator(Hook* ptr) :
+    current_(ptr)
+{
+
+}
+
+template<class Key, bool Balanced>
+const Key& KeySet<Key, Balanced>::iterator::operator*() const
+{
+    return keyOf(current_);
+}
+
+template<class Key, bool Balanced>
+const Key* KeySet<Key, Balanced>::iterator::operator->() const
+{
+    return &keyOf(current_);
+}
+
+template<class Key, bool Balanced>
+bool KeySet<Key, Balanced>::iterator::operator==(const iterator& rhs) const
+{
+    return current_ == rhs.current_;
+}
+
+template<class Key, bool Balanced>
+bool KeySet<Key, Balanced>::iterator::operator!=(const iterator& rhs) const
+{
+    return current_ != rhs.current_;
+}
+
+/**
+* Steps to the in-order successor using the parent links.
+*/
+template<class Key, bool Balanced>
+typename KeySet<Key, Balanced>::iterator&
+KeySet<Key, Balanced>::iterator::operator++()
+{
+    if (current_->getRight() != nullptr)
+    {
+        current_ = current_->getRight();
+        while (current_->getLeft() != nullptr)
+        {
+            current_ = current_->getLeft();
+        }
+        return *this;
+    }
+
+    //go up until we come from a left subtree
+    Hook* child = current_;
+    current_ = current_->getParent();
+    while (current_ != nullptr && current_->getRight() == child)
+    {
+        child = current_;
+        current_ = current_->getParent();
+    }
+    return *this;
+}
+
+/*
+----------------------------------------------------
+End implementations for the KeySet::iterator class.
+----------------------------------------------------
+*/
+
+template<class Key, bool Balanced>
+KeySet<Key, Balanced>::KeySet() :
+    root_(nullptr), size_(0)
+{
+
+}
+
+template<class Key, bool Balanced>
+KeySet<Key, Balanced>::KeySet(const KeySet<Key, Balanced>& other) :
+    root_(nullptr), size_(0)
+{
+    copyFrom(other);
+}
+
+template<class Key, bool Balanced>
+KeySet<Key, Balanced>::KeySet(KeySet<Key, Balanced>&& other) noexcept :
+    root_(other.root_), size_(other.size_)
+{
+    other.root_ = nullptr;
+    other.size_ = 0;
+}
+
+template<class Key, bool Balanced>
+KeySet<Key, Balanced>::~KeySet()
+{
+    clear();
+}
+
+template<class Key, bool Balanced>
+KeySet<Key, Balanced>& KeySet<Key, Balanced>::operator=(const KeySet<Key, Balanced>& other)
+{
+    if (this != &other)
+    {
+        KeySet<Key, Balanced> copy(other);
+        swap(copy);
+    }
+    return *this;
+}
+
+template<class Key, bool Balanced>
+KeySet<Key, Balanced>& KeySet<Key, Balanced>::operator=(KeySet<Key, Balanced>&& other) noexcept
+{
+    if (this != &other)
+    {
+        clear();
+        swap(other);
+    }
+    return *this;
+}
+
+template<class Key, bool Balanced>
+void KeySet<Key, Balanced>::swap(KeySet<Key, Balanced>& other) noexcept
+{
+    std::swap(root_, other.root_);
+    std::swap(size_, other.size_);
+}
+
+/**
+* Adds key. Returns false, changing nothing, if it was already there.
+*/
+template<class Key, bool Balanced>
+bool KeySet<Key, Balanced>::insert(const Key& key)
+{
+    if (root_ == nullptr)
+    {
+        root_ = new SetNode<Key>(key);
+        ++size_;
+        return true;
+    }
+
+    Hook* temp = root_;
+    bool left;
+    while (true)
+    {
+        if (key < keyOf(temp))
+        {
+            left = true;
+            if (temp->getLeft() == nullptr)
+            {
+                break;
+            }
+            temp = temp->getLeft();
+        }
+        else if (keyOf(temp) < key)
+        {
+            left = false;
+            if (temp->getRight() == nullptr)
+            {
+                break;
+            }
+            temp = temp->getRight();
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    Hook* baby = new SetNode<Key>(key);
+    if (Balanced)
+    {
+        AVLAlgo::linkLeaf(*this, temp, baby, left);
+    }
+    else
+    {
+        baby->setParent(temp);
+        if (left)
+        {
+            temp->setLeft(baby);
+        }
+        else
+        {
+            temp->setRight(baby);
+        }
+    }
+    ++size_;
+    return true;
+}
+
+template<class Key, bool Balanced>
+void KeySet<Key, Balanced>::remove(const Key& key)
+{
+    iterator it = find(key);
+    if (it != end())
+    {
+        erase(it);
+    }
+}
+
+/**
+* Removes the key at pos and returns an iterator to the next one.
+*/
+template<class Key, bool Balanced>
+typename KeySet<Key, Balanced>::iterator
+KeySet<Key, Balanced>::erase(iterator pos)
+{
+    iterator next = pos;
+    ++next;
+
+    int8_t diff = 0;
+    Hook* parent = AVLAlgo::unlink(*this, pos.current_, root_, diff);
+    delete nodeOf(pos.current_);
+    --size_;
+    if (Balanced)
+    {
+        AVLAlgo::removeFix(*this, parent, diff);
+    }
+    return next;
+}
+
+/**
+* Frees every node. Walks the links themselves instead of recursing, so an
+* unbalanced set of any depth can be cleared.
+*/
+template<class Key, bool Balanced>
+void KeySet<Key, Balanced>::clear()
+{
+    Hook* curr = root_;
+    while (curr != nullptr)
+    {
+        //descend to a leaf, then free it and climb back to its parent
+        if (curr->getLeft() != nullptr)
+        {
+            curr = curr->getLeft();
+        }
+        else if (curr->getRight() != nullptr)
+        {
+            curr = curr->getRight();
+        }
+        else
+        {
+            Hook* parent = curr->getParent();
+            if (parent != nullptr)
+            {
+                if (parent->getLeft() == curr)
+                {
+                    parent->setLeft(nullptr);
+                }
+                else
+                {
+                    parent->setRight(nullptr);
+                }
+            }
+            delete nodeOf(curr);
+            curr = parent;
+        }
+    }
+    root_ = nullptr;
+    size_ = 0;
+}
+
+/**
+* Same check as BinarySearchTree::isBalanced().
+*/
+template<class Key, bool Balanced>
+bool KeySet<Key, Balanced>::isBalanced() const
+{
+    bool balanced = true;
+    heightOf(root_, balanced);
+    return balanced;
+}
+
+template<class Key, bool Balanced>
+bool KeySet<Key, Balanced>::empty() const
+{
+    return root_ == nullptr;
+}
+
+template<class Key, bool Balanced>
+size_t KeySet<Key, Balanced>::size() const
+{
+    return size_;
+}
+
+template<class Key, bool Balanced>
+bool KeySet<Key, Balanced>::contains(const Key& key) const
+{
+    return find(key) != end();
+}
+
+template<class Key, bool Balanced>
+typename KeySet<Key, Balanced>::iterator
+KeySet<Key, Balanced>::begin() const
+{
+    Hook* curr = root_;
+    while (curr != nullptr && curr->getLeft() != nullptr)
+    {
+        curr = curr->getLeft();
+    }
+    return iterator(curr);
+}
+
+template<class Key, bool Balanced>
+typename KeySet<Key, Balanced>::iterator
+KeySet<Key, Balanced>::end() const
+{
+    return iterator(nullptr);
+}
+
+template<class Key, bool Balanced>
+typename KeySet<Key, Balanced>::iterator
+KeySet<Key, Balanced>::find(const Key& key) const
+{
+    Hook* curr = root_;
+    while (curr != nullptr)
+    {
+        if (key < keyOf(curr))
+        {
+            curr = curr->getLeft();
+        }
+        else if (keyOf(curr) < key)
+        {
+            curr = curr->getRight();
+        }
+        else
+        {
+            return iterator(curr);
+        }
+    }
+    return end();
+}
+
+/**
+* Iterator to the smallest key >= key, or end().
+*/
+template<class Key, bool Balanced>
+typename KeySet<Key, Balanced>::iterator
+KeySet<Key, Balanced>::lower_bound(const Key& key) const
+{
+    Hook* curr = root_;
+    Hook* best = nullptr;
+    while (curr != nullptr)
+    {
+        if (keyOf(curr) < key)
+        {
+            curr = curr->getRight();
+        }
+        else
+        {
+            best = curr;
+            curr = curr->getLeft();
+        }
+    }
+    return iterator(best);
+}
+
+template<class Key, bool Balanced>
+SetNode<Key>* KeySet<Key, Balanced>::nodeOf(Hook* h)
+{
+    return static_cast<SetNode<Key>*>(h);
+}
+
+template<class Key, bool Balanced>
+const Key& KeySet<Key, Balanced>::keyOf(Hook* h)
+{
+    return static_cast<SetNode<Key>*>(h)->key_;
+}
+
+/**
+* Copies other's shape and balance factors node for node, walking both
+* trees in step through the parent links rather than recursing.
+* @precondition this set is empty
+*/
+template<class Key, bool Balanced>
+void KeySet<Key, Balanced>::copyFrom(const KeySet<Key, Balanced>& other)
+{
+    if (other.root_ == nullptr)
+    {
+        return;
+    }
+    root_ = new SetNode<Key>(keyOf(other.root_));
+    root_->setBalance(other.root_->getBalance());
+
+    Hook* src = other.root_;
+    Hook* dst = root_;
+    while (true)
+    {
+        if (src->getLeft() != nullptr && dst->getLeft() == nullptr)
+        {
+            src = src->getLeft();
+            Hook* copy = new SetNode<Key>(keyOf(src));
+            copy->setBalance(src->getBalance());
+            copy->setParent(dst);
+            dst->setLeft(copy);
+            dst = copy;
+        }
+        else if (src->getRight() != nullptr && dst->getRight() == nullptr)
+        {
+            src = src->getRight();
+            Hook* copy = new SetNode<Key>(keyOf(src));
+            copy->setBalance(src->getBalance());
+            copy->setParent(dst);
+            dst->setRight(copy);
+            dst = copy;
+        }
+        else if (src == other.root_)
+        {
+            break;
+        }
+        else
+        {
+            src = src->getParent();
+            dst = dst->getParent();
+        }
+    }
+    size_ = other.size_;
+}
+
+template<class Key, bool Balanced>
+int KeySet<Key, Balanced>::heightOf(Hook* n, bool& balanced) const
+{
+    if (n == nullptr || !balanced)
+    {
+        return 0;
+    }
+    int left = heightOf(n->getLeft(), balanced);
+    int right = heightOf(n->getRight(), balanced);
+    if (left - right > 1 || right - left > 1)
+    {
+        balanced = false;
+    }
+    return 1 + (left > right ? left : right);
+}
+
+template<class Key, bool Balanced>
+void KeySet<Key, Balanced>::rotateLeft(Hook* n)
+{
+    AVLAlgo::rotateLeft(n, root_);
+}
+
+template<class Key, bool Balanced>
+void KeySet<Key, Balanced>::rotateRight(Hook* n)
+{
+    AVLAlgo::rotateRight(n, root_);
+}
+
+template<class Key, bool Balanced>
+void KeySet<Key, Balanced>::nodeSwap(Hook* n1, Hook* n2)
+{
+    AVLAlgo::swapNodes(n1, n2, root_);
+}
+
+#endif
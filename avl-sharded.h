@@ -0,0 +1,557 @@
+#ifndef AVL_SHARDED_H
+#define AVL_SHARDED_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "avlbst.h"
+
+/**
+* A thread-safe ordered map that splits the key space into ranges, each
+* held by its own AVLTree behind its own mutex, so writers to different
+* ranges do not contend.
+*
+* The range boundaries live in an immutable routing table that is swapped
+* with std::atomic_store whenever shards are split or merged; operations
+* load it with std::atomic_load, lock the shard their key routes to, and
+* retry if that shard was retired by a rebalance in the meantime.
+*
+* Shards are rebalanced automatically: a shard that grows past twice its
+* fair share (and past the split threshold) is split at its median key, and
+* once removals leave more than twice the target number of shards, adjacent
+* small shards are merged. presplit() sets the initial boundaries from a
+* sample of expected keys.
+*
+* forEach() and range() visit keys in order, locking one shard at a time:
+* each shard is seen consistently, but writes to other shards during the
+* scan may or may not be seen. Their callbacks run under a shard lock and
+* must not call back into the map.
+*/
+template <class Key, class Value>
+class ShardedAVLMap
+{
+public:
+    explicit ShardedAVLMap(size_t targetShards = 16);
+
+    // Shards hold mutexes, so the map is neither copyable nor movable.
+    ShardedAVLMap(const ShardedAVLMap&) = delete;
+    ShardedAVLMap& operator=(const ShardedAVLMap&) = delete;
+
+    void insert(const std::pair<const Key, Value>& new_item);
+    void remove(const Key& key);
+    bool find(const Key& key, Value& out) const;
+
+    template<class Visit>
+    void forEach(Visit visit) const;
+    template<class Visit>
+    void range(const Key& lo, const Key& hi, Visit visit) const;
+
+    void presplit(std::vector<Key> sample);
+    void rebalance();
+    void setSplitThreshold(size_t minKeys);
+
+    size_t size() const;
+    size_t shardCount() const;
+
+protected:
+    /**
+    * AVLTree exposing single-descent upsert/erase that report whether the
+    * key count changed.
+    */
+    class ShardTree : public AVLTree<Key, Value>
+    {
+    public:
+        bool upsert(const std::pair<const Key, Value>& new_item)
+        {
+            bool inserted = false;
+            AVLNode<Key, Value>* node = this->insertOrFind(new_item, inserted);
+            if (!inserted)
+            {
+                node->setValue(new_item.second);
+            }
+            return inserted;
+        }
+
+        bool erase(const Key& key)
+        {
+            Node<Key, Value>* node = this->internalFind(key);
+            if (node == nullptr)
+            {
+                return false;
+            }
+            this->removeNode(node);
+            return true;
+        }
+    };
+
+    struct Shard
+    {
+        Shard() : count(0), retired(false) {}
+
+        std::mutex lock;
+        ShardTree tree;
+        std::atomic<size_t> count;  // keys in tree, readable without the lock
+        bool retired;               // set under lock once the keys moved to new shards
+    };
+
+    /**
+    * shards[i] holds the keys k with splits[i-1] <= k < splits[i].
+    */
+    struct Routing
+    {
+        std::vector<Key> splits;
+        std::vector<std::shared_ptr<Shard> > shards;
+    };
+
+    std::shared_ptr<const Routing> loadRouting() const;
+    static size_t routeIndex(const Routing& routing, const Key& key);
+    std::shared_ptr<Shard> lockShard(const Key& key, std::unique_lock<std::mutex>& guard) const;
+    size_t splitAt() const;
+    void maybeRebalance(size_t shardKeys, bool grew);
+    void rebalanceLocked();
+    static void fillShard(Shard& shard, const std::vector<std::pair<Key, Value> >& items, size_t lo, size_t hi);
+    template<class Visit>
+    void scan(const Key* lo, const Key* hi, Visit& visit) const;
+
+    std::shared_ptr<const Routing> routing_;    // only accessed through std::atomic_load/atomic_store
+    std::mutex rebalanceLock_;                  // one rebalance at a time
+    std::atomic<size_t> size_;
+    std::atomic<size_t> splitThreshold_;
+    size_t targetShards_;
+};
+
+template<class Key, class Value>
+ShardedAVLMap<Key, Value>::ShardedAVLMap(size_t targetShards) :
+    size_(0), splitThreshold_(4096), targetShards_(targetShards == 0 ? 1 : targetShards)
+{
+    std::shared_ptr<Routing> routing(new Routing());
+    routing->shards.push_back(std::make_shared<Shard>());
+    std::atomic_store(&routing_, std::shared_ptr<const Routing>(routing));
+}
+
+/**
+* Inserts new_item, overwriting the value if the key is already present.
+*/
+template<class Key, class Value>
+void ShardedAVLMap<Key, Value>::insert(const std::pair<const Key, Value>& new_item)
+{
+    size_t shardKeys = 0;
+    {
+        std::unique_lock<std::mutex> guard;
+        std::shared_ptr<Shard> shard = lockShard(new_item.first, guard);
+        if (!shard->tree.upsert(new_item))
+        {
+            return;
+        }
+        shardKeys = ++shard->count;
+        ++size_;
+    }
+    maybeRebalance(shardKeys, true);
+}
+
+template<class Key, class Value>
+void ShardedAVLMap<Key, Value>::remove(const Key& key)
+{
+    size_t shardKeys = 0;
+    {
+        std::unique_lock<std::mutex> guard;
+        std::shared_ptr<Shard> shard = lockShard(key, guard);
+        if (!shard->tree.erase(key))
+        {
+            return;
+        }
+        shardKeys = --shard->count;
+        --size_;
+    }
+    maybeRebalance(shardKeys, false);
+}
+
+/**
+* Copies the value for key into out and returns true, or returns false if
+* the key is absent. Values are copied because no reference into a shard
+* stays valid once its lock is released.
+*/
+template<class Key, class Value>
+bool ShardedAVLMap<Key, Value>::find(const Key& key, Value& out) const
+{
+    std::unique_lock<std::mutex> guard;
+    std::shared_ptr<Shard> shard = lockShard(key, guard);
+    typename BinarySearchTree<Key, Value>::iterator it = shard->tree.find(key);
+    if (it == shard->tree.end())
+    {
+        return false;
+    }
+    out = it->second;
+    return true;
+}
+
+/**
+* Calls visit(key, value) for every item, in key order.
+*/
+template<class Key, class Value>
+template<class Visit>
+void ShardedAVLMap<Key, Value>::forEach(Visit visit) const
+{
+    scan(nullptr, nullptr, visit);
+}
+
+/**
+* Calls visit(key, value) for every item with lo <= key <= hi, in key order.
+*/
+template<class Key, class Value>
+template<class Visit>
+void ShardedAVLMap<Key, Value>::range(const Key& lo, const Key& hi, Visit visit) const
+{
+    if (hi < lo)
+    {
+        return;
+    }
+    scan(&lo, &hi, visit);
+}
+
+/**
+* Redistributes the map over targetShards shards whose boundaries are
+* quantiles of sample, e.g. keys seen in production. Best done while the
+* map is still empty, but works at any time.
+*/
+template<class Key, class Value>
+void ShardedAVLMap<Key, Value>::presplit(std::vector<Key> sample)
+{
+    std::sort(sample.begin(), sample.end());
+    sample.erase(std::unique(sample.begin(), sample.end(),
+        [](const Key& a, const Key& b) { return !(a < b) && !(b < a); }), sample.end());
+
+    std::shared_ptr<Routing> next(new Routing());
+    for (size_t i = 1; i < targetShards_; ++i)
+    {
+        size_t at = i * sample.size() / targetShards_;
+        if (at > 0 && at < sample.size() && (next->splits.empty() || next->splits.back() < sample[at]))
+        {
+            next->splits.push_back(sample[at]);
+        }
+    }
+
+    std::lock_guard<std::mutex> rebalancing(rebalanceLock_);
+    std::shared_ptr<const Routing> current = loadRouting();
+
+    //lock every shard in key order and collect everything, already sorted
+    std::vector<std::unique_lock<std::mutex> > guards;
+    std::vector<std::pair<Key, Value> > items;
+    for (size_t i = 0; i < current->shards.size(); ++i)
+    {
+        Shard& shard = *current->shards[i];
+        guards.push_back(std::unique_lock<std::mutex>(shard.lock));
+        for (typename BinarySearchTree<Key, Value>::iterator it = shard.tree.begin(); it != shard.tree.end(); ++it)
+        {
+            items.push_back(std::make_pair(it->first, it->second));
+        }
+        shard.retired = true;
+    }
+
+    size_t begin = 0;
+    for (size_t i = 0; i <= next->splits.size(); ++i)
+    {
+        size_t end = begin;
+        while (end < items.size() && (i == next->splits.size() || items[end].first < next->splits[i]))
+        {
+            ++end;
+        }
+        std::shared_ptr<Shard> shard = std::make_shared<Shard>();
+        fillShard(*shard, items, begin, end);
+        next->shards.push_back(shard);
+        begin = end;
+    }
+
+    //publish before unlocking, so anyone waiting on an old shard retries against the new table
+    std::atomic_store(&routing_, std::shared_ptr<const Routing>(next));
+}
+
+/**
+* Splits oversized shards and merges undersized neighbours now, instead of
+* waiting for an insert or remove to notice.
+*/
+template<class Key, class Value>
+void ShardedAVLMap<Key, Value>::rebalance()
+{
+    std::lock_guard<std::mutex> rebalancing(rebalanceLock_);
+    rebalanceLocked();
+}
+
+/**
+* Shards are never split below minKeys keys (default 4096), which keeps
+* small maps from being cut into many tiny shards.
+*/
+template<class Key, class Value>
+void ShardedAVLMap<Key, Value>::setSplitThreshold(size_t minKeys)
+{
+    splitThreshold_ = (minKeys < 2) ? 2 : minKeys;
+}
+
+template<class Key, class Value>
+size_t ShardedAVLMap<Key, Value>::size() const
+{
+    return size_;
+}
+
+template<class Key, class Value>
+size_t ShardedAVLMap<Key, Value>::shardCount() const
+{
+    return loadRouting()->shards.size();
+}
+
+template<class Key, class Value>
+std::shared_ptr<const typename ShardedAVLMap<Key, Value>::Routing> ShardedAVLMap<Key, Value>::loadRouting() const
+{
+    return std::atomic_load(&routing_);
+}
+
+template<class Key, class Value>
+size_t ShardedAVLMap<Key, Value>::routeIndex(const Routing& routing, const Key& key)
+{
+    return std::upper_bound(routing.splits.begin(), routing.splits.end(), key) - routing.splits.begin();
+}
+
+/**
+* Locks the live shard that owns key into guard and returns it. A shard
+* retired after routing but before the lock was taken sends us back to the
+* (by then republished) routing table.
+*/
+template<class Key, class Value>
+std::shared_ptr<typename ShardedAVLMap<Key, Value>::Shard>
+ShardedAVLMap<Key, Value>::lockShard(const Key& key, std::unique_lock<std::mutex>& guard) const
+{
+    while (true)
+    {
+        std::shared_ptr<const Routing> routing = loadRouting();
+        std::shared_ptr<Shard> shard = routing->shards[routeIndex(*routing, key)];
+        guard = std::unique_lock<std::mutex>(shard->lock);
+        if (!shard->retired)
+        {
+            return shard;
+        }
+        guard.unlock();
+    }
+}
+
+/**
+* Shard size above which a shard gets split: twice the fair share of keys,
+* but never below the split threshold.
+*/
+template<class Key, class Value>
+size_t ShardedAVLMap<Key, Value>::splitAt() const
+{
+    size_t fair = 2 * size_ / targetShards_;
+    size_t threshold = splitThreshold_;
+    return (fair > threshold) ? fair : threshold;
+}
+
+/**
+* Called without any shard lock after a write changed a shard to shardKeys
+* keys. Rebalances if that shard got too big, or after removals if there
+* are far more shards than wanted. Skipped if a rebalance is already running.
+*/
+template<class Key, class Value>
+void ShardedAVLMap<Key, Value>::maybeRebalance(size_t shardKeys, bool grew)
+{
+    bool wanted = grew ? (shardKeys > splitAt()) : (shardCount() > 2 * targetShards_);
+    if (!wanted)
+    {
+        return;
+    }
+
+    std::unique_lock<std::mutex> rebalancing(rebalanceLock_, std::try_to_lock);
+    if (rebalancing.owns_lock())
+    {
+        rebalanceLocked();
+    }
+}
+
+/**
+* Builds the next routing table in one pass over the current one: shards
+* above splitAt() are cut into pieces of about half that size at their
+* median keys, adjacent shards that together stay at or below half of it
+* are merged, the rest are carried over as they are. The counts are read
+* without locks to pick candidates; a candidate is then locked (in key
+* order) and the decision is made again on its locked count, so a shard
+* that drained or shrank meanwhile is carried over instead. Only the shards
+* being replaced stay locked while their keys are copied out.
+* @precondition rebalanceLock_ is held
+*/
+template<class Key, class Value>
+void ShardedAVLMap<Key, Value>::rebalanceLocked()
+{
+    std::shared_ptr<const Routing> current = loadRouting();
+    size_t limit = splitAt();
+    size_t mergeLimit = limit / 2;
+    bool mayMerge = current->shards.size() > targetShards_;
+
+    std::shared_ptr<Routing> next(new Routing());
+    std::vector<std::unique_lock<std::mutex> > guards;
+    bool changed = false;
+
+    size_t i = 0;
+    while (i < current->shards.size())
+    {
+        const std::shared_ptr<Shard>& shard = current->shards[i];
+        //unlocked counts can still move, so they only pick the candidates
+        bool tryMerge = mayMerge && i + 1 < current->shards.size()
+            && shard->count + current->shards[i + 1]->count <= mergeLimit;
+        bool canMerge = false;
+        bool canSplit = false;
+        if (tryMerge || shard->count > limit)
+        {
+            //decide again under the locks, where the counts hold still
+            guards.push_back(std::unique_lock<std::mutex>(shard->lock));
+            if (tryMerge)
+            {
+                guards.push_back(std::unique_lock<std::mutex>(current->shards[i + 1]->lock));
+                canMerge = shard->count + current->shards[i + 1]->count <= mergeLimit;
+                if (!canMerge)
+                {
+                    guards.pop_back();
+                }
+            }
+            canSplit = !canMerge && shard->count > limit && !shard->tree.empty();
+            if (!canMerge && !canSplit)
+            {
+                guards.pop_back();
+            }
+        }
+        size_t take = canMerge ? 2 : 1;
+
+        if (!canMerge && !canSplit)
+        {
+            //carried over unchanged, boundary included
+            if (i > 0)
+            {
+                next->splits.push_back(current->splits[i - 1]);
+            }
+            next->shards.push_back(shard);
+            ++i;
+            continue;
+        }
+
+        //collect the keys of the shard (or pair) being replaced, already locked above
+        std::vector<std::pair<Key, Value> > items;
+        for (size_t j = i; j < i + take; ++j)
+        {
+            Shard& old = *current->shards[j];
+            for (typename BinarySearchTree<Key, Value>::iterator it = old.tree.begin(); it != old.tree.end(); ++it)
+            {
+                items.push_back(std::make_pair(it->first, it->second));
+            }
+            old.retired = true;
+        }
+
+        //a merge makes one piece; a split makes enough pieces to land near half the limit
+        size_t pieces = 1;
+        if (!canMerge)
+        {
+            size_t piece = (limit / 2 > 0) ? limit / 2 : 1;
+            pieces = std::max((items.size() + piece - 1) / piece, (size_t)2);
+            pieces = std::min(pieces, items.size());
+        }
+
+        if (i > 0)
+        {
+            next->splits.push_back(current->splits[i - 1]);
+        }
+        for (size_t p = 0; p < pieces; ++p)
+        {
+            size_t lo = p * items.size() / pieces;
+            size_t hi = (p + 1) * items.size() / pieces;
+            if (p > 0)
+            {
+                next->splits.push_back(items[lo].first);
+            }
+            std::shared_ptr<Shard> piece = std::make_shared<Shard>();
+            fillShard(*piece, items, lo, hi);
+            next->shards.push_back(piece);
+        }
+        changed = true;
+        i += take;
+    }
+
+    if (changed)
+    {
+        //publish before the old shards unlock, see presplit()
+        std::atomic_store(&routing_, std::shared_ptr<const Routing>(next));
+    }
+}
+
+/**
+* Loads items[lo, hi), sorted by key, into an empty shard in O(hi - lo)
+* through AVLTree::apply_batch's bulk build.
+*/
+template<class Key, class Value>
+void ShardedAVLMap<Key, Value>::fillShard(Shard& shard, const std::vector<std::pair<Key, Value> >& items, size_t lo, size_t hi)
+{
+    std::vector<BatchOp<Key, Value> > ops;
+    ops.reserve(hi - lo);
+    for (size_t i = lo; i < hi; ++i)
+    {
+        ops.push_back(BatchOp<Key, Value>::upsert(items[i].first, items[i].second));
+    }
+    shard.tree.apply_batch(ops);
+    shard.count = hi - lo;
+}
+
+/**
+* Ordered walk shared by forEach() and range(); lo/hi are null for an
+* unbounded side. The last key visited is remembered, so when a shard turns
+* out to be retired the walk reloads the routing table and resumes right
+* after that key without repeating or skipping anything.
+*/
+template<class Key, class Value>
+template<class Visit>
+void ShardedAVLMap<Key, Value>::scan(const Key* lo, const Key* hi, Visit& visit) const
+{
+    bool started = false;
+    Key last = Key();
+
+    while (true)
+    {
+        std::shared_ptr<const Routing> routing = loadRouting();
+        size_t idx = started ? routeIndex(*routing, last) : (lo != nullptr ? routeIndex(*routing, *lo) : 0);
+        bool retry = false;
+
+        for (; idx < routing->shards.size(); ++idx)
+        {
+            Shard& shard = *routing->shards[idx];
+            std::unique_lock<std::mutex> guard(shard.lock);
+            if (shard.retired)
+            {
+                retry = true;
+                break;
+            }
+
+            typename BinarySearchTree<Key, Value>::iterator it =
+                started ? shard.tree.lower_bound(last) : (lo != nullptr ? shard.tree.lower_bound(*lo) : shard.tree.begin());
+            for (; it != shard.tree.end(); ++it)
+            {
+                if (hi != nullptr && *hi < it->first)
+                {
+                    return;
+                }
+                if (started && !(last < it->first))
+                {
+                    continue;
+                }
+                visit(it->first, it->second);
+                last = it->first;
+                started = true;
+            }
+        }
+
+        if (!retry)
+        {
+            return;
+        }
+    }
+}
+
+#endif
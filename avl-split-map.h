@@ -0,0 +1,307 @@
+#ifndef AVL_SPLIT_MAP_H
+#define AVL_SPLIT_MAP_H
+
+#include <cstdint>
+#include <deque>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "avlbst.h"
+
+/**
+* An ordered map that keeps its values out of line, for large Values.
+*
+* The search tree is an AVLTree<Key, uint32_t> whose nodes hold only the
+* key, the links and a 4-byte slot number, so find(), insert() and the
+* rotations walk small hot nodes and never pull value bytes into cache. The
+* values live in a separate arena (a std::deque, so they never move once
+* stored) and are only read when an iterator is dereferenced. Slots freed
+* by remove() go on a free list and are reused by later inserts.
+*
+* Value must be default constructible: a removed slot is reset to Value()
+* so it does not keep the old value's resources alive. As in
+* BinarySearchTree, operator[] only looks keys up; insert() adds them.
+*/
+template <class Key, class Value>
+class SplitAVLMap
+{
+public:
+    /**
+    * The search tree, with a single-descent lookup-or-insert of a slot.
+    */
+    class Index : public AVLTree<Key, uint32_t>
+    {
+    public:
+        uint32_t& slotFor(const Key& key, bool& inserted)
+        {
+            return this->insertOrFind(std::make_pair(key, (uint32_t)0), inserted)->getValue();
+        }
+    };
+
+    /**
+    * In-order iterator. Dereferencing gives a pair of references, the key
+    * from the hot node and the value from the arena.
+    */
+    class iterator
+    {
+    public:
+        typedef std::pair<const Key&, Value&> reference;
+
+        // operator-> hands out a pointer to this, since the pair is built on the fly
+        struct arrow
+        {
+            reference ref;
+            reference* operator->() { return &ref; }
+        };
+
+        iterator();
+
+        reference operator*() const;
+        arrow operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class SplitAVLMap<Key, Value>;
+        iterator(typename Index::iterator pos, std::deque<Value>* values);
+        typename Index::iterator pos_;
+        std::deque<Value>* values_;
+    };
+
+    SplitAVLMap();
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool empty() const;
+    bool isBalanced() const;
+    void setFingerSearch(bool enabled);
+
+    iterator begin();
+    iterator end();
+    iterator find(const Key& key);
+    iterator lower_bound(const Key& key);
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+protected:
+    uint32_t store(const Value& value);
+
+    Index index_;
+    std::deque<Value> values_;
+    std::vector<uint32_t> freeSlots_;
+};
+
+/*
+---------------------------------------------------------
+Begin implementations for the SplitAVLMap::iterator class.
+---------------------------------------------------------
+*/
+
+template<class Key, class Value>
+SplitAVLMap<Key, Value>::iterator::iterator() :
+    pos_(), values_(nullptr)
+{
+
+}
+
+template<class Key, class Value>
+SplitAVLMap<Key, Value>::iterator::iterator(typename Index::iterator pos, std::deque<Value>* values) :
+    pos_(pos), values_(values)
+{
+
+}
+
+template<class Key, class Value>
+typename SplitAVLMap<Key, Value>::iterator::reference
+SplitAVLMap<Key, Value>::iterator::operator*() const
+{
+    return reference(pos_->first, (*values_)[pos_->second]);
+}
+
+template<class Key, class Value>
+typename SplitAVLMap<Key, Value>::iterator::arrow
+SplitAVLMap<Key, Value>::iterator::operator->() const
+{
+    arrow a = { **this };
+    return a;
+}
+
+template<class Key, class Value>
+bool SplitAVLMap<Key, Value>::iterator::operator==(const iterator& rhs) const
+{
+    return pos_ == rhs.pos_;
+}
+
+template<class Key, class Value>
+bool SplitAVLMap<Key, Value>::iterator::operator!=(const iterator& rhs) const
+{
+    return pos_ != rhs.pos_;
+}
+
+template<class Key, class Value>
+typename SplitAVLMap<Key, Value>::iterator&
+SplitAVLMap<Key, Value>::iterator::operator++()
+{
+    ++pos_;
+    return *this;
+}
+
+/*
+-------------------------------------------------------
+End implementations for the SplitAVLMap::iterator class.
+-------------------------------------------------------
+*/
+
+template<class Key, class Value>
+SplitAVLMap<Key, Value>::SplitAVLMap()
+{
+
+}
+
+/**
+* Overwrites the value in place if key is present, otherwise stores the
+* value in a free (or new) slot and indexes it. Either way the index is
+* searched once; a new key is unindexed again if storing its value throws.
+*/
+template<class Key, class Value>
+void SplitAVLMap<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    bool inserted = false;
+    uint32_t& slot = index_.slotFor(keyValuePair.first, inserted);
+    if (!inserted)
+    {
+        values_[slot] = keyValuePair.second;
+        return;
+    }
+    try
+    {
+        slot = store(keyValuePair.second);
+    }
+    catch (...)
+    {
+        index_.remove(keyValuePair.first);
+        throw;
+    }
+}
+
+template<class Key, class Value>
+void SplitAVLMap<Key, Value>::remove(const Key& key)
+{
+    typename Index::iterator it = index_.find(key);
+    if (it == index_.end())
+    {
+        return;
+    }
+    uint32_t slot = it->second;
+    index_.erase(it);
+    values_[slot] = Value();
+    freeSlots_.push_back(slot);
+}
+
+template<class Key, class Value>
+void SplitAVLMap<Key, Value>::clear()
+{
+    index_.clear();
+    values_.clear();
+    freeSlots_.clear();
+}
+
+template<class Key, class Value>
+bool SplitAVLMap<Key, Value>::empty() const
+{
+    return index_.empty();
+}
+
+template<class Key, class Value>
+bool SplitAVLMap<Key, Value>::isBalanced() const
+{
+    return index_.isBalanced();
+}
+
+template<class Key, class Value>
+void SplitAVLMap<Key, Value>::setFingerSearch(bool enabled)
+{
+    index_.setFingerSearch(enabled);
+}
+
+template<class Key, class Value>
+typename SplitAVLMap<Key, Value>::iterator
+SplitAVLMap<Key, Value>::begin()
+{
+    return iterator(index_.begin(), &values_);
+}
+
+template<class Key, class Value>
+typename SplitAVLMap<Key, Value>::iterator
+SplitAVLMap<Key, Value>::end()
+{
+    return iterator(index_.end(), &values_);
+}
+
+template<class Key, class Value>
+typename SplitAVLMap<Key, Value>::iterator
+SplitAVLMap<Key, Value>::find(const Key& key)
+{
+    return iterator(index_.find(key), &values_);
+}
+
+template<class Key, class Value>
+typename SplitAVLMap<Key, Value>::iterator
+SplitAVLMap<Key, Value>::lower_bound(const Key& key)
+{
+    return iterator(index_.lower_bound(key), &values_);
+}
+
+/**
+* Same as BinarySearchTree::operator[]: throws std::out_of_range for a
+* missing key rather than inserting one.
+*/
+template<class Key, class Value>
+Value& SplitAVLMap<Key, Value>::operator[](const Key& key)
+{
+    typename Index::iterator it = index_.find(key);
+    if (it == index_.end())
+    {
+        throw std::out_of_range("Invalid key");
+    }
+    return values_[it->second];
+}
+
+template<class Key, class Value>
+Value const & SplitAVLMap<Key, Value>::operator[](const Key& key) const
+{
+    typename Index::iterator it = index_.find(key);
+    if (it == index_.end())
+    {
+        throw std::out_of_range("Invalid key");
+    }
+    return values_[it->second];
+}
+
+/**
+* Puts value in a free slot, or a new one at the end of the arena, and
+* returns the slot number.
+*/
+template<class Key, class Value>
+uint32_t SplitAVLMap<Key, Value>::store(const Value& value)
+{
+    if (!freeSlots_.empty())
+    {
+        uint32_t slot = freeSlots_.back();
+        freeSlots_.pop_back();
+        values_[slot] = value;
+        return slot;
+    }
+    if (values_.size() >= UINT32_MAX)
+    {
+        throw std::length_error("SplitAVLMap holds at most 2^32 - 1 values");
+    }
+    values_.push_back(value);
+    return (uint32_t)(values_.size() - 1);
+}
+
+#endif
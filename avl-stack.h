@@ -0,0 +1,751 @@
+#ifndef AVL_STACK_H
+#define AVL_STACK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+/**
+* Node of a StackAVLTree: the key/value pair, two child links and the
+* balance factor. No parent link and no vtable, so an AVLNode<int, int>'s
+* 48 bytes become 32.
+*/
+template <class Key, class Value>
+class StackAVLNode
+{
+public:
+    StackAVLNode(const Key& key, const Value& value);
+
+    const std::pair<const Key, Value>& getItem() const;
+    std::pair<const Key, Value>& getItem();
+    const Key& getKey() const;
+    const Value& getValue() const;
+    Value& getValue();
+    void setValue(const Value& value);
+
+    StackAVLNode* getLeft() const;
+    StackAVLNode* getRight() const;
+    void setLeft(StackAVLNode* left);
+    void setRight(StackAVLNode* right);
+
+    int8_t getBalance () const;
+    void setBalance (int8_t balance);
+    void updateBalance(int8_t diff);
+
+protected:
+    std::pair<const Key, Value> item_;
+    StackAVLNode* left_;
+    StackAVLNode* right_;
+    int8_t balance_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the StackAVLNode class.
+  -------------------------------------------------
+*/
+
+template<class Key, class Value>
+StackAVLNode<Key, Value>::StackAVLNode(const Key& key, const Value& value) :
+    item_(key, value), left_(nullptr), right_(nullptr), balance_(0)
+{
+
+}
+
+template<class Key, class Value>
+const std::pair<const Key, Value>& StackAVLNode<Key, Value>::getItem() const
+{
+    return item_;
+}
+
+template<class Key, class Value>
+std::pair<const Key, Value>& StackAVLNode<Key, Value>::getItem()
+{
+    return item_;
+}
+
+template<class Key, class Value>
+const Key& StackAVLNode<Key, Value>::getKey() const
+{
+    return item_.first;
+}
+
+template<class Key, class Value>
+const Value& StackAVLNode<Key, Value>::getValue() const
+{
+    return item_.second;
+}
+
+template<class Key, class Value>
+Value& StackAVLNode<Key, Value>::getValue()
+{
+    return item_.second;
+}
+
+template<class Key, class Value>
+void StackAVLNode<Key, Value>::setValue(const Value& value)
+{
+    item_.second = value;
+}
+
+template<class Key, class Value>
+StackAVLNode<Key, Value>* StackAVLNode<Key, Value>::getLeft() const
+{
+    return left_;
+}
+
+template<class Key, class Value>
+StackAVLNode<Key, Value>* StackAVLNode<Key, Value>::getRight() const
+{
+    return right_;
+}
+
+template<class Key, class Value>
+void StackAVLNode<Key, Value>::setLeft(StackAVLNode<Key, Value>* left)
+{
+    left_ = left;
+}
+
+template<class Key, class Value>
+void StackAVLNode<Key, Value>::setRight(StackAVLNode<Key, Value>* right)
+{
+    right_ = right;
+}
+
+template<class Key, class Value>
+int8_t StackAVLNode<Key, Value>::getBalance() const
+{
+    return balance_;
+}
+
+template<class Key, class Value>
+void StackAVLNode<Key, Value>::setBalance(int8_t balance)
+{
+    balance_ = balance;
+}
+
+template<class Key, class Value>
+void StackAVLNode<Key, Value>::updateBalance(int8_t diff)
+{
+    balance_ += diff;
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the StackAVLNode class.
+  -----------------------------------------------
+*/
+
+/**
+* An AVL tree whose nodes have no parent pointers, for memory-bound maps.
+*
+* insert() and remove() remember the path they walked down in a fixed
+* array on the stack and rebalance back up along it, so rotations only
+* rewrite child links and balance factors. Iterators carry the ancestors
+* they still have to visit in the same kind of fixed array: they are
+* about 800 bytes each, in exchange for 8 bytes saved in every node.
+*
+* An AVL tree of n nodes is at most about 1.44 log2(n) high, so MaxDepth
+* covers any tree that fits in a 64-bit address space.
+*
+* Any insert or remove invalidates every iterator, since the ancestor
+* stacks they hold may no longer match the tree.
+*/
+template <class Key, class Value>
+class StackAVLTree
+{
+public:
+    typedef StackAVLNode<Key, Value> Node;
+    static const size_t MaxDepth = 96;
+
+    /**
+    * In-order iterator. The top of its stack is the current node and the
+    * entries below are the ancestors it went left from, i.e. the nodes
+    * that come next once the current subtree is done.
+    */
+    class iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef value_type* pointer;
+        typedef value_type& reference;
+
+        iterator();
+
+        std::pair<const Key, Value>& operator*() const;
+        std::pair<const Key, Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class StackAVLTree<Key, Value>;
+        void pushLeftSpine(Node* n);
+        Node* current() const;
+
+        Node* stack_[MaxDepth];
+        size_t depth_;
+    };
+
+    StackAVLTree();
+    StackAVLTree(const StackAVLTree& other);
+    StackAVLTree(StackAVLTree&& other) noexcept;
+    ~StackAVLTree();
+    StackAVLTree& operator=(const StackAVLTree& other);
+    StackAVLTree& operator=(StackAVLTree&& other) noexcept;
+    void swap(StackAVLTree& other) noexcept;
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool isBalanced() const;
+    bool empty() const;
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    iterator erase(iterator pos);
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+protected:
+    void replaceChild(Node** path, bool* wentRight, size_t i, Node* n);
+    static Node* rotateLeft(Node* n);
+    static Node* rotateRight(Node* n);
+    static Node* rebalance(Node* n);
+    static Node* cloneTree(const Node* src);
+    static int heightOf(const Node* n, bool& balanced);
+
+    Node* root_;
+};
+
+/*
+------------------------------------------------------------
+Begin implementations for the StackAVLTree::iterator class.
+------------------------------------------------------------
+*/
+
+template<class Key, class Value>
+StackAVLTree<Key, Value>::iterator::iterator() :
+    depth_(0)
+{
+
+}
+
+template<class Key, class Value>
+std::pair<const Key, Value>& StackAVLTree<Key, Value>::iterator::operator*() const
+{
+    return current()->getItem();
+}
+
+template<class Key, class Value>
+std::pair<const Key, Value>* StackAVLTree<Key, Value>::iterator::operator->() const
+{
+    return &(current()->getItem());
+}
+
+template<class Key, class Value>
+bool StackAVLTree<Key, Value>::iterator::operator==(const iterator& rhs) const
+{
+    return current() == rhs.current();
+}
+
+template<class Key, class Value>
+bool StackAVLTree<Key, Value>::iterator::operator!=(const iterator& rhs) const
+{
+    return current() != rhs.current();
+}
+
+/**
+* Pops the current node; its right subtree, if any, comes next, starting
+* from its leftmost node.
+*/
+template<class Key, class Value>
+typename StackAVLTree<Key, Value>::iterator&
+StackAVLTree<Key, Value>::iterator::operator++()
+{
+    Node* done = stack_[--depth_];
+    pushLeftSpine(done->getRight());
+    return *this;
+}
+
+template<class Key, class Value>
+void StackAVLTree<Key, Value>::iterator::pushLeftSpine(Node* n)
+{
+    while (n != nullptr)
+    {
+        stack_[depth_++] = n;
+        n = n->getLeft();
+    }
+}
+
+template<class Key, class Value>
+typename StackAVLTree<Key, Value>::Node* StackAVLTree<Key, Value>::iterator::current() const
+{
+    return (depth_ == 0) ? nullptr : stack_[depth_ - 1];
+}
+
+/*
+----------------------------------------------------------
+End implementations for the StackAVLTree::iterator class.
+----------------------------------------------------------
+*/
+
+template<class Key, class Value>
+StackAVLTree<Key, Value>::StackAVLTree() :
+    root_(nullptr)
+{
+
+}
+
+template<class Key, class Value>
+StackAVLTree<Key, Value>::StackAVLTree(const StackAVLTree<Key, Value>& other) :
+    root_(cloneTree(other.root_))
+{
+
+}
+
+template<class Key, class Value>
+StackAVLTree<Key, Value>::StackAVLTree(StackAVLTree<Key, Value>&& other) noexcept :
+    root_(other.root_)
+{
+    other.root_ = nullptr;
+}
+
+template<class Key, class Value>
+StackAVLTree<Key, Value>::~StackAVLTree()
+{
+    clear();
+}
+
+template<class Key, class Value>
+StackAVLTree<Key, Value>& StackAVLTree<Key, Value>::operator=(const StackAVLTree<Key, Value>& other)
+{
+    if (this != &other)
+    {
+        StackAVLTree<Key, Value> copy(other);
+        swap(copy);
+    }
+    return *this;
+}
+
+template<class Key, class Value>
+StackAVLTree<Key, Value>& StackAVLTree<Key, Value>::operator=(StackAVLTree<Key, Value>&& other) noexcept
+{
+    if (this != &other)
+    {
+        clear();
+        swap(other);
+    }
+    return *this;
+}
+
+template<class Key, class Value>
+void StackAVLTree<Key, Value>::swap(StackAVLTree<Key, Value>& other) noexcept
+{
+    std::swap(root_, other.root_);
+}
+
+/**
+* Inserts the pair, or overwrites the value if the key is present. Walks
+* back up the recorded path adjusting balances; at most one (single or
+* double) rotation restores the tree's old height and ends the walk.
+*/
+template<class Key, class Value>
+void StackAVLTree<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    const Key& key = keyValuePair.first;
+    Node* path[MaxDepth];
+    bool wentRight[MaxDepth];
+    size_t depth = 0;
+
+    Node* curr = root_;
+    while (curr != nullptr)
+    {
+        if (key < curr->getKey())
+        {
+            path[depth] = curr;
+            wentRight[depth++] = false;
+            curr = curr->getLeft();
+        }
+        else if (curr->getKey() < key)
+        {
+            path[depth] = curr;
+            wentRight[depth++] = true;
+            curr = curr->getRight();
+        }
+        else
+        {
+            curr->setValue(keyValuePair.second);
+            return;
+        }
+    }
+    replaceChild(path, wentRight, depth, new Node(key, keyValuePair.second));
+
+    for (size_t i = depth; i-- > 0; )
+    {
+        Node* p = path[i];
+        p->updateBalance(wentRight[i] ? 1 : -1);
+        if (p->getBalance() == 0)
+        {
+            return;
+        }
+        if (p->getBalance() == 2 || p->getBalance() == -2)
+        {
+            replaceChild(path, wentRight, i, rebalance(p));
+            return;
+        }
+    }
+}
+
+/**
+* Removes key if present. A node with two children is replaced by its
+* successor, which is relinked into its place (keys are const, so items
+* are never swapped). The walk back up stops at the first subtree whose
+* height did not shrink.
+*/
+template<class Key, class Value>
+void StackAVLTree<Key, Value>::remove(const Key& key)
+{
+    Node* path[MaxDepth];
+    bool wentRight[MaxDepth];
+    size_t depth = 0;
+
+    Node* curr = root_;
+    while (curr != nullptr && (key < curr->getKey() || curr->getKey() < key))
+    {
+        path[depth] = curr;
+        wentRight[depth] = curr->getKey() < key;
+        curr = wentRight[depth++] ? curr->getRight() : curr->getLeft();
+    }
+    if (curr == nullptr)
+    {
+        return;
+    }
+
+    Node* target = curr;
+    size_t at = depth;
+    if (target->getLeft() != nullptr && target->getRight() != nullptr)
+    {
+        //walk on to the successor, with target standing in on the path for now
+        path[depth] = target;
+        wentRight[depth++] = true;
+        Node* succ = target->getRight();
+        while (succ->getLeft() != nullptr)
+        {
+            path[depth] = succ;
+            wentRight[depth++] = false;
+            succ = succ->getLeft();
+        }
+
+        //unhook succ, then give it target's links, balance and position
+        replaceChild(path, wentRight, depth, succ->getRight());
+        succ->setLeft(target->getLeft());
+        succ->setRight(target->getRight());
+        succ->setBalance(target->getBalance());
+        replaceChild(path, wentRight, at, succ);
+        path[at] = succ;
+    }
+    else
+    {
+        replaceChild(path, wentRight, at, (target->getLeft() != nullptr) ? target->getLeft() : target->getRight());
+    }
+    delete target;
+
+    for (size_t i = depth; i-- > 0; )
+    {
+        Node* p = path[i];
+        p->updateBalance(wentRight[i] ? -1 : 1);
+        if (p->getBalance() == 1 || p->getBalance() == -1)
+        {
+            return;
+        }
+        if (p->getBalance() == 2 || p->getBalance() == -2)
+        {
+            Node* top = rebalance(p);
+            replaceChild(path, wentRight, i, top);
+            //a rotation that leaves the top leaning kept the old height
+            if (top->getBalance() != 0)
+            {
+                return;
+            }
+        }
+    }
+}
+
+/**
+* Frees every node without recursion or a stack: rotates left children up
+* until the root has none, then frees the root and moves to its right.
+*/
+template<class Key, class Value>
+void StackAVLTree<Key, Value>::clear()
+{
+    while (root_ != nullptr)
+    {
+        Node* left = root_->getLeft();
+        if (left != nullptr)
+        {
+            root_->setLeft(left->getRight());
+            left->setRight(root_);
+            root_ = left;
+        }
+        else
+        {
+            Node* next = root_->getRight();
+            delete root_;
+            root_ = next;
+        }
+    }
+}
+
+/**
+* Same check as BinarySearchTree::isBalanced().
+*/
+template<class Key, class Value>
+bool StackAVLTree<Key, Value>::isBalanced() const
+{
+    bool balanced = true;
+    heightOf(root_, balanced);
+    return balanced;
+}
+
+template<class Key, class Value>
+bool StackAVLTree<Key, Value>::empty() const
+{
+    return root_ == nullptr;
+}
+
+template<class Key, class Value>
+typename StackAVLTree<Key, Value>::iterator
+StackAVLTree<Key, Value>::begin() const
+{
+    iterator it;
+    it.pushLeftSpine(root_);
+    return it;
+}
+
+template<class Key, class Value>
+typename StackAVLTree<Key, Value>::iterator
+StackAVLTree<Key, Value>::end() const
+{
+    return iterator();
+}
+
+/**
+* Keeps the nodes it goes left from, which are exactly the ancestors the
+* iterator visits after key.
+*/
+template<class Key, class Value>
+typename StackAVLTree<Key, Value>::iterator
+StackAVLTree<Key, Value>::find(const Key& key) const
+{
+    iterator it;
+    Node* curr = root_;
+    while (curr != nullptr)
+    {
+        if (key < curr->getKey())
+        {
+            it.stack_[it.depth_++] = curr;
+            curr = curr->getLeft();
+        }
+        else if (curr->getKey() < key)
+        {
+            curr = curr->getRight();
+        }
+        else
+        {
+            it.stack_[it.depth_++] = curr;
+            return it;
+        }
+    }
+    return end();
+}
+
+/**
+* Iterator to the smallest key >= key, or end(). The last node gone left
+* from is that key, so the stack is already in the right state.
+*/
+template<class Key, class Value>
+typename StackAVLTree<Key, Value>::iterator
+StackAVLTree<Key, Value>::lower_bound(const Key& key) const
+{
+    iterator it;
+    Node* curr = root_;
+    while (curr != nullptr)
+    {
+        if (curr->getKey() < key)
+        {
+            curr = curr->getRight();
+        }
+        else
+        {
+            it.stack_[it.depth_++] = curr;
+            if (!(key < curr->getKey()))
+            {
+                break;
+            }
+            curr = curr->getLeft();
+        }
+    }
+    return it;
+}
+
+/**
+* Removes the item at pos and returns an iterator to the next one. The
+* removal can rotate the next node's ancestors, so the returned iterator
+* is found again from the root (nodes never move, only their links).
+*/
+template<class Key, class Value>
+typename StackAVLTree<Key, Value>::iterator
+StackAVLTree<Key, Value>::erase(iterator pos)
+{
+    iterator next = pos;
+    ++next;
+    Node* after = next.current();
+    remove(pos->first);
+    return (after == nullptr) ? end() : find(after->getKey());
+}
+
+/**
+* Same as BinarySearchTree::operator[]: throws std::out_of_range for a
+* missing key rather than inserting one.
+*/
+template<class Key, class Value>
+Value& StackAVLTree<Key, Value>::operator[](const Key& key)
+{
+    iterator it = find(key);
+    if (it == end())
+    {
+        throw std::out_of_range("Invalid key");
+    }
+    return it->second;
+}
+
+template<class Key, class Value>
+Value const & StackAVLTree<Key, Value>::operator[](const Key& key) const
+{
+    iterator it = find(key);
+    if (it == end())
+    {
+        throw std::out_of_range("Invalid key");
+    }
+    return it->second;
+}
+
+/**
+* Points the link that leads to path position i (the root, or the child
+* slot of path[i - 1] it went through) at n.
+*/
+template<class Key, class Value>
+void StackAVLTree<Key, Value>::replaceChild(Node** path, bool* wentRight, size_t i, Node* n)
+{
+    if (i == 0)
+    {
+        root_ = n;
+    }
+    else if (wentRight[i - 1])
+    {
+        path[i - 1]->setRight(n);
+    }
+    else
+    {
+        path[i - 1]->setLeft(n);
+    }
+}
+
+/**
+* Rotates n's right child up and returns it. The balance updates are the
+* general ones (balance = right height - left height), so the same rotation
+* serves insert, remove and both halves of a double rotation.
+*/
+template<class Key, class Value>
+typename StackAVLTree<Key, Value>::Node* StackAVLTree<Key, Value>::rotateLeft(Node* n)
+{
+    Node* r = n->getRight();
+    n->setRight(r->getLeft());
+    r->setLeft(n);
+
+    int8_t rb = r->getBalance();
+    n->updateBalance(-1 - (rb > 0 ? rb : 0));
+    int8_t nb = n->getBalance();
+    r->updateBalance(-1 + (nb < 0 ? nb : 0));
+    return r;
+}
+
+template<class Key, class Value>
+typename StackAVLTree<Key, Value>::Node* StackAVLTree<Key, Value>::rotateRight(Node* n)
+{
+    Node* l = n->getLeft();
+    n->setLeft(l->getRight());
+    l->setRight(n);
+
+    int8_t lb = l->getBalance();
+    n->updateBalance(1 - (lb < 0 ? lb : 0));
+    int8_t nb = n->getBalance();
+    l->updateBalance(1 + (nb > 0 ? nb : 0));
+    return l;
+}
+
+/**
+* Fixes a node with balance +-2 by a single or double rotation and returns
+* the new root of its subtree.
+*/
+template<class Key, class Value>
+typename StackAVLTree<Key, Value>::Node* StackAVLTree<Key, Value>::rebalance(Node* n)
+{
+    if (n->getBalance() > 0)
+    {
+        if (n->getRight()->getBalance() < 0)
+        {
+            n->setRight(rotateRight(n->getRight()));
+        }
+        return rotateLeft(n);
+    }
+    if (n->getLeft()->getBalance() > 0)
+    {
+        n->setLeft(rotateLeft(n->getLeft()));
+    }
+    return rotateRight(n);
+}
+
+/**
+* Recursion is fine here: the depth is bounded by MaxDepth.
+*/
+template<class Key, class Value>
+typename StackAVLTree<Key, Value>::Node* StackAVLTree<Key, Value>::cloneTree(const Node* src)
+{
+    if (src == nullptr)
+    {
+        return nullptr;
+    }
+    Node* copy = new Node(src->getKey(), src->getValue());
+    copy->setBalance(src->getBalance());
+    copy->setLeft(cloneTree(src->getLeft()));
+    copy->setRight(cloneTree(src->getRight()));
+    return copy;
+}
+
+template<class Key, class Value>
+int StackAVLTree<Key, Value>::heightOf(const Node* n, bool& balanced)
+{
+    if (n == nullptr || !balanced)
+    {
+        return 0;
+    }
+    int left = heightOf(n->getLeft(), balanced);
+    int right = heightOf(n->getRight(), balanced);
+    if (left - right > 1 || right - left > 1)
+    {
+        balanced = false;
+    }
+    return 1 + (left > right ? left : right);
+}
+
+#endif
@@ -0,0 +1,647 @@
+#ifndef AVL_WAL_H
+#define AVL_WAL_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "avlbst.h"
+#include "tree-codec.h"
+
+/**
+* Tuning for WalAVLTree.
+*/
+struct WalOptions
+{
+    WalOptions() :
+        groupBytes(1 << 16), sync(true), checkpointBytes(64 << 20)
+    {}
+
+    size_t groupBytes;          // log bytes buffered before commit() runs by itself
+    bool sync;                  // fdatasync the log on every commit
+    uint64_t checkpointBytes;   // log size that triggers a checkpoint, 0 for manual only
+};
+
+/**
+* An AVLTree that can keep its contents in a local file across restarts.
+*
+* Until open() is called it is a plain AVLTree. After open(), every change
+* (insert, remove, erase, clear, apply_batch, build_parallel) is appended to
+* a write-ahead log at <base>.wal. Values can only change through those:
+* iterators and operator[] hand out const items, and load() and swap() are
+* deleted, since none of them could be logged. The same holds for writes
+* made through an AVLTree reference, which this class cannot see. Records are buffered and written together: commit()
+* writes the buffer and fdatasyncs it once for the whole group, and runs by
+* itself whenever groupBytes have piled up. A crash loses at most the
+* changes since the last commit().
+*
+* checkpoint() writes the whole tree to <base>.ckpt with save() (through a
+* temporary file and a rename, so a crash leaves either the old or the new
+* checkpoint) and then empties the log; it also runs by itself once the log
+* reaches checkpointBytes. open() loads the checkpoint and replays the log
+* tail through apply_batch(), so recovery costs one checkpoint load plus
+* the writes since, however long the history. Replaying a log that was
+* already folded into the checkpoint (a crash between the rename and the
+* truncate) gives the same tree, since every record sets a key's final
+* state outright.
+*
+* Log records are a 32-bit payload length, a 32-bit checksum of the
+* payload, then the payload: 'i' key value, 'r' key or 'c' (clear). A torn
+* record at the end of the log is dropped on recovery.
+*/
+template <class Key, class Value, class KeyCodec = BinaryCodec<Key>, class ValueCodec = BinaryCodec<Value> >
+class WalAVLTree : public AVLTree<Key, Value>
+{
+public:
+    WalAVLTree();
+    virtual ~WalAVLTree();
+
+    // The tree owns an open log file.
+    WalAVLTree(const WalAVLTree&) = delete;
+    WalAVLTree& operator=(const WalAVLTree&) = delete;
+
+    bool open(const std::string& basePath, const WalOptions& options = WalOptions());
+    void close();
+    bool commit();
+    bool checkpoint();
+    bool good() const;
+
+    // the tree owns the log, and open() is the way to read a checkpoint
+    void swap(WalAVLTree& other) = delete;
+    template<class KeyCodec2 = KeyCodec, class ValueCodec2 = ValueCodec>
+    bool load(std::istream& in) = delete;
+
+    /**
+    * AVLTree's iterator with a const item, since a write through it would
+    * not reach the log.
+    */
+    class iterator : public AVLTree<Key, Value>::iterator
+    {
+    public:
+        iterator();
+        iterator(const typename AVLTree<Key, Value>::iterator& it);
+
+        const std::pair<const Key, Value>& operator*() const;
+        const std::pair<const Key, Value>* operator->() const;
+
+        iterator& operator++();
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    iterator erase(iterator pos);
+    iterator erase(iterator first, iterator last);
+    Value const & operator[](const Key& key) const;
+
+    virtual void insert (const std::pair<const Key, Value> &new_item) override;
+    virtual void clear() override;
+    virtual void apply_batch(const std::vector<BatchOp<Key, Value> >& sorted_ops) override;
+
+protected:
+    virtual void buildSorted(const std::vector<std::pair<Key, Value> >& items, unsigned threads) override;
+    virtual void removeNode(Node<Key, Value>* node) override;
+    virtual void swapTree(BinarySearchTree<Key, Value>& other) noexcept override;
+    void logOp(char op, const Key* key, const Value* value);
+    void maybeCommit();
+    bool writeLog();
+    bool recover(const std::string& logPath, uint64_t& validBytes);
+    static uint32_t checksum(const char* bytes, size_t count);
+    static bool syncPath(const std::string& path);
+
+    std::string base_;
+    WalOptions options_;
+    int fd_;                // -1 while no log is open
+    std::string pending_;   // records not yet written
+    uint64_t logBytes_;     // bytes in the log file
+    bool failed_;           // a log or checkpoint write failed
+};
+
+/*
+---------------------------------------------------------
+Begin implementations for the WalAVLTree::iterator class.
+---------------------------------------------------------
+*/
+
+template<class Key, class Value, class KeyCodec, class ValueCodec>
+WalAVLTree<Key, Value, KeyCodec, ValueCodec>::iterator::iterator() :
+    AVLTree<Key, Value>::iterator()
+{
+
+}
+
+template<class Key, class Value, class KeyCodec, class ValueCodec>
+WalAVLTree<Key, Value, KeyCodec, ValueCodec>::iterator::iterator(const typename AVLTree<Key, Value>::iterator& it) :
+    AVLTree<Key, Value>::iterator(it)
+{
+
+}
+
+template<class Key, class Value, class KeyCodec, class ValueCodec>
+const std::pair<const Key, Value>&
+WalAVLTree<Key, Value, KeyCodec, ValueCodec>::iterator::operator*() const
+{
+    return AVLTree<Key, Value>::iterator::operator*();
+}
+
+template<class Key, class Value, class KeyCodec, class ValueCodec>
+const std::pair<const Key, Value>*
+WalAVLTree<Key, Value, KeyCodec, ValueCodec>::iterator::operator->() const
+{
+    return AVLTree<Key, Value>::iterator::operator->();
+}
+
+template<class Key, class Value, class KeyCodec, class ValueCodec>
+typename WalAVLTree<Key, Value, KeyCodec, ValueCodec>::iterator&
+WalAVLTree<Key, Value, KeyCodec, ValueCodec>::iterator::operator++()
+{
+    AVLTree<Key, Value>::iterator::operator++();
+    return *this;
+}
+
+/*
+-------------------------------------------------------
+End implementations for the WalAVLTree::iterator class.
+-------------------------------------------------------
+*/
+
+template<class Key, class Value, class KeyCodec, class ValueCodec>
+WalAVLTree<Key, Value, KeyCodec, ValueCodec>::WalAVLTree() :
+    AVLTree<Key, Value>(), fd_(-1), logBytes_(0), failed_(false)
+{
+
+}
+
+/**
+* Commits what is buffered; the base destructor frees the nodes without
+* logging anything.
+*/
+template<class Key, class Value, class KeyCodec, class ValueCodec>
+WalAVLTree<Key, Value, KeyCodec, ValueCodec>::~WalAVLTree()
+{
+    close();
+}
+
+/**
+* Replaces the contents of the tree with what was saved under basePath
+* (nothing, the first time) and starts logging there. Returns false if the
+* checkpoint is unreadable or the log cannot be opened.
+*/
+template<class Key, class Value, class KeyCodec, class ValueCodec>
+bool WalAVLTree<Key, Value, KeyCodec, ValueCodec>::open(const std::string& basePath, const WalOptions& options)
+{
+    close();
+    base_ = basePath;
+    options_ = options;
+    failed_ = false;
+
+    std::ifstream saved((base_ + ".ckpt").c_str(), std::ios::binary);
+    if (saved)
+    {
+        if (!AVLTree<Key, Value>::template load<KeyCodec, ValueCodec>(saved))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        AVLTree<Key, Value>::clear();
+    }
+
+    std::string logPath = base_ + ".wal";
+    uint64_t validBytes = 0;
+    if (!recover(logPath, validBytes))
+    {
+        return false;
+    }
+
+    fd_ = ::open(logPath.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd_ < 0)
+    {
+        return false;
+    }
+    //cut off a torn tail so new records follow the last good one
+    if (ftruncate(fd_, (off_t)validBytes) != 0 || fdatasync(fd_) != 0)
+    {
+        close();
+        return false;
+    }
+    logBytes_ = validBytes;
+    return true;
+}
+
+/**
+* Commits and closes the log. The tree keeps its contents and goes back to
+* being a plain AVLTree.
+*/
+template<class Key, class Value, class KeyCodec, class ValueCodec>
+void WalAVLTree<Key, Value, KeyCodec, ValueCodec>::close()
+{
+    if (fd_ < 0)
+    {
+        return;
+    }
+    writeLog();
+    ::close(fd_);
+    fd_ = -1;
+}
+
+/**
+* Makes every change so far durable: one write and one fdatasync for all
+* buffered records. May also start a checkpoint if the log got big.
+*/
+template<class Key, class Value, class KeyCodec, class ValueCodec>
+bool WalAVLTree<Key, Value, KeyCodec, ValueCodec>::commit()
+{
+    if (!writeLog())
+    {
+        return false;
+    }
+    if (fd_ >= 0 && options_.checkpointBytes != 0 && logBytes_ >= options_.checkpointBytes)
+    {
+        return checkpoint();
+    }
+    return true;
+}
+
+/**
+* Saves the whole tree as the new checkpoint and empties the log.
+*/
+template<class Key, class Value, class KeyCodec, class ValueCodec>
+bool WalAVLTree<Key, Value, KeyCodec, ValueCodec>::checkpoint()
+{
+    if (fd_ < 0 || !writeLog())
+    {
+        return false;
+    }
+
+    std::string finalPath = base_ + ".ckpt";
+    std::string tempPath = finalPath + ".tmp";
+    {
+        std::ofstream out(tempPath.c_str(), std::ios::binary | std::ios::trunc);
+        this->template save<KeyCodec, ValueCodec>(out);
+        out.close();
+        if (!out)
+        {
+            failed_ = true;
+            return false;
+        }
+    }
+
+    size_t slash = base_.rfind('/');
+    std::string dir = (slash == std::string::npos) ? "." : (slash == 0) ? "/" : base_.substr(0, slash);
+    if (!syncPath(tempPath) || rename(tempPath.c_str(), finalPath.c_str()) != 0 || !syncPath(dir))
+    {
+        failed_ = true;
+        return false;
+    }
+
+    if (ftruncate(fd_, 0) != 0 || fdatasync(fd_) != 0)
+    {
+        failed_ = true;
+        return false;
+    }
+    logBytes_ = 0;
+    return true;
+}
+
+/**
+* False once a log or checkpoint write has failed; changes made since may
+* not survive a restart.
+*/
+template<class Key, class Value, class KeyCodec, class ValueCodec>
+bool WalAVLTree<Key, Value, KeyCodec, ValueCodec>::good() const
+{
+    return !failed_;
+}
+
+template<class Key, class Value, class KeyCodec, class ValueCodec>
+typename WalAVLTree<Key, Value, KeyCodec, ValueCodec>::iterator
+WalAVLTree<Key, Value, KeyCodec, ValueCodec>::begin() const
+{
+    return AVLTree<Key, Value>::begin();
+}
+
+template<class Key, class Value, class KeyCodec, class ValueCodec>
+typename WalAVLTree<Key, Value, KeyCodec, ValueCodec>::iterator
+WalAVLTree<Key, Value, KeyCodec, ValueCodec>::end() const
+{
+    return AVLTree<Key, Value>::end();
+}
+
+template<class Key, class Value, class KeyCodec, class ValueCodec>
+typename WalAVLTree<Key, Value, KeyCodec, ValueCodec>::iterator
+WalAVLTree<Key, Value, KeyCodec, ValueCodec>::find(const Key& key) const
+{
+    return AVLTree<Key, Value>::find(key);
+}
+
+template<class Key, class Value, class KeyCodec, class ValueCodec>
+typename WalAVLTree<Key, Value, KeyCodec, ValueCodec>::iterator
+WalAVLTree<Key, Value, KeyCodec, ValueCodec>::lower_bound(const Key& key) const
+{
+    return AVLTree<Key, Value>::lower_bound(key);
+}
+
+/**
+* Both erase()s remove through removeNode(), which logs each key.
+*/
+template<class Key, class Value, class KeyCodec, class ValueCodec>
+typename WalAVLTree<Key, Value, KeyCodec, ValueCodec>::iterator
+WalAVLTree<Key, Value, KeyCodec, ValueCodec>::erase(iterator pos)
+{
+    return AVLTree<Key, Value>::erase(pos);
+}
+
+template<class Key, class Value, class KeyCodec, class ValueCodec>
+typename WalAVLTree<Key, Value, KeyCodec, ValueCodec>::iterator
+WalAVLTree<Key, Value, KeyCodec, ValueCodec>::erase(iterator first, iterator last)
+{
+    return AVLTree<Key, Value>::erase(first, last);
+}
+
+/**
+* Only the const lookup: it throws std::out_of_range for a missing key, and
+* a writable reference could change a value behind the log's back.
+*/
+template<class Key, class Value, class KeyCodec, class ValueCodec>
+Value const & WalAVLTree<Key, Value, KeyCodec, ValueCodec>::operator[](const Key& key) const
+{
+    return AVLTree<Key, Value>::operator[](key);
+}
+
+template<class Key, class Value, class KeyCodec, class ValueCodec>
+void WalAVLTree<Key, Value, KeyCodec, ValueCodec>::insert (const std::pair<const Key, Value> &new_item)
+{
+    logOp('i', &new_item.first, &new_item.second);
+    AVLTree<Key, Value>::insert(new_item);
+    maybeCommit();
+}
+
+template<class Key, class Value, class KeyCodec, class ValueCodec>
+void WalAVLTree<Key, Value, KeyCodec, ValueCodec>::clear()
+{
+    logOp('c', nullptr, nullptr);
+    AVLTree<Key, Value>::clear();
+    maybeCommit();
+}
+
+/**
+* Logs every op, then applies the batch. The base version only calls
+* AVLTree's own insert/removeNode, so nothing is logged twice.
+*/
+template<class Key, class Value, class KeyCodec, class ValueCodec>
+void WalAVLTree<Key, Value, KeyCodec, ValueCodec>::apply_batch(const std::vector<BatchOp<Key, Value> >& sorted_ops)
+{
+    for (size_t i = 0; i < sorted_ops.size(); ++i)
+    {
+        if (sorted_ops[i].kind == BatchOp<Key, Value>::UPSERT)
+        {
+            logOp('i', &sorted_ops[i].key, &sorted_ops[i].value);
+        }
+        else
+        {
+            logOp('r', &sorted_ops[i].key, nullptr);
+        }
+    }
+    AVLTree<Key, Value>::apply_batch(sorted_ops);
+    maybeCommit();
+}
+
+/**
+* build_parallel() lands here. The base rebuild starts with clear(), which
+* logs the 'c', so the surviving pairs are logged after the build, in key
+* order.
+*/
+template<class Key, class Value, class KeyCodec, class ValueCodec>
+void WalAVLTree<Key, Value, KeyCodec, ValueCodec>::buildSorted(const std::vector<std::pair<Key, Value> >& items, unsigned threads)
+{
+    AVLTree<Key, Value>::buildSorted(items, threads);
+    for (iterator it = begin(); it != end(); ++it)
+    {
+        logOp('i', &it->first, &it->second);
+    }
+    maybeCommit();
+}
+
+/**
+* remove() and erase() both end up here, so this is where removals are
+* logged.
+*/
+template<class Key, class Value, class KeyCodec, class ValueCodec>
+void WalAVLTree<Key, Value, KeyCodec, ValueCodec>::removeNode(Node<Key, Value>* node)
+{
+    if (node != nullptr)
+    {
+        logOp('r', &node->getKey(), nullptr);
+    }
+    AVLTree<Key, Value>::removeNode(node);
+    maybeCommit();
+}
+
+/**
+* Only reachable through a base reference, since swap() is deleted. Each
+* log goes with the contents it describes.
+*/
+template<class Key, class Value, class KeyCodec, class ValueCodec>
+void WalAVLTree<Key, Value, KeyCodec, ValueCodec>::swapTree(BinarySearchTree<Key, Value>& other) noexcept
+{
+    WalAVLTree& that = static_cast<WalAVLTree&>(other);
+    AVLTree<Key, Value>::swapTree(that);
+    base_.swap(that.base_);
+    std::swap(options_, that.options_);
+    std::swap(fd_, that.fd_);
+    pending_.swap(that.pending_);
+    std::swap(logBytes_, that.logBytes_);
+    std::swap(failed_, that.failed_);
+}
+
+/**
+* Appends one record to the group buffer (nothing while no log is open).
+* The caller makes the change, then calls maybeCommit().
+*/
+template<class Key, class Value, class KeyCodec, class ValueCodec>
+void WalAVLTree<Key, Value, KeyCodec, ValueCodec>::logOp(char op, const Key* key, const Value* value)
+{
+    if (fd_ < 0)
+    {
+        return;
+    }
+
+    //reserve the header, encode the payload after it, then fill the header in
+    size_t start = pending_.size();
+    pending_.append(2 * sizeof(uint32_t), '\0');
+    {
+        CodecWriter writer(pending_);
+        writer.append(&op, 1);
+        if (key != nullptr)
+        {
+            KeyCodec::write(writer, *key);
+        }
+        if (value != nullptr)
+        {
+            ValueCodec::write(writer, *value);
+        }
+    }
+    size_t payload = start + 2 * sizeof(uint32_t);
+    uint32_t header[2] = { (uint32_t)(pending_.size() - payload), checksum(&pending_[payload], pending_.size() - payload) };
+    memcpy(&pending_[start], header, sizeof(header));
+}
+
+/**
+* Commits once a group's worth of records is buffered. Called only after
+* the logged change is in the tree, since the commit may checkpoint.
+*/
+template<class Key, class Value, class KeyCodec, class ValueCodec>
+void WalAVLTree<Key, Value, KeyCodec, ValueCodec>::maybeCommit()
+{
+    if (fd_ >= 0 && pending_.size() >= options_.groupBytes)
+    {
+        commit();
+    }
+}
+
+/**
+* Writes the buffered records and syncs them, if asked to.
+*/
+template<class Key, class Value, class KeyCodec, class ValueCodec>
+bool WalAVLTree<Key, Value, KeyCodec, ValueCodec>::writeLog()
+{
+    if (fd_ < 0 || pending_.empty())
+    {
+        return !failed_;
+    }
+
+    size_t done = 0;
+    while (done < pending_.size())
+    {
+        ssize_t n = write(fd_, pending_.data() + done, pending_.size() - done);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            failed_ = true;
+            return false;
+        }
+        done += (size_t)n;
+    }
+    if (options_.sync && fdatasync(fd_) != 0)
+    {
+        failed_ = true;
+        return false;
+    }
+    logBytes_ += pending_.size();
+    pending_.clear();
+    return true;
+}
+
+/**
+* Replays the log at logPath onto the tree: the records after the last
+* clear are stable sorted by key, so the last write to a key still wins,
+* and applied in one apply_batch(). Sets validBytes to the length of the
+* log up to the last intact record.
+*/
+template<class Key, class Value, class KeyCodec, class ValueCodec>
+bool WalAVLTree<Key, Value, KeyCodec, ValueCodec>::recover(const std::string& logPath, uint64_t& validBytes)
+{
+    validBytes = 0;
+    std::ifstream in(logPath.c_str(), std::ios::binary);
+    if (!in)
+    {
+        return true;
+    }
+    std::string log((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    std::vector<BatchOp<Key, Value> > ops;
+    size_t pos = 0;
+    while (log.size() - pos >= 2 * sizeof(uint32_t))
+    {
+        uint32_t header[2];
+        memcpy(header, log.data() + pos, sizeof(header));
+        size_t payload = pos + sizeof(header);
+        if (header[0] == 0 || log.size() - payload < header[0] || checksum(log.data() + payload, header[0]) != header[1])
+        {
+            break;
+        }
+
+        CodecReader reader(log.data() + payload, header[0]);
+        char op = 0;
+        Key key = Key();
+        Value value = Value();
+        reader.read(&op, 1);
+        bool ok = true;
+        if (op == 'i')
+        {
+            ok = KeyCodec::read(reader, key) && ValueCodec::read(reader, value);
+            ops.push_back(BatchOp<Key, Value>::upsert(key, value));
+        }
+        else if (op == 'r')
+        {
+            ok = KeyCodec::read(reader, key);
+            ops.push_back(BatchOp<Key, Value>::erase(key));
+        }
+        else if (op == 'c')
+        {
+            ops.clear();
+            AVLTree<Key, Value>::clear();
+        }
+        else
+        {
+            ok = false;
+        }
+        //an intact checksum over a record that does not decode means the codecs do not match the log
+        if (!ok || !reader.atEnd())
+        {
+            return false;
+        }
+        pos = payload + header[0];
+    }
+    validBytes = pos;
+
+    std::stable_sort(ops.begin(), ops.end(),
+        [](const BatchOp<Key, Value>& a, const BatchOp<Key, Value>& b) { return a.key < b.key; });
+    AVLTree<Key, Value>::apply_batch(ops);
+    return true;
+}
+
+/**
+* FNV-1a, enough to tell a torn or half-written record from a whole one.
+*/
+template<class Key, class Value, class KeyCodec, class ValueCodec>
+uint32_t WalAVLTree<Key, Value, KeyCodec, ValueCodec>::checksum(const char* bytes, size_t count)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < count; ++i)
+    {
+        hash = (hash ^ (uint8_t)bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+* fsyncs a file or directory by name.
+*/
+template<class Key, class Value, class KeyCodec, class ValueCodec>
+bool WalAVLTree<Key, Value, KeyCodec, ValueCodec>::syncPath(const std::string& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    bool ok = (fsync(fd) == 0);
+    ::close(fd);
+    return ok;
+}
+
+#endif
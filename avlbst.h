@@ -6,6 +6,8 @@
 #include <cstdlib>
 #include <cstdint>
 #include <algorithm>
+#include <vector>
+#include <thread>
 #include "bst.h"
 
 struct KeyError { };
@@ -128,112 +130,171 @@ AVLNode<Key, Value> *AVLNode<Key, Value>::getRight() const
 */
 
 
+/**
+* One mutation for AVLTree::apply_batch(): either an upsert of key/value or
+* an erase of key.
+*/
 template <class Key, class Value>
-class AVLTree : public BinarySearchTree<Key, Value>
+struct BatchOp
 {
-public:
-    virtual void insert (const std::pair<const Key, Value> &new_item); // TODO
-    virtual void remove(const Key& key);  // TODO
-protected:
-    virtual void nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2);
+    enum Kind { UPSERT, ERASE };
 
-    // Add helper functions here
-    void insertFix(AVLNode<Key,Value>* p, AVLNode<Key,Value>* n);
-    void removeFix(AVLNode<Key,Value>* n, int8_t diff);
-    void rotateRight(AVLNode<Key,Value>* n);
-    void rotateLeft(AVLNode<Key, Value>* n);
+    BatchOp(Kind kind, const Key& key, const Value& value) :
+        kind(kind), key(key), value(value)
+    {}
+
+    static BatchOp upsert(const Key& key, const Value& value)
+    {
+        return BatchOp(UPSERT, key, value);
+    }
+
+    static BatchOp erase(const Key& key)
+    {
+        return BatchOp(ERASE, key, Value());
+    }
+
+    Kind kind;
+    Key key;
+    Value value;
+};
+
+/**
+* The AVL rebalancing steps, written once over any node type that has
+* get/setParent, get/setLeft, get/setRight and get/set/updateBalance, so
+* trees with other node layouts (see intrusive-avl.h) share them with
+* AVLTree.
+*
+* Tree is whatever owns the root. The fix-ups rotate and swap through
+* t.rotateLeft(n), t.rotateRight(n) and t.nodeSwap(a, b), which lets a tree
+* wrap the plain operations below; AVLTree's versions just forward here
+* with its root_.
+*/
+struct AVLAlgo
+{
+    template<class Tree, class N>
+    static void linkLeaf(Tree& t, N* parent, N* n, bool left);
+
+    template<class Tree, class N, class R>
+    static N* unlink(Tree& t, N* curr, R*& root, int8_t& diff);
+
+    template<class Tree, class N>
+    static void insertFix(Tree& t, N* p, N* n);
+
+    template<class Tree, class N>
+    static void removeFix(Tree& t, N* n, int8_t diff);
+
+    template<class N, class R>
+    static void rotateRight(N* n, R*& root);
+
+    template<class N, class R>
+    static void rotateLeft(N* n, R*& root);
+
+    template<class N, class R>
+    static void swapNodes(N* n1, N* n2, R*& root);
 };
 
 /*
- * Recall: If key is already in the tree, you should 
- * overwrite the current value with the updated value.
- */
-template<class Key, class Value>
-void AVLTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
+  -------------------------------------------------
+  Begin implementations for the AVLAlgo struct.
+  -------------------------------------------------
+*/
+
+/**
+* Hangs the unlinked node n (balance 0, no children) off parent's empty
+* left or right slot and rebalances.
+*/
+template<class Tree, class N>
+void AVLAlgo::linkLeaf(Tree& t, N* parent, N* n, bool left)
 {
-    // TODO
-    //if root is null, need to add one to start because there is nothing in this tree
-    if (this->root_ == nullptr)
+    n->setParent(parent);
+    if (left)
     {
-        //make new avl node (by default sets balance_ to 0)
-       this->root_ = new AVLNode<Key, Value>(new_item.first, new_item.second, nullptr);
-
+        parent->setLeft(n);
     }
-
     else
     {
-        //make a temp node set to root
-        AVLNode<Key, Value>* temp = static_cast<AVLNode<Key, Value>*>(this->root_);
+        parent->setRight(n);
+    }
+
+    //parent was leaning the other way, so now it's even and no height changed
+    if (parent->getBalance() == 1 || parent->getBalance() == -1)
+    {
+        parent->setBalance(0);
+    }
+    else if (parent->getBalance() == 0)
+    {
+        parent->setBalance(left ? -1 : 1);
+        insertFix(t, parent, n);
+    }
+}
 
-        //flag for if insertion  done
-        bool inserted = false;
-        while (!inserted)
+/**
+* Takes curr out of the tree without freeing it, swapping it with its
+* predecessor first if it has two children. Returns the node removeFix()
+* should start from (nullptr if curr was the last node) and sets diff to
+* the balance change that node saw.
+*/
+template<class Tree, class N, class R>
+N* AVLAlgo::unlink(Tree& t, N* curr, R*& root, int8_t& diff)
+{
+    //if has both children
+    if (curr->getLeft() != nullptr && curr->getRight() != nullptr)
+    {
+        //swap the predecessor and curr, because this will conver to 0 or 1 child case which below will handle
+        N* pred = curr->getLeft();
+        while (pred->getRight() != nullptr)
         {
-            //if the inserting one is less than temp, we go left of temp
-            if (new_item.first < temp->getKey())
-            {
-                //check if the left of my temp is null, bc then we'll put into my temp's left
-                if (temp->getLeft() == nullptr)
-                {
-                    AVLNode<Key, Value>* baby = new AVLNode<Key, Value>(new_item.first, new_item.second, temp);
-                    temp->setLeft(baby);
-                    if (temp->getBalance() == 1 || temp->getBalance() == -1)
-                    {
-                        temp->setBalance(0);
-                    }
-                    else if (temp->getBalance() == 0)
-                    {
-                        temp->setBalance(-1);
-                        insertFix(temp, baby);
-                    }
-                    inserted = true;
-                }
+            pred = pred->getRight();
+        }
+        t.nodeSwap(pred, curr);
+    }
 
-                //otherwise move downwards again to check next one
-                else
-                {
-                    temp = temp->getLeft();
-                }
-            }
-            else if (new_item.first > temp->getKey())
-            {
-                //check if the Right of my temp is null/empty, bc then we'll put into my temp's Right
-                if (temp->getRight() == nullptr)
-                {
-                    AVLNode<Key, Value>* baby = new AVLNode<Key, Value>(new_item.first, new_item.second, temp);
-                    temp->setRight(baby);
-                    if (temp->getBalance() == 1 || temp->getBalance() == -1)
-                    {
-                        temp->setBalance(0);
-                    }
-                    else if (temp->getBalance() == 0)
-                    {
-                        temp->setBalance(1);
-                        insertFix(temp, baby);
-                    }
-                    inserted = true;
-                }
+    N* parent = curr->getParent();
 
-                //othewise, move down to the right to check again
-                else
-                {
-                    temp = temp->getRight();
-                }
-            }
-            
-            //otherwise they are equal so overwrite
-            else
-            {
-                temp->setValue(new_item.second);
-                inserted = true;
-            }
+    //setup different thing
+    diff = 0;
+    if (parent != nullptr)
+    {
+        if (parent->getLeft() == curr)
+        {
+            diff = 1;
+        }
+        else
+        {
+            diff = -1;
         }
     }
+
+    //now that know are not 2 children, the child (if any) takes curr's place
+    N* child = (curr->getLeft() != nullptr) ? curr->getLeft() : curr->getRight();
+    if (parent == nullptr)
+    {
+        root = child;
+    }
+    else if (parent->getLeft() == curr)
+    {
+        parent->setLeft(child);
+    }
+    //otherwise it's the parent's right that is curr
+    else
+    {
+        parent->setRight(child);
+    }
+
+    if (child != nullptr)
+    {
+        child->setParent(parent);
+    }
+
+    curr->setParent(nullptr);
+    curr->setLeft(nullptr);
+    curr->setRight(nullptr);
+    return parent;
 }
 
 //make insertFix function, passed parent node and also the node that was just inserted
-template<class Key, class Value>
-void AVLTree<Key, Value>::insertFix(AVLNode<Key,Value>* p, AVLNode<Key,Value>* n)
+template<class Tree, class N>
+void AVLAlgo::insertFix(Tree& t, N* p, N* n)
 {
     if (p == nullptr || p->getParent() == nullptr)
     {
@@ -241,7 +302,7 @@ void AVLTree<Key, Value>::insertFix(AVLNode<Key,Value>* p, AVLNode<Key,Value>* n
     }
 
     //make g the parent of p
-    AVLNode<Key, Value>* g = p->getParent();
+    N* g = p->getParent();
 
     //handle case where p is the left child of p
     if (g->getLeft() == p)
@@ -256,7 +317,7 @@ void AVLTree<Key, Value>::insertFix(AVLNode<Key,Value>* p, AVLNode<Key,Value>* n
         //case where g's balance is -1, so recurse up
         else if (g->getBalance() == -1)
         {
-            insertFix(g, p);
+            insertFix(t, g, p);
         }
         //case where g's balance is -2
         else if (g->getBalance() == -2)
@@ -264,7 +325,7 @@ void AVLTree<Key, Value>::insertFix(AVLNode<Key,Value>* p, AVLNode<Key,Value>* n
             //means zig-zig case so handle as such
             if (n == p->getLeft())
             {
-                rotateRight(g);
+                t.rotateRight(g);
                 p->setBalance(0);
                 g->setBalance(0);
             }
@@ -273,8 +334,8 @@ void AVLTree<Key, Value>::insertFix(AVLNode<Key,Value>* p, AVLNode<Key,Value>* n
             else if (n == p->getRight())
             {
                 //do the rotations
-                rotateLeft(p);
-                rotateRight(g);
+                t.rotateLeft(p);
+                t.rotateRight(g);
                 //case where balance is -1
                 if (n->getBalance() == -1)
                 {
@@ -313,7 +374,7 @@ void AVLTree<Key, Value>::insertFix(AVLNode<Key,Value>* p, AVLNode<Key,Value>* n
         //handle case where balance is 1, so recurse up
         else if (g->getBalance() == 1)
         {
-            insertFix(g, p);
+            insertFix(t, g, p);
         }
         //handle case where balance is off
         else if (g->getBalance() == 2)
@@ -321,7 +382,7 @@ void AVLTree<Key, Value>::insertFix(AVLNode<Key,Value>* p, AVLNode<Key,Value>* n
             //zig-zig case
             if (n == p->getRight())
             {
-                rotateLeft(g);
+                t.rotateLeft(g);
                 p->setBalance(0);
                 g->setBalance(0);
             }
@@ -329,8 +390,8 @@ void AVLTree<Key, Value>::insertFix(AVLNode<Key,Value>* p, AVLNode<Key,Value>* n
             else if (n == p->getLeft())
             {
                 //do the rotations
-                rotateRight(p);
-                rotateLeft(g);
+                t.rotateRight(p);
+                t.rotateLeft(g);
                 //case where balance is 1
                 if (n->getBalance() == 1)
                 {
@@ -360,142 +421,8 @@ void AVLTree<Key, Value>::insertFix(AVLNode<Key,Value>* p, AVLNode<Key,Value>* n
 
 }
 
-/*
- * Recall: The writeup specifies that if a node has 2 children you
- * should swap with the predecessor and then remove.
- */
-template<class Key, class Value>
-void AVLTree<Key, Value>:: remove(const Key& key)
-{
-    // TODO
-
-    //if root is null, cannot remove anything so just return out
-    if (this->root_ == nullptr)
-    {
-        return;
-    }
-
-    //attempt to find the key in the tree
-    AVLNode<Key, Value>* curr = static_cast<AVLNode<Key, Value>*>(this->internalFind(key));
-
-    //check to see if key not found in tree, so then can just return
-    if (curr == nullptr)
-    {
-        return;
-    }
-
-    //if has both children
-    if (curr->getLeft() != nullptr && curr->getRight() != nullptr)
-    {
-        //swap the predecessor and curr, because this will  conver to 0 or 1 child case which below will handle
-        nodeSwap(static_cast<AVLNode<Key, Value>*>(this->predecessor(curr)), curr);
-    }
-
-    AVLNode<Key, Value>* parent = curr->getParent();
-
-    //setup different thing
-    int8_t diff = 0;
-    if (parent != nullptr)
-    {
-        if (parent->getLeft() == curr)
-        {
-            diff = 1;            
-        }
-        else
-        {
-            diff = -1;
-        }
-    }
-
-    //now that know are not 2 children, check if left child exists and then work with that
-    if (curr->getLeft() != nullptr)
-    {
-        AVLNode<Key, Value>* child = curr->getLeft();
-        //if curr is the parent's left child, we know to change the parent's left child to curr's left child we are looking at
-        if (parent != nullptr)
-        {
-            if (parent->getLeft() == curr)
-            {
-                parent->setLeft(child);
-            }
-
-            //otherwise it's the parent's right that is curr, so parent's right needs to be child
-            else
-            {
-                parent->setRight(child);
-            } 
-        }
-        else
-        {
-         this->root_ = child;
-        }
-
-        child->setParent(parent);
-        
-    }
-
-    //if there is a right  child but not left child
-    else if (curr->getRight() != nullptr)
-    {
-        AVLNode<Key, Value>* child = curr->getRight();
-        if (parent != nullptr)
-        {
-            //if curr is the parent's left child, we know to change the parent's left child to curr's left child we are looking at
-            if (parent->getLeft() == curr)
-            {
-                parent->setLeft(child);
-            }
-
-            //otherwise it's the parent's right that is curr, so parent's right needs to be child
-            else
-            {
-                parent->setRight(child);
-            }
-        }
-        else
-        {
-           this->root_ = child;
-        }
-        
-        child->setParent(parent);
-        
-    }
-
-    else //is the case where has no children, but still could have parent as has been swapped so need to clear out parent's left or right
-    {
-        AVLNode<Key, Value>* parent = curr->getParent();
-        if (parent != nullptr)
-        {
-            if (parent->getLeft() == curr)
-        {
-            parent->setLeft(nullptr);
-        }
-
-        //otherwise it's the parent's right that is curr, so parent's right needs to be null since deleting
-        else
-        {
-            parent->setRight(nullptr);
-        }
-        }
-    }
-
-    //now can null out the curr node that removed
-    if (curr != this->root_)
-    {
-        delete curr;
-    }
-    else //is root, so need to null root so doesn't point to deleted dead pointer
-    {
-        delete curr;
-        this->root_ = nullptr;
-    }
-
-    //patch tree
-    removeFix(parent, diff);
-}
-
-template<class Key, class Value>
-void AVLTree<Key, Value>::removeFix(AVLNode<Key,Value>* n, int8_t diff)
+template<class Tree, class N>
+void AVLAlgo::removeFix(Tree& t, N* n, int8_t diff)
 {
     //null check
     if (n == nullptr)
@@ -504,7 +431,7 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key,Value>* n, int8_t diff)
     }
 
     //compute next recursive call's arguments
-    AVLNode<Key, Value>* p = n->getParent(); 
+    N* p = n->getParent(); 
     int8_t ndiff = 0;
     if (p != nullptr)
     {
@@ -525,21 +452,21 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key,Value>* n, int8_t diff)
         if (n->getBalance() + diff == -2)
         {
             //c is taller child (left since is negative and so left child is taller child)
-            AVLNode<Key, Value>* c = n->getLeft();
+            N* c = n->getLeft();
             
             //if c is also -1 then is zig zig as means c has a left child thta's taller, case so rotate
             if (c->getBalance() == -1)
             {
-                rotateRight(n);
+                t.rotateRight(n);
                 n->setBalance(0);
                 c->setBalance(0);
                 //recurse up
-                removeFix(p, ndiff);
+                removeFix(t, p, ndiff);
             }
             //handle case where is 0, also a zig zig as means has left child and is easier to do zig zig
             else if (c->getBalance() == 0)
             {
-                rotateRight(n);
+                t.rotateRight(n);
                 n->setBalance(-1);
                 c->setBalance(1);
                 //no recusing as got to something that is perfectly balanced above so are chilling and done bc cannot be unbalanced tree
@@ -548,9 +475,9 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key,Value>* n, int8_t diff)
             //handle case where is +1, which means a right child of a left child, and therefore zig-zag case
             else if (c->getBalance() == 1)
             {
-                AVLNode<Key, Value>* g = c->getRight();
-                rotateLeft(c);
-                rotateRight(n);
+                N* g = c->getRight();
+                t.rotateLeft(c);
+                t.rotateRight(n);
                 //handle case where g had balance of 1 before
                 if (g->getBalance() == 1)
                 {
@@ -573,7 +500,7 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key,Value>* n, int8_t diff)
                     g->setBalance(0);
                 }
                 //recurse back up
-                removeFix(p,ndiff);
+                removeFix(t, p,ndiff);
             }
         }
         //handle case where balance now is -1, just update and done as not unbalanced
@@ -585,7 +512,7 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key,Value>* n, int8_t diff)
         else if (n->getBalance() + diff == 0)
         {
             n->setBalance(0);
-            removeFix(p, ndiff);
+            removeFix(t, p, ndiff);
         }
     }
     //handle -1 case for diff
@@ -595,21 +522,21 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key,Value>* n, int8_t diff)
         if (n->getBalance() + diff == 2)
         {
             //c is taller child (right since is negative and so left child is taller child)
-            AVLNode<Key, Value>* c = n->getRight();
+            N* c = n->getRight();
             
             //if c is also -1 then is zig zig as means c has a left child thta's taller, case so rotate
             if (c->getBalance() == 1)
             {
-                rotateLeft(n);
+                t.rotateLeft(n);
                 n->setBalance(0);
                 c->setBalance(0);
                 //recurse up
-                removeFix(p, ndiff);
+                removeFix(t, p, ndiff);
             }
             //handle case where is 0, also a zig zig as means has left child and is easier to do zig zig
             else if (c->getBalance() == 0)
             {
-                rotateLeft(n);
+                t.rotateLeft(n);
                 n->setBalance(1);
                 c->setBalance(-1);
                 //no recursing as got to something that is perfectly balanced above so are chilling and done bc cannot be unbalanced tree
@@ -618,9 +545,9 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key,Value>* n, int8_t diff)
             //handle case where is +1, which means a right child of a left child, and therefore zig-zag case
             else if (c->getBalance() == -1)
             {
-                AVLNode<Key, Value>* g = c->getLeft();
-                rotateRight(c);
-                rotateLeft(n);
+                N* g = c->getLeft();
+                t.rotateRight(c);
+                t.rotateLeft(n);
                 //handle case where g had balance of 1 before
                 if (g->getBalance() == -1)
                 {
@@ -643,7 +570,7 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key,Value>* n, int8_t diff)
                     g->setBalance(0);
                 }
                 //recurse back up
-                removeFix(p,ndiff);
+                removeFix(t, p,ndiff);
             }
         }
         //handle case where balance now is -1, just update and done as not unbalanced
@@ -655,33 +582,33 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key,Value>* n, int8_t diff)
         else if (n->getBalance() + diff == 0)
         {
             n->setBalance(0);
-            removeFix(p, ndiff);
+            removeFix(t, p, ndiff);
         }        
     }
     
 }
 
-template<class Key, class Value>
+template<class N, class R>
 /**cases to handle for rotate:
  * when n->getLeft() has left and right node, need to move it's right to become y's top's left
  * update root if rotating one that is root and/or parent is nullptr
  * 
 */
-void AVLTree<Key, Value>::rotateRight(AVLNode<Key,Value>* n)
+void AVLAlgo::rotateRight(N* n, R*& root)
 {
     if (n == nullptr)
     {
         return;
     }
 
-    AVLNode<Key,Value>* nChild = n->getLeft();//if is nullptr, means n has no children to rotate up
+    N* nChild = n->getLeft();//if is nullptr, means n has no children to rotate up
     if (nChild == nullptr) //means nothing to move up
     {
         return;
     }
 
-    AVLNode<Key,Value>* nChildRight = nChild->getRight(); //will be nullptr if no right child of left child, just means will assign nullptr as left child later
-    AVLNode<Key,Value>* nParent = n->getParent();//if is nullptr, n is root and so child will end up being root anad need to switch
+    N* nChildRight = nChild->getRight(); //will be nullptr if no right child of left child, just means will assign nullptr as left child later
+    N* nParent = n->getParent();//if is nullptr, n is root and so child will end up being root anad need to switch
 
     //moves over below node's right child to be n's left child, will be nullptr if nChildRight does not exist
     //also make it's parent it's former child
@@ -703,7 +630,7 @@ void AVLTree<Key, Value>::rotateRight(AVLNode<Key,Value>* n)
     //then connect the parent to the child correctly but checking to see what side it is
     if (nParent == nullptr) //means is root as nothing above
     {
-        this->root_ = nChild;
+        root = nChild;
 
     }
     else if (nParent->getRight() == n)
@@ -716,27 +643,27 @@ void AVLTree<Key, Value>::rotateRight(AVLNode<Key,Value>* n)
     }
 }
 
-template<class Key, class Value>
+template<class N, class R>
 /**cases to handle for rotate:
  * when n->getLeft() has left and right node, need to move it's right to become y's top's left
  * update root if rotating one that is root and/or parent is nullptr
  * 
 */
-void AVLTree<Key, Value>::rotateLeft(AVLNode<Key,Value>* n)
+void AVLAlgo::rotateLeft(N* n, R*& root)
 {
     if (n == nullptr)
     {
         return;
     }
 
-    AVLNode<Key,Value>* nChild = n->getRight();//if is nullptr, means n has no children to rotate up
+    N* nChild = n->getRight();//if is nullptr, means n has no children to rotate up
     if (nChild == nullptr) //means nothing to move up
     {
         return;
     }
 
-    AVLNode<Key,Value>* nChildLeft = nChild->getLeft(); //will be nullptr if no right child of left child, just means will assign nullptr as left child later
-    AVLNode<Key,Value>* nParent = n->getParent();//if is nullptr, n is root and so child will end up being root anad need to switch
+    N* nChildLeft = nChild->getLeft(); //will be nullptr if no right child of left child, just means will assign nullptr as left child later
+    N* nParent = n->getParent();//if is nullptr, n is root and so child will end up being root anad need to switch
 
     //moves over below node's right child to be n's left child, will be nullptr if nChildRight does not exist
     //also make it's parent it's former child
@@ -758,7 +685,7 @@ void AVLTree<Key, Value>::rotateLeft(AVLNode<Key,Value>* n)
     //then connect the parent to the child correctly but checking to see what side it is
     if (nParent == nullptr) //means is root as nothing above
     {
-        this->root_ = nChild;
+        root = nChild;
 
     }
     else if (nParent->getRight() == n)
@@ -771,15 +698,996 @@ void AVLTree<Key, Value>::rotateLeft(AVLNode<Key,Value>* n)
     }
 }
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2)
+/**
+* Swaps the positions of n1 and n2 in the tree, balance factors included,
+* since a balance factor belongs to the position rather than the node.
+*/
+template<class N, class R>
+void AVLAlgo::swapNodes(N* n1, N* n2, R*& root)
 {
-    BinarySearchTree<Key, Value>::nodeSwap(n1, n2);
+    if (n1 == n2 || n1 == nullptr || n2 == nullptr)
+    {
+        return;
+    }
+    swapNodeLinks(n1, n2, root);
+
     int8_t tempB = n1->getBalance();
     n1->setBalance(n2->getBalance());
     n2->setBalance(tempB);
 }
 
+/*
+  -----------------------------------------------
+  End implementations for the AVLAlgo struct.
+  -----------------------------------------------
+*/
+
+template <class Key, class Value>
+class AVLTree : public BinarySearchTree<Key, Value>
+{
+public:
+    AVLTree();
+    AVLTree(const AVLTree& other);
+    AVLTree(AVLTree&& other) noexcept;
+    AVLTree& operator=(const AVLTree& other);
+    AVLTree& operator=(AVLTree&& other) noexcept;
+    void swap(AVLTree& other) noexcept;
+    template<class Tree> void swap(Tree& other) = delete;
+
+    virtual void insert (const std::pair<const Key, Value> &new_item); // TODO
+    virtual void remove(const Key& key);  // TODO
+    virtual void apply_batch(const std::vector<BatchOp<Key, Value> >& sorted_ops);
+    template<class InputIt>
+    void build_parallel(InputIt first, InputIt last, unsigned threads = 0);
+protected:
+    virtual void buildSorted(const std::vector<std::pair<Key, Value> >& items, unsigned threads);
+    void linkBalanced(std::vector<AVLNode<Key, Value>*>& nodes, unsigned threads);
+    virtual void nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2);
+
+    // Add helper functions here
+    virtual AVLNode<Key, Value>* createNode(const Key& key, const Value& value, Node<Key, Value>* parent) override;
+    virtual AVLNode<Key, Value>* cloneNode(const Node<Key, Value>* src, Node<Key, Value>* parent) const override;
+    AVLNode<Key, Value>* insertOrFind(const std::pair<const Key, Value> &new_item, bool& inserted);
+    virtual void removeNode(Node<Key, Value>* node) override;
+    void insertFix(AVLNode<Key,Value>* p, AVLNode<Key,Value>* n);
+    void removeFix(AVLNode<Key,Value>* n, int8_t diff);
+    virtual void rotateRight(AVLNode<Key,Value>* n);
+    virtual void rotateLeft(AVLNode<Key, Value>* n);
+    virtual void refreshPath(AVLNode<Key, Value>* n);
+    virtual void refreshNode(AVLNode<Key, Value>* n);
+    virtual char saveKind() const override;
+    virtual int8_t savedBalance(const Node<Key, Value>* node) const override;
+    virtual void restoreBalance(Node<Key, Value>* node, int8_t balance) override;
+    void flattenInOrder(std::vector<AVLNode<Key, Value>*>& out) const;
+    AVLNode<Key, Value>* batchInto(AVLNode<Key, Value>* t, int th,
+        const std::vector<BatchOp<Key, Value> >& ops, size_t lo, size_t hi, int& height);
+    AVLNode<Key, Value>* applyOps(AVLNode<Key, Value>* node,
+        const std::vector<BatchOp<Key, Value> >& ops, size_t lo, size_t hi);
+    AVLNode<Key, Value>* buildFromOps(const std::vector<BatchOp<Key, Value> >& ops, size_t lo, size_t hi, int& height);
+    AVLNode<Key, Value>* buildLinked(std::vector<AVLNode<Key, Value>*>& nodes, size_t lo, size_t hi, int& height);
+    AVLNode<Key, Value>* linkNode(AVLNode<Key, Value>* n, AVLNode<Key, Value>* left, int lh,
+        AVLNode<Key, Value>* right, int rh, int& height);
+    AVLNode<Key, Value>* join(AVLNode<Key, Value>* left, int lh, AVLNode<Key, Value>* mid,
+        AVLNode<Key, Value>* right, int rh, int& height);
+    AVLNode<Key, Value>* joinRight(AVLNode<Key, Value>* left, int lh, AVLNode<Key, Value>* mid,
+        AVLNode<Key, Value>* right, int rh, int& height);
+    AVLNode<Key, Value>* joinLeft(AVLNode<Key, Value>* left, int lh, AVLNode<Key, Value>* mid,
+        AVLNode<Key, Value>* right, int rh, int& height);
+    AVLNode<Key, Value>* joinPair(AVLNode<Key, Value>* left, int lh, AVLNode<Key, Value>* right, int rh, int& height);
+    AVLNode<Key, Value>* splitFirst(AVLNode<Key, Value>* t, int th, AVLNode<Key, Value>*& first, int& height);
+    static int leftHeight(const AVLNode<Key, Value>* n, int height);
+    static int rightHeight(const AVLNode<Key, Value>* n, int height);
+    static AVLNode<Key, Value>* buildBalanced(std::vector<AVLNode<Key, Value>*>& nodes,
+        size_t lo, size_t hi, AVLNode<Key, Value>* parent, int& height);
+    static AVLNode<Key, Value>* buildBalancedParallel(std::vector<AVLNode<Key, Value>*>& nodes,
+        size_t lo, size_t hi, AVLNode<Key, Value>* parent, int& height, unsigned threads);
+    template<class Fn>
+    static void forkJoin(size_t tasks, Fn fn);
+    int height() const;
+
+    friend struct AVLAlgo;
+};
+
+template<class Key, class Value>
+AVLTree<Key, Value>::AVLTree() :
+    BinarySearchTree<Key, Value>()
+{
+
+}
+
+/**
+* The shape and balance factors are copied as they are, so there is no
+* re-insertion and no rotation.
+*/
+template<class Key, class Value>
+AVLTree<Key, Value>::AVLTree(const AVLTree<Key, Value>& other) :
+    BinarySearchTree<Key, Value>()
+{
+    this->copyFrom(other);
+}
+
+template<class Key, class Value>
+AVLTree<Key, Value>::AVLTree(AVLTree<Key, Value>&& other) noexcept :
+    BinarySearchTree<Key, Value>()
+{
+    swap(other);
+}
+
+template<class Key, class Value>
+AVLTree<Key, Value>& AVLTree<Key, Value>::operator=(const AVLTree<Key, Value>& other)
+{
+    BinarySearchTree<Key, Value>::operator=(other);
+    return *this;
+}
+
+template<class Key, class Value>
+AVLTree<Key, Value>& AVLTree<Key, Value>::operator=(AVLTree<Key, Value>&& other) noexcept
+{
+    BinarySearchTree<Key, Value>::operator=(std::move(other));
+    return *this;
+}
+
+/**
+* Same as BinarySearchTree::swap(): O(1) for the same kind of tree.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::swap(AVLTree<Key, Value>& other) noexcept
+{
+    BinarySearchTree<Key, Value>::swap(static_cast<BinarySearchTree<Key, Value>&>(other));
+}
+
+/*
+ * Recall: If key is already in the tree, you should 
+ * overwrite the current value with the updated value.
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
+{
+    // TODO
+    bool inserted = false;
+    AVLNode<Key, Value>* node = insertOrFind(new_item, inserted);
+
+    //key was already there, so overwrite
+    if (!inserted)
+    {
+        node->setValue(new_item.second);
+        refreshPath(node);
+    }
+}
+
+/**
+* Allocates the AVLNode used by insert(); subclasses with their own node
+* type override this. buildSorted() calls it from several threads at once,
+* so an override must be thread safe or come with its own buildSorted().
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::createNode(const Key& key, const Value& value, Node<Key, Value>* parent)
+{
+    return new AVLNode<Key, Value>(key, value, static_cast<AVLNode<Key, Value>*>(parent));
+}
+
+/**
+* Copies src's key, value and balance factor into a new, unlinked AVLNode.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::cloneNode(const Node<Key, Value>* src, Node<Key, Value>* parent) const
+{
+    AVLNode<Key, Value>* copy = new AVLNode<Key, Value>(src->getKey(), src->getValue(), static_cast<AVLNode<Key, Value>*>(parent));
+    copy->setBalance(static_cast<const AVLNode<Key, Value>*>(src)->getBalance());
+    return copy;
+}
+
+/*
+ * Does the insert descent: if the key is new, links a fresh node and
+ * rebalances; otherwise leaves the tree alone. Either way returns the node
+ * holding the key, with inserted saying which case it was, so callers can
+ * decide what to do with an existing key without searching again.
+ */
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::insertOrFind(const std::pair<const Key, Value> &new_item, bool& inserted)
+{
+    inserted = false;
+
+    //if root is null, need to add one to start because there is nothing in this tree
+    if (this->root_ == nullptr)
+    {
+        //make new avl node (by default sets balance_ to 0)
+       AVLNode<Key, Value>* baby = createNode(new_item.first, new_item.second, nullptr);
+       this->root_ = baby;
+       inserted = true;
+       return baby;
+    }
+
+    else
+    {
+        //make a temp node set to root
+        AVLNode<Key, Value>* temp = static_cast<AVLNode<Key, Value>*>(this->root_);
+
+        //loop until we either link a new node or find the key
+        while (true)
+        {
+            //if the inserting one is less than temp, we go left of temp
+            if (new_item.first < temp->getKey())
+            {
+                //check if the left of my temp is null, bc then we'll put into my temp's left
+                if (temp->getLeft() == nullptr)
+                {
+                    AVLNode<Key, Value>* baby = createNode(new_item.first, new_item.second, temp);
+                    AVLAlgo::linkLeaf(*this, temp, baby, true);
+                    refreshPath(baby);
+                    inserted = true;
+                    return baby;
+                }
+
+                //otherwise move downwards again to check next one
+                else
+                {
+                    temp = temp->getLeft();
+                }
+            }
+            else if (new_item.first > temp->getKey())
+            {
+                //check if the Right of my temp is null/empty, bc then we'll put into my temp's Right
+                if (temp->getRight() == nullptr)
+                {
+                    AVLNode<Key, Value>* baby = createNode(new_item.first, new_item.second, temp);
+                    AVLAlgo::linkLeaf(*this, temp, baby, false);
+                    refreshPath(baby);
+                    inserted = true;
+                    return baby;
+                }
+
+                //othewise, move down to the right to check again
+                else
+                {
+                    temp = temp->getRight();
+                }
+            }
+            
+            //otherwise they are equal, so hand back the existing node
+            else
+            {
+                return temp;
+            }
+        }
+    }
+}
+
+//make insertFix function, passed parent node and also the node that was just inserted
+template<class Key, class Value>
+void AVLTree<Key, Value>::insertFix(AVLNode<Key,Value>* p, AVLNode<Key,Value>* n)
+{
+    AVLAlgo::insertFix(*this, p, n);
+}
+
+/*
+ * Recall: The writeup specifies that if a node has 2 children you
+ * should swap with the predecessor and then remove.
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>:: remove(const Key& key)
+{
+    // TODO
+
+    //if root is null, cannot remove anything so just return out
+    if (this->root_ == nullptr)
+    {
+        return;
+    }
+
+    //attempt to find the key in the tree, removeNode ignores a miss
+    removeNode(this->internalFind(key));
+}
+
+/*
+ * Unlinks and frees node, then rebalances. Shared by remove() and the
+ * iterator based erase(), which already has the node in hand.
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::removeNode(Node<Key, Value>* node)
+{
+    AVLNode<Key, Value>* curr = static_cast<AVLNode<Key, Value>*>(node);
+
+    //check to see if key not found in tree, so then can just return
+    if (curr == nullptr)
+    {
+        return;
+    }
+
+    //the finger must never point at a freed node
+    if (this->finger_ == curr)
+    {
+        this->finger_ = curr->getParent();
+    }
+
+    //splice curr out, then it's safe to free
+    int8_t diff = 0;
+    AVLNode<Key, Value>* parent = AVLAlgo::unlink(*this, curr, this->root_, diff);
+    this->destroyNode(curr);
+    refreshPath(parent);
+
+    //patch tree
+    removeFix(parent, diff);
+}
+
+template<class Key, class Value>
+void AVLTree<Key, Value>::removeFix(AVLNode<Key,Value>* n, int8_t diff)
+{
+    AVLAlgo::removeFix(*this, n, diff);
+}
+
+template<class Key, class Value>
+void AVLTree<Key, Value>::rotateRight(AVLNode<Key,Value>* n)
+{
+    AVLAlgo::rotateRight(n, this->root_);
+}
+
+template<class Key, class Value>
+void AVLTree<Key, Value>::rotateLeft(AVLNode<Key,Value>* n)
+{
+    AVLAlgo::rotateLeft(n, this->root_);
+}
+
+/**
+* Called with the lowest node whose subtree changed (possibly nullptr):
+* after a new node is linked in and rebalanced, after one is unlinked but
+* before rebalancing, and after a value is overwritten. Subclasses that keep
+* per-subtree data recompute it from n up to the root here; rotations are
+* handled by overriding rotateLeft/rotateRight.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::refreshPath(AVLNode<Key, Value>* n)
+{
+
+}
+
+/**
+* Called on a node whose children apply_batch() has just relinked, after
+* its children are final. Subclasses that keep per-subtree data recompute
+* it for n alone here.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::refreshNode(AVLNode<Key, Value>* n)
+{
+
+}
+
+/**
+* 'A': the node tags carry balance factors too. Subclasses that keep only
+* derived data on top (aggregates, arena ids) rebuild it in refreshAll().
+*/
+template<class Key, class Value>
+char AVLTree<Key, Value>::saveKind() const
+{
+    return 'A';
+}
+
+/**
+* save()/load() keep the balance factors, so a loaded tree needs no fixing up.
+*/
+template<class Key, class Value>
+int8_t AVLTree<Key, Value>::savedBalance(const Node<Key, Value>* node) const
+{
+    return static_cast<const AVLNode<Key, Value>*>(node)->getBalance();
+}
+
+template<class Key, class Value>
+void AVLTree<Key, Value>::restoreBalance(Node<Key, Value>* node, int8_t balance)
+{
+    static_cast<AVLNode<Key, Value>*>(node)->setBalance(balance);
+}
+
+template<class Key, class Value>
+void AVLTree<Key, Value>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2)
+{
+    AVLAlgo::swapNodes(n1, n2, this->root_);
+}
+
+/**
+* Applies a run of upserts and erases sorted by key (ops on the same key
+* take effect in order, so the last one wins).
+*
+* The ops are split around the root's key and each part is applied to its
+* subtree, recursively; the results are joined back around the root (or
+* around the next key, if the root was erased). Subtrees no op falls into
+* are returned untouched, so only the paths the run goes through are
+* walked and relinked: O(k log(n/k + 1)) for k ops, which is O(log n) for
+* one op and O(n + k) at worst. Ops landing on an empty spot are built into
+* a balanced subtree directly.
+*
+* Virtual because the nodes are relinked directly: subclasses whose nodes
+* or counters carry more than the links override it, either wrapping this
+* version or applying the ops through their own insert and remove.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::apply_batch(const std::vector<BatchOp<Key, Value> >& sorted_ops)
+{
+    if (sorted_ops.empty())
+    {
+        return;
+    }
+
+    //nodes may be freed along the way
+    this->finger_ = nullptr;
+    int newHeight = 0;
+    AVLNode<Key, Value>* root = batchInto(static_cast<AVLNode<Key, Value>*>(this->root_), height(),
+        sorted_ops, 0, sorted_ops.size(), newHeight);
+    if (root != nullptr)
+    {
+        root->setParent(nullptr);
+    }
+    this->root_ = root;
+}
+
+/**
+* Applies ops[lo, hi) to the subtree t of height th, which is cut loose
+* from its parent, and returns the new subtree with its height in height.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::batchInto(AVLNode<Key, Value>* t, int th,
+    const std::vector<BatchOp<Key, Value> >& ops, size_t lo, size_t hi, int& height)
+{
+    if (lo == hi)
+    {
+        height = th;
+        return t;
+    }
+    if (t == nullptr)
+    {
+        return buildFromOps(ops, lo, hi, height);
+    }
+
+    //ops before t's key, on it, and after it
+    const Key& key = t->getKey();
+    size_t first = lo;
+    while (first < hi && ops[first].key < key)
+    {
+        ++first;
+    }
+    size_t last = first;
+    while (last < hi && !(key < ops[last].key))
+    {
+        ++last;
+    }
+
+    AVLNode<Key, Value>* oldLeft = t->getLeft();
+    AVLNode<Key, Value>* oldRight = t->getRight();
+    int lh = 0;
+    int rh = 0;
+    AVLNode<Key, Value>* left = batchInto(oldLeft, leftHeight(t, th), ops, lo, first, lh);
+    AVLNode<Key, Value>* right = batchInto(oldRight, rightHeight(t, th), ops, last, hi, rh);
+
+    AVLNode<Key, Value>* mid = applyOps(t, ops, first, last);
+    if (mid == nullptr)
+    {
+        return joinPair(left, lh, right, rh, height);
+    }
+    return join(left, lh, mid, right, rh, height);
+}
+
+/**
+* Plays ops[lo, hi), all on one key, against node (null if the key is not
+* in the tree) and returns what is left of it; the node may come and go.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::applyOps(AVLNode<Key, Value>* node,
+    const std::vector<BatchOp<Key, Value> >& ops, size_t lo, size_t hi)
+{
+    for (size_t i = lo; i < hi; ++i)
+    {
+        if (ops[i].kind == BatchOp<Key, Value>::UPSERT)
+        {
+            if (node == nullptr)
+            {
+                node = createNode(ops[i].key, ops[i].value, nullptr);
+            }
+            else
+            {
+                node->setValue(ops[i].value);
+            }
+        }
+        else if (node != nullptr)
+        {
+            this->destroyNode(node);
+            node = nullptr;
+        }
+    }
+    return node;
+}
+
+/**
+* Builds the keys ops[lo, hi) leave behind into a perfectly balanced
+* subtree, for ops that fall where the tree has no nodes.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::buildFromOps(const std::vector<BatchOp<Key, Value> >& ops,
+    size_t lo, size_t hi, int& height)
+{
+    std::vector<AVLNode<Key, Value>*> nodes;
+    while (lo < hi)
+    {
+        size_t end = lo + 1;
+        while (end < hi && !(ops[lo].key < ops[end].key))
+        {
+            ++end;
+        }
+        AVLNode<Key, Value>* node = applyOps(nullptr, ops, lo, end);
+        if (node != nullptr)
+        {
+            nodes.push_back(node);
+        }
+        lo = end;
+    }
+    return buildLinked(nodes, 0, nodes.size(), height);
+}
+
+/**
+* buildBalanced() through linkNode(), so every node is refreshed.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::buildLinked(std::vector<AVLNode<Key, Value>*>& nodes,
+    size_t lo, size_t hi, int& height)
+{
+    if (lo >= hi)
+    {
+        height = 0;
+        return nullptr;
+    }
+
+    size_t mid = lo + (hi - lo) / 2;
+    int lh = 0;
+    int rh = 0;
+    AVLNode<Key, Value>* left = buildLinked(nodes, lo, mid, lh);
+    AVLNode<Key, Value>* right = buildLinked(nodes, mid + 1, hi, rh);
+    return linkNode(nodes[mid], left, lh, right, rh, height);
+}
+
+/**
+* Makes left and right (of heights lh and rh, at most one apart) the
+* children of n and returns n, with its height in height.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::linkNode(AVLNode<Key, Value>* n, AVLNode<Key, Value>* left, int lh,
+    AVLNode<Key, Value>* right, int rh, int& height)
+{
+    n->setLeft(left);
+    n->setRight(right);
+    if (left != nullptr)
+    {
+        left->setParent(n);
+    }
+    if (right != nullptr)
+    {
+        right->setParent(n);
+    }
+    n->setBalance((int8_t)(rh - lh));
+    refreshNode(n);
+
+    height = std::max(lh, rh) + 1;
+    return n;
+}
+
+/**
+* Joins left, mid and right, where every key in left is below mid's and
+* every key in right above it, into one AVL tree in O(|lh - rh| + 1): mid
+* is hung at the spot on the taller tree's inner spine where the other
+* tree fits, and the way back up is rebalanced.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::join(AVLNode<Key, Value>* left, int lh, AVLNode<Key, Value>* mid,
+    AVLNode<Key, Value>* right, int rh, int& height)
+{
+    if (lh > rh + 1)
+    {
+        return joinRight(left, lh, mid, right, rh, height);
+    }
+    if (rh > lh + 1)
+    {
+        return joinLeft(left, lh, mid, right, rh, height);
+    }
+    return linkNode(mid, left, lh, right, rh, height);
+}
+
+/**
+* join() for a left tree at least two taller: walks down its right spine.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::joinRight(AVLNode<Key, Value>* left, int lh, AVLNode<Key, Value>* mid,
+    AVLNode<Key, Value>* right, int rh, int& height)
+{
+    AVLNode<Key, Value>* outer = left->getLeft();
+    AVLNode<Key, Value>* inner = left->getRight();
+    int oh = leftHeight(left, lh);
+    int ih = rightHeight(left, lh);
+
+    if (ih <= rh + 1)
+    {
+        //mid over inner and right is short enough to hang here
+        if (std::max(ih, rh) <= oh)
+        {
+            int midHeight = 0;
+            linkNode(mid, inner, ih, right, rh, midHeight);
+            return linkNode(left, outer, oh, mid, midHeight, height);
+        }
+
+        //it would be two taller than outer: inner becomes the root instead
+        int innerLeftHeight = leftHeight(inner, ih);
+        int innerRightHeight = rightHeight(inner, ih);
+        AVLNode<Key, Value>* innerLeft = inner->getLeft();
+        AVLNode<Key, Value>* innerRight = inner->getRight();
+        int lowHeight = 0;
+        int highHeight = 0;
+        linkNode(left, outer, oh, innerLeft, innerLeftHeight, lowHeight);
+        linkNode(mid, innerRight, innerRightHeight, right, rh, highHeight);
+        return linkNode(inner, left, lowHeight, mid, highHeight, height);
+    }
+
+    int joinedHeight = 0;
+    AVLNode<Key, Value>* joined = joinRight(inner, ih, mid, right, rh, joinedHeight);
+    if (joinedHeight <= oh + 1)
+    {
+        return linkNode(left, outer, oh, joined, joinedHeight, height);
+    }
+
+    //the joined side came back two taller than outer, and right heavy: rotate left
+    AVLNode<Key, Value>* joinedLeft = joined->getLeft();
+    AVLNode<Key, Value>* joinedRight = joined->getRight();
+    int joinedLeftHeight = leftHeight(joined, joinedHeight);
+    int joinedRightHeight = rightHeight(joined, joinedHeight);
+    int lowHeight = 0;
+    linkNode(left, outer, oh, joinedLeft, joinedLeftHeight, lowHeight);
+    return linkNode(joined, left, lowHeight, joinedRight, joinedRightHeight, height);
+}
+
+/**
+* Mirror image of joinRight(), for a right tree at least two taller.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::joinLeft(AVLNode<Key, Value>* left, int lh, AVLNode<Key, Value>* mid,
+    AVLNode<Key, Value>* right, int rh, int& height)
+{
+    AVLNode<Key, Value>* outer = right->getRight();
+    AVLNode<Key, Value>* inner = right->getLeft();
+    int oh = rightHeight(right, rh);
+    int ih = leftHeight(right, rh);
+
+    if (ih <= lh + 1)
+    {
+        if (std::max(ih, lh) <= oh)
+        {
+            int midHeight = 0;
+            linkNode(mid, left, lh, inner, ih, midHeight);
+            return linkNode(right, mid, midHeight, outer, oh, height);
+        }
+
+        int innerLeftHeight = leftHeight(inner, ih);
+        int innerRightHeight = rightHeight(inner, ih);
+        AVLNode<Key, Value>* innerLeft = inner->getLeft();
+        AVLNode<Key, Value>* innerRight = inner->getRight();
+        int lowHeight = 0;
+        int highHeight = 0;
+        linkNode(mid, left, lh, innerLeft, innerLeftHeight, lowHeight);
+        linkNode(right, innerRight, innerRightHeight, outer, oh, highHeight);
+        return linkNode(inner, mid, lowHeight, right, highHeight, height);
+    }
+
+    int joinedHeight = 0;
+    AVLNode<Key, Value>* joined = joinLeft(left, lh, mid, inner, ih, joinedHeight);
+    if (joinedHeight <= oh + 1)
+    {
+        return linkNode(right, joined, joinedHeight, outer, oh, height);
+    }
+
+    AVLNode<Key, Value>* joinedLeft = joined->getLeft();
+    AVLNode<Key, Value>* joinedRight = joined->getRight();
+    int joinedLeftHeight = leftHeight(joined, joinedHeight);
+    int joinedRightHeight = rightHeight(joined, joinedHeight);
+    int highHeight = 0;
+    linkNode(right, joinedRight, joinedRightHeight, outer, oh, highHeight);
+    return linkNode(joined, joinedLeft, joinedLeftHeight, right, highHeight, height);
+}
+
+/**
+* join() without a middle node, for when it was erased: the smallest node
+* of right takes its place.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::joinPair(AVLNode<Key, Value>* left, int lh,
+    AVLNode<Key, Value>* right, int rh, int& height)
+{
+    if (right == nullptr)
+    {
+        height = lh;
+        return left;
+    }
+    if (left == nullptr)
+    {
+        height = rh;
+        return right;
+    }
+
+    AVLNode<Key, Value>* first = nullptr;
+    int restHeight = 0;
+    AVLNode<Key, Value>* rest = splitFirst(right, rh, first, restHeight);
+    return join(left, lh, first, rest, restHeight, height);
+}
+
+/**
+* Takes the smallest node out of the non-empty subtree t into first and
+* returns the rest, rejoined on the way back up in O(th).
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::splitFirst(AVLNode<Key, Value>* t, int th,
+    AVLNode<Key, Value>*& first, int& height)
+{
+    AVLNode<Key, Value>* left = t->getLeft();
+    AVLNode<Key, Value>* right = t->getRight();
+    int rh = rightHeight(t, th);
+    if (left == nullptr)
+    {
+        first = t;
+        height = rh;
+        return right;
+    }
+
+    int restHeight = 0;
+    AVLNode<Key, Value>* rest = splitFirst(left, leftHeight(t, th), first, restHeight);
+    return join(rest, restHeight, t, right, rh, height);
+}
+
+/**
+* Height of n's left subtree, given n's own height and balance factor.
+*/
+template<class Key, class Value>
+int AVLTree<Key, Value>::leftHeight(const AVLNode<Key, Value>* n, int height)
+{
+    return (n->getBalance() > 0) ? height - 2 : height - 1;
+}
+
+template<class Key, class Value>
+int AVLTree<Key, Value>::rightHeight(const AVLNode<Key, Value>* n, int height)
+{
+    return (n->getBalance() < 0) ? height - 2 : height - 1;
+}
+
+/**
+* Replaces the contents of the tree with the pairs in [first, last), which
+* may come in any order and repeat keys (the last pair for a key wins).
+*
+* The sorting is spread over threads (default: one per hardware thread):
+* chunks of the input are stable sorted side by side and then merged
+* pairwise. The sorted run then goes to buildSorted(), which subclasses
+* override to keep their own invariants. Inputs too small to be worth a
+* thread are done inline.
+*/
+template<class Key, class Value>
+template<class InputIt>
+void AVLTree<Key, Value>::build_parallel(InputIt first, InputIt last, unsigned threads)
+{
+    typedef std::pair<Key, Value> Item;
+    static const size_t MIN_PER_THREAD = 8192;
+
+    std::vector<Item> items;
+    for (; first != last; ++first)
+    {
+        items.push_back(Item(first->first, first->second));
+    }
+
+    if (threads == 0)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    size_t chunks = std::max<size_t>(1, std::min<size_t>(threads, items.size() / MIN_PER_THREAD));
+    std::vector<size_t> bounds(chunks + 1);
+    for (size_t c = 0; c <= chunks; ++c)
+    {
+        bounds[c] = items.size() * c / chunks;
+    }
+
+    //stable sorts keep equal keys in input order, which is what makes the last one win
+    auto byKey = [](const Item& a, const Item& b) { return a.first < b.first; };
+    forkJoin(chunks, [&](size_t c) {
+        std::stable_sort(items.begin() + bounds[c], items.begin() + bounds[c + 1], byKey);
+    });
+    for (size_t width = 1; width < chunks; width *= 2)
+    {
+        forkJoin((chunks + 2 * width - 1) / (2 * width), [&](size_t pair) {
+            size_t lo = pair * 2 * width;
+            size_t mid = std::min(lo + width, chunks);
+            size_t hi = std::min(lo + 2 * width, chunks);
+            std::inplace_merge(items.begin() + bounds[lo], items.begin() + bounds[mid],
+                items.begin() + bounds[hi], byKey);
+        });
+    }
+
+    buildSorted(items, (items.size() >= 2 * MIN_PER_THREAD) ? threads : 1);
+}
+
+/**
+* The bulk rebuild behind build_parallel(): replaces the contents of the
+* tree with items, which are sorted by key with equal keys in input order.
+* Keeps the last item for each key.
+*
+* items is cut into one range per thread. Each range first counts the
+* items that survive, which gives every range its slots in the node array.
+* Each range then creates its nodes in place. The linking is spread over
+* the same threads. Subclasses whose createNode() cannot run in parallel,
+* or whose nodes need more than one item, override this.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::buildSorted(const std::vector<std::pair<Key, Value> >& items, unsigned threads)
+{
+    this->clear();
+
+    size_t chunks = std::max<size_t>(1, std::min<size_t>(threads, items.size()));
+    std::vector<size_t> bounds(chunks + 1);
+    for (size_t c = 0; c <= chunks; ++c)
+    {
+        bounds[c] = items.size() * c / chunks;
+    }
+
+    //an item survives if the next one has a different key
+    auto survives = [&](size_t i) {
+        return i + 1 == items.size() || items[i].first < items[i + 1].first;
+    };
+    std::vector<size_t> offsets(chunks + 1, 0);
+    forkJoin(chunks, [&](size_t c) {
+        for (size_t i = bounds[c]; i < bounds[c + 1]; ++i)
+        {
+            offsets[c + 1] += survives(i) ? 1 : 0;
+        }
+    });
+    for (size_t c = 0; c < chunks; ++c)
+    {
+        offsets[c + 1] += offsets[c];
+    }
+
+    std::vector<AVLNode<Key, Value>*> nodes(offsets[chunks]);
+    forkJoin(chunks, [&](size_t c) {
+        size_t out = offsets[c];
+        for (size_t i = bounds[c]; i < bounds[c + 1]; ++i)
+        {
+            if (survives(i))
+            {
+                nodes[out++] = createNode(items[i].first, items[i].second, nullptr);
+            }
+        }
+    });
+    linkBalanced(nodes, threads);
+}
+
+/**
+* Makes nodes, which must be in key order and not yet in any tree, the
+* whole contents of this (empty) tree: links them perfectly balanced, using
+* up to threads threads, then lets subclasses refresh their subtree data.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::linkBalanced(std::vector<AVLNode<Key, Value>*>& nodes, unsigned threads)
+{
+    int newHeight = 0;
+    this->root_ = buildBalancedParallel(nodes, 0, nodes.size(), nullptr, newHeight, threads);
+    this->refreshAll();
+}
+
+/**
+* Height of the tree (0 when empty), found in O(log n) by always stepping
+* into the taller child according to the balance factors.
+*/
+template<class Key, class Value>
+int AVLTree<Key, Value>::height() const
+{
+    int h = 0;
+    for (AVLNode<Key, Value>* curr = static_cast<AVLNode<Key, Value>*>(this->root_); curr != nullptr; ++h)
+    {
+        curr = (curr->getBalance() > 0) ? curr->getRight() : curr->getLeft();
+    }
+    return h;
+}
+
+/**
+* Appends every node of the tree to out in key order, using the parent
+* links rather than recursion.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::flattenInOrder(std::vector<AVLNode<Key, Value>*>& out) const
+{
+    for (Node<Key, Value>* curr = this->getSmallestNode(); curr != nullptr; curr = this->successor(curr))
+    {
+        out.push_back(static_cast<AVLNode<Key, Value>*>(curr));
+    }
+}
+
+/**
+* Links nodes[lo, hi), which must already be in key order, into a perfectly
+* balanced subtree hanging off parent and returns its root. Balance fields
+* are set from the subtree heights and height is set to the subtree's
+* height, so whole trees can be rebuilt in O(n) without any rotations.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::buildBalanced(std::vector<AVLNode<Key, Value>*>& nodes,
+    size_t lo, size_t hi, AVLNode<Key, Value>* parent, int& height)
+{
+    if (lo >= hi)
+    {
+        height = 0;
+        return nullptr;
+    }
+
+    //middle element becomes the root; rounding down puts any odd node out on the left, so the
+    //right side is never the taller one (for 2 nodes it is empty) and balance stays 0 or -1
+    size_t mid = lo + (hi - lo) / 2;
+    AVLNode<Key, Value>* n = nodes[mid];
+    int leftHeight = 0;
+    int rightHeight = 0;
+
+    n->setParent(parent);
+    n->setLeft(buildBalanced(nodes, lo, mid, n, leftHeight));
+    n->setRight(buildBalanced(nodes, mid + 1, hi, n, rightHeight));
+    n->setBalance((int8_t)(rightHeight - leftHeight));
+
+    height = std::max(leftHeight, rightHeight) + 1;
+    return n;
+}
+
+/**
+* buildBalanced() that hands the left half of the range to a new thread and
+* builds the right half itself, splitting the thread budget between them,
+* until only one thread is left for a subtree.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::buildBalancedParallel(std::vector<AVLNode<Key, Value>*>& nodes,
+    size_t lo, size_t hi, AVLNode<Key, Value>* parent, int& height, unsigned threads)
+{
+    if (threads <= 1 || hi - lo < 2)
+    {
+        return buildBalanced(nodes, lo, hi, parent, height);
+    }
+
+    //same split as buildBalanced() so the shape and balance fields come out identical
+    size_t mid = lo + (hi - lo) / 2;
+    AVLNode<Key, Value>* n = nodes[mid];
+    int leftHeight = 0;
+    int rightHeight = 0;
+    AVLNode<Key, Value>* left = nullptr;
+
+    std::thread worker([&]() {
+        left = buildBalancedParallel(nodes, lo, mid, n, leftHeight, threads / 2);
+    });
+    AVLNode<Key, Value>* right = buildBalancedParallel(nodes, mid + 1, hi, n, rightHeight, threads - threads / 2);
+    worker.join();
+
+    n->setParent(parent);
+    n->setLeft(left);
+    n->setRight(right);
+    n->setBalance((int8_t)(rightHeight - leftHeight));
+
+    height = std::max(leftHeight, rightHeight) + 1;
+    return n;
+}
+
+/**
+* Calls fn(0) ... fn(tasks - 1), each on its own thread except the last,
+* which runs on the calling one, and returns once all of them are done.
+*/
+template<class Key, class Value>
+template<class Fn>
+void AVLTree<Key, Value>::forkJoin(size_t tasks, Fn fn)
+{
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i + 1 < tasks; ++i)
+    {
+        workers.push_back(std::thread(fn, i));
+    }
+    if (tasks > 0)
+    {
+        fn(tasks - 1);
+    }
+    for (size_t i = 0; i < workers.size(); ++i)
+    {
+        workers[i].join();
+    }
+}
+
 
 
 #endif
@@ -1,10 +1,41 @@
 #include <iostream>
 #include <map>
+#include <sstream>
 #include "bst.h"
 #include "avlbst.h"
+#include "avl-multimap.h"
+#include "avl-lazy.h"
+#include "intrusive-avl.h"
+#include "avl-augmented.h"
+#include "interval-tree.h"
+#include "avl-seqlock.h"
+#include "tree-parallel.h"
+#include "static-map.h"
+#include "avl-compact.h"
+#include "treap.h"
+#include "avl-set.h"
+#include "avl-split-map.h"
+#include "avl-stack.h"
+#include "equal-paths-fast.h"
+#include "tree-export.h"
 
 using namespace std;
 
+// Demo table for StaticMap, laid out by the compiler
+constexpr StaticEntry<int, char> gradeCutoffs[] = { {50, 'F'}, {60, 'D'}, {70, 'C'}, {80, 'B'}, {90, 'A'} };
+constexpr StaticMap<int, char, 5> grades(gradeCutoffs);
+static_assert(grades.at(70) == 'C', "StaticMap lookups run at compile time");
+
+// Demo type for the intrusive tree: the object carries its own links
+struct Job : AVLHook<> {
+    int id;
+    int priority;
+};
+
+struct JobId {
+    int operator()(const Job& j) const { return j.id; }
+};
+
 
 int main(int argc, char *argv[])
 {
@@ -23,6 +54,9 @@ int main(int argc, char *argv[])
     else {
         cout << "Did not find b" << endl;
     }
+    TreeShape shape = measureShape(TreeAccess::root(bt));
+    cout << "Height " << shape.height << ", leaves " << shape.leafCount
+         << ", balanced " << shape.balanced << endl;
     cout << "Erasing b" << endl;
     bt.remove('b');
 
@@ -41,8 +75,143 @@ int main(int argc, char *argv[])
     else {
         cout << "Did not find b" << endl;
     }
+    cout << "Equal paths: " << equalPathsIterative(TreeAccess::root(at)) << endl;
+    exportJson(cout, at);
     cout << "Erasing b" << endl;
     at.remove('b');
+    cout << "Erasing a by iterator" << endl;
+    if(at.erase(at.find('a')) == at.end() && at.empty()) {
+        cout << "AVLTree now empty" << endl;
+    }
+
+    // AVL multimap tests
+    AVLMultiMap<char,int> mm;
+    mm.insert(std::make_pair('a',1));
+    mm.insert(std::make_pair('a',2));
+    mm.append(mm.find('a'), 3);
+    cout << "\nMultimap count of a: " << mm.count('a') << endl;
+    std::pair<AVLMultiMap<char,int>::value_iterator, AVLMultiMap<char,int>::value_iterator> range = mm.equal_range('a');
+    for(AVLMultiMap<char,int>::value_iterator it = range.first; it != range.second; ++it) {
+        cout << *it << " ";
+    }
+    cout << endl;
+
+    // Lazy delete AVL tests
+    LazyAVLTree<char,int> lt;
+    lt.insert(std::make_pair('a',1));
+    lt.insert(std::make_pair('b',2));
+    lt.remove('a');
+    cout << "\nLazy AVLTree contents (" << lt.deadCount() << " dead):" << endl;
+    for(LazyAVLTree<char,int>::iterator it = lt.begin(); it != lt.end(); ++it) {
+        cout << it->first << " " << it->second << endl;
+    }
+    lt.compact();
+
+    // Intrusive AVL tests
+    Job jobs[3];
+    IntrusiveAVLTree<Job, JobId> jt;
+    for(int i = 0; i < 3; ++i) {
+        jobs[i].id = 3 - i;
+        jobs[i].priority = i;
+        jt.insert(jobs[i]);
+    }
+    jt.remove(jobs[1]);
+    cout << "\nIntrusive AVLTree contents:" << endl;
+    for(IntrusiveAVLTree<Job, JobId>::iterator it = jt.begin(); it != jt.end(); ++it) {
+        cout << it->id << " " << it->priority << endl;
+    }
+
+    // Augmented AVL tests
+    AugmentedAVLTree<int,int,SumAggregate<int> > sums;
+    for(int i = 1; i <= 10; ++i) {
+        sums.insert(std::make_pair(i, i * i));
+    }
+    sums.remove(5);
+    cout << "\nSum of squares over [3, 7] without 5: " << sums.aggregate(3, 7) << endl;
+
+    // Interval tree tests
+    IntervalTree<int,char> it;
+    it.insert(0, 10, 'a');
+    it.insert(5, 8, 'b');
+    it.insert(12, 20, 'c');
+    cout << "\nIntervals containing 6:";
+    it.stab(6, [](std::pair<const Interval<int>, char>& iv) {
+        cout << " " << iv.first << "=" << iv.second;
+    });
+    cout << endl;
+
+    // Seqlock AVL tests
+    SeqlockAVLTree<int,double> st;
+    st.insert(std::make_pair(1, 0.5));
+    st.insert(std::make_pair(2, 1.5));
+    st.remove(1);
+    double sv = 0;
+    cout << "\nSeqlock lookup 2: " << (st.lookup(2, sv) ? sv : -1) << ", contains 1: " << st.contains(1) << endl;
+
+    // Parallel traversal tests
+    AVLTree<int,int> big;
+    for(int i = 1; i <= 1000; ++i) {
+        big.insert(std::make_pair(i, i));
+    }
+    long total = parallel_reduce(big, 0L,
+        [](long acc, const std::pair<const int,int>& kv) { return acc + kv.second; },
+        [](long a, long b) { return a + b; });
+    cout << "\nParallel sum of 1..1000: " << total << endl;
+
+    // Save/load tests
+    stringstream saved;
+    big.save(saved);
+    AVLTree<int,int> restored;
+    restored.load(saved);
+    cout << "Restored " << saved.str().size() << " bytes, balanced: " << restored.isBalanced() << endl;
+
+    // Static map tests
+    cout << "\nGrade at 80: " << grades.at(80) << ", has 85: " << grades.contains(85) << endl;
+
+    // Compacting AVL tests
+    CompactingAVLTree<int,int> packed;
+    for(int i = 0; i < 100; ++i) {
+        packed.insert(std::make_pair((i * 37) % 100, i));
+    }
+    while(!packed.compactStep(16)) {
+        packed.remove(packed.begin()->first);
+    }
+    cout << "Compacted tree balanced: " << packed.isBalanced() << ", smallest key " << packed.begin()->first << endl;
+
+    // Treap tests
+    Treap<int,int> low;
+    for(int i = 1; i <= 10; ++i) {
+        low.insert(std::make_pair(i, i * i));
+    }
+    Treap<int,int> high;
+    low.split(6, high);
+    cout << "\nTreap split at 6: low has 6: " << (low.find(6) != low.end()) << ", high starts at " << high.begin()->first << endl;
+    low.merge(high);
+    cout << "Merged back, 9 maps to " << low[9] << ", high empty: " << high.empty() << endl;
+
+    // Key set tests
+    AVLSet<int> seen;
+    for(int i = 0; i < 20; ++i) {
+        seen.insert((i * 7) % 10);
+    }
+    seen.remove(3);
+    cout << "\nSet holds " << seen.size() << " keys, first " << *seen.begin() << ", has 3: " << seen.contains(3) << ", balanced: " << seen.isBalanced() << endl;
+
+    // Split map tests
+    SplitAVLMap<int,string> names;
+    names.insert(std::make_pair(2, string("two")));
+    names.insert(std::make_pair(1, string("one")));
+    names.remove(2);
+    names.insert(std::make_pair(3, string("three")));
+    cout << "Split map: 1 is " << names.find(1)->second << ", 3 is " << names[3] << ", has 2: " << (names.find(2) != names.end()) << endl;
+
+    // Parent-free AVL tests
+    StackAVLTree<int,int> lean;
+    for(int i = 1; i <= 15; ++i) {
+        lean.insert(std::make_pair(i, i * 10));
+    }
+    lean.remove(8);
+    cout << "\nStack AVL after 7: " << (++lean.find(7))->first << ", balanced: " << lean.isBalanced() << endl;
 
     return 0;
 }
@@ -4,7 +4,13 @@
 #include <iostream>
 #include <exception>
 #include <cstdlib>
+#include <cstdint>
+#include <stdexcept>
+#include <typeinfo>
 #include <utility>
+#include <vector>
+#include "tree-shape.h"
+#include "tree-codec.h"
 
 /**
  * A templated class for a Node in a search tree.
@@ -186,6 +192,97 @@ void Node<Key, Value>::setValue(const Value& value)
   ---------------------------------------
 */
 
+/**
+* Swaps the positions of n1 and n2 in a tree rooted at root, relinking
+* their parents and children (and each other, when one is the other's
+* child). Only links move, so items, iterators and any per-node data stay
+* with their nodes. Works on any node type with parent, left and right
+* getters and setters, so the tree classes and the node-generic AVLAlgo
+* share this one copy.
+*/
+template<class N, class R>
+void swapNodeLinks(N* n1, N* n2, R*& root)
+{
+    if (n1 == n2 || n1 == nullptr || n2 == nullptr)
+    {
+        return;
+    }
+    N* n1p = n1->getParent();
+    N* n1r = n1->getRight();
+    N* n1lt = n1->getLeft();
+    bool n1isLeft = (n1p != nullptr && n1 == n1p->getLeft());
+    N* n2p = n2->getParent();
+    N* n2r = n2->getRight();
+    N* n2lt = n2->getLeft();
+    bool n2isLeft = (n2p != nullptr && n2 == n2p->getLeft());
+
+    n1->setParent(n2p);
+    n2->setParent(n1p);
+    n1->setLeft(n2lt);
+    n2->setLeft(n1lt);
+    n1->setRight(n2r);
+    n2->setRight(n1r);
+
+    //when one is the other's child, the link between them has to point the other way now
+    if (n1r == n2)
+    {
+        n2->setRight(n1);
+        n1->setParent(n2);
+    }
+    else if (n2r == n1)
+    {
+        n1->setRight(n2);
+        n2->setParent(n1);
+    }
+    else if (n1lt == n2)
+    {
+        n2->setLeft(n1);
+        n1->setParent(n2);
+    }
+    else if (n2lt == n1)
+    {
+        n1->setLeft(n2);
+        n2->setParent(n1);
+    }
+
+    if (n1p != nullptr && n1p != n2)
+    {
+        if (n1isLeft) n1p->setLeft(n2);
+        else n1p->setRight(n2);
+    }
+    if (n1r != nullptr && n1r != n2)
+    {
+        n1r->setParent(n2);
+    }
+    if (n1lt != nullptr && n1lt != n2)
+    {
+        n1lt->setParent(n2);
+    }
+
+    if (n2p != nullptr && n2p != n1)
+    {
+        if (n2isLeft) n2p->setLeft(n1);
+        else n2p->setRight(n1);
+    }
+    if (n2r != nullptr && n2r != n1)
+    {
+        n2r->setParent(n1);
+    }
+    if (n2lt != nullptr && n2lt != n1)
+    {
+        n2lt->setParent(n1);
+    }
+
+    if (root == n1)
+    {
+        root = n2;
+    }
+    else if (root == n2)
+    {
+        root = n1;
+    }
+}
+
 /**
 * A templated unbalanced binary search tree.
 */
@@ -194,16 +291,29 @@ class BinarySearchTree
 {
 public:
     BinarySearchTree(); //TODO
+    BinarySearchTree(const BinarySearchTree& other);
+    BinarySearchTree(BinarySearchTree&& other) noexcept;
     virtual ~BinarySearchTree(); //TODO
+    BinarySearchTree& operator=(const BinarySearchTree& other);
+    BinarySearchTree& operator=(BinarySearchTree&& other) noexcept;
+    void swap(BinarySearchTree& other) noexcept;
+    // swapping with another kind of tree would hand it nodes it cannot free
+    template<class Tree> void swap(Tree& other) = delete;
     virtual void insert(const std::pair<const Key, Value>& keyValuePair); //TODO
     virtual void remove(const Key& key); //TODO
-    void clear(); //TODO
+    virtual void clear(); //TODO
     bool isBalanced() const; //TODO
     void print() const;
     bool empty() const;
+    void setFingerSearch(bool enabled);
+    template<class KeyCodec = BinaryCodec<Key>, class ValueCodec = BinaryCodec<Value> >
+    void save(std::ostream& out) const;
+    template<class KeyCodec = BinaryCodec<Key>, class ValueCodec = BinaryCodec<Value> >
+    bool load(std::istream& in);
 
     template<typename PPKey, typename PPValue>
     friend void prettyPrintBST(BinarySearchTree<PPKey, PPValue> & tree);
+    friend struct TreeAccess;
 public:
     /**
     * An internal iterator class for traversing the contents of the BST.
@@ -231,6 +341,9 @@ public:
     iterator begin() const;
     iterator end() const;
     iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    iterator erase(iterator pos);
+    iterator erase(iterator first, iterator last);
     Value& operator[](const Key& key);
     Value const & operator[](const Key& key) const;
 
@@ -248,12 +361,41 @@ protected:
     virtual void nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2) ;
 
     // Add helper functions here
+    virtual Node<Key, Value>* createNode(const Key& key, const Value& value, Node<Key, Value>* parent);
+    virtual Node<Key, Value>* cloneNode(const Node<Key, Value>* src, Node<Key, Value>* parent) const;
+    void copyFrom(const BinarySearchTree<Key, Value>& other);
+    void requireSameKind(const BinarySearchTree<Key, Value>& other) const;
+    virtual void swapTree(BinarySearchTree<Key, Value>& other) noexcept;
+    void exchangeItems(BinarySearchTree<Key, Value>& other) noexcept;
+    virtual void collectItems(std::vector<std::pair<Key, Value> >& out) const;
+    virtual void removeNode(Node<Key, Value>* curr);
+    Node<Key, Value>* fingerFind(const Key& key) const;
+    static Node<Key, Value>* nodeOf(const iterator& it);
     void helpClear(Node<Key, Value>* montez);
-    int calculateHeightIfBalanced(Node<Key, Value>* root) const;
+    virtual void destroyNode(Node<Key, Value>* node);
+    virtual char saveKind() const;
+    virtual int8_t savedBalance(const Node<Key, Value>* node) const;
+    virtual void restoreBalance(Node<Key, Value>* node, int8_t balance);
+    virtual void refreshAll();
 
 protected:
     Node<Key, Value>* root_;
     // You should not need other data members
+    mutable Node<Key, Value>* finger_;  // last node a lookup ended on; not thread safe, see setFingerSearch()
+    bool fingerSearch_;
+};
+
+/**
+* Gives the node-generic helpers (equal-paths-fast.h and friends) read
+* access to a tree's root without making root_ public.
+*/
+struct TreeAccess
+{
+    template<typename Key, typename Value>
+    static Node<Key, Value>* root(const BinarySearchTree<Key, Value>& tree)
+    {
+        return tree.root_;
+    }
 };
 
 /*
@@ -364,12 +506,35 @@ Begin implementations for the BinarySearchTree class.
 */
 template<class Key, class Value>
 BinarySearchTree<Key, Value>::BinarySearchTree():
-root_(nullptr)
+root_(nullptr), finger_(nullptr), fingerSearch_(false)
 {
     // TODO
     //did above
 }
 
+/**
+* Copy constructor: an O(n) structural clone of other, node for node, with
+* no re-insertion.
+*/
+template<class Key, class Value>
+BinarySearchTree<Key, Value>::BinarySearchTree(const BinarySearchTree<Key, Value>& other):
+root_(nullptr), finger_(nullptr), fingerSearch_(false)
+{
+    copyFrom(other);
+}
+
+/**
+* Move constructor: takes over other's nodes in O(1), leaving other empty.
+* Subclasses move through their own swap() instead, so other is only a
+* different kind of tree when it was passed by base reference; see swap().
+*/
+template<class Key, class Value>
+BinarySearchTree<Key, Value>::BinarySearchTree(BinarySearchTree<Key, Value>&& other) noexcept:
+root_(nullptr), finger_(nullptr), fingerSearch_(false)
+{
+    swap(other);
+}
+
 template<typename Key, typename Value>
 BinarySearchTree<Key, Value>::~BinarySearchTree()
 {
@@ -378,6 +543,126 @@ BinarySearchTree<Key, Value>::~BinarySearchTree()
 
 }
 
+/**
+* Copy assignment: frees this tree's nodes, then clones other's. The clones
+* come from this tree's cloneNode(), which only understands its own kind of
+* node, so a different kind behind a base reference throws invalid_argument
+* and leaves this tree as it was.
+*/
+template<typename Key, typename Value>
+BinarySearchTree<Key, Value>&
+BinarySearchTree<Key, Value>::operator=(const BinarySearchTree<Key, Value>& other)
+{
+    if (this != &other)
+    {
+        requireSameKind(other);
+        clear();
+        copyFrom(other);
+    }
+    return *this;
+}
+
+/**
+* Move assignment: frees this tree's nodes and takes over other's, as for
+* swap().
+*/
+template<typename Key, typename Value>
+BinarySearchTree<Key, Value>&
+BinarySearchTree<Key, Value>::operator=(BinarySearchTree<Key, Value>&& other) noexcept
+{
+    if (this != &other)
+    {
+        clear();
+        swap(other);
+    }
+    return *this;
+}
+
+/**
+* Exchanges the contents of two trees in O(1) through swapTree(), which
+* every kind of tree with members of its own extends. A different static
+* type does not compile. A different dynamic type behind base references
+* cannot trade nodes, so the items are re-inserted on both sides instead
+* (see exchangeItems()).
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::swap(BinarySearchTree<Key, Value>& other) noexcept
+{
+    if (typeid(*this) == typeid(other))
+    {
+        swapTree(other);
+    }
+    else
+    {
+        exchangeItems(other);
+    }
+}
+
+/**
+* Throws invalid_argument unless other's dynamic type is exactly this
+* tree's. Each kind of tree allocates, frees and annotates its nodes its own
+* way, so nodes may only be cloned between trees of one kind.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::requireSameKind(const BinarySearchTree<Key, Value>& other) const
+{
+    if (typeid(*this) != typeid(other))
+    {
+        throw std::invalid_argument("cannot copy nodes between different kinds of tree");
+    }
+}
+
+/**
+* The O(1) exchange behind swap() and the moves. other is always the same
+* kind of tree as this one, so overrides can cast it down, swap their own
+* members and call this for the rest.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::swapTree(BinarySearchTree<Key, Value>& other) noexcept
+{
+    std::swap(root_, other.root_);
+    std::swap(finger_, other.finger_);
+    std::swap(fingerSearch_, other.fingerSearch_);
+}
+
+/**
+* swap() between two different kinds of tree: each side's items go into
+* the other through its own insert(), so both keep their invariants (and a
+* logging tree logs the change). O(n log n), and it allocates, so running
+* out of memory here ends the program like any other noexcept failure.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::exchangeItems(BinarySearchTree<Key, Value>& other) noexcept
+{
+    std::vector<std::pair<Key, Value> > mine;
+    std::vector<std::pair<Key, Value> > theirs;
+    collectItems(mine);
+    other.collectItems(theirs);
+    clear();
+    other.clear();
+    for (size_t i = 0; i < theirs.size(); ++i)
+    {
+        insert(theirs[i]);
+    }
+    for (size_t i = 0; i < mine.size(); ++i)
+    {
+        other.insert(mine[i]);
+    }
+}
+
+/**
+* Appends every item in key order, in a form insert() takes back. Trees
+* that hold more than the node pairs (several values per key) list it all.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::collectItems(std::vector<std::pair<Key, Value> >& out) const
+{
+    for (iterator it = begin(); it != end(); ++it)
+    {
+        out.push_back(std::make_pair(it->first, it->second));
+    }
+}
+
 /**
  * Returns true if tree is empty
 */
@@ -429,6 +714,70 @@ BinarySearchTree<Key, Value>::find(const Key & k) const
     return it;
 }
 
+/**
+* Returns an iterator to the first item whose key is not less than key, or
+* the end iterator if there is none. Together with operator++ this gives
+* ordered range scans in O(log n + k).
+*/
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::iterator
+BinarySearchTree<Key, Value>::lower_bound(const Key& key) const
+{
+    Node<Key, Value>* curr = root_;
+    Node<Key, Value>* best = NULL;
+    while (curr != NULL)
+    {
+        //curr is a candidate, but something smaller on its left might be too
+        if (curr->getKey() < key)
+        {
+            curr = curr->getRight();
+        }
+        else
+        {
+            best = curr;
+            curr = curr->getLeft();
+        }
+    }
+    return iterator(best);
+}
+
+/**
+* Removes the item pos points at and returns an iterator to the item after
+* it. No search is needed since pos already holds the node, and because
+* removal relinks nodes instead of moving items between them, iterators to
+* other items stay valid.
+* @precondition pos is a valid, dereferenceable iterator into this tree
+*/
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::iterator
+BinarySearchTree<Key, Value>::erase(iterator pos)
+{
+    Node<Key, Value>* next = successor(pos.current_);
+    removeNode(pos.current_);
+    return iterator(next);
+}
+
+/**
+* Removes the items in [first, last) and returns last. Each item is unlinked
+* straight from its node with no root-to-leaf searches; erasing everything
+* just clears the tree.
+*/
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::iterator
+BinarySearchTree<Key, Value>::erase(iterator first, iterator last)
+{
+    if (first == begin() && last == end())
+    {
+        clear();
+        return end();
+    }
+    while (first != last)
+    {
+        first = erase(first);
+    }
+    return last;
+}
+
 /**
  * @precondition The key exists in the map
  * Returns the value associated with the key
@@ -462,7 +811,7 @@ void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &key
     //if root is null, need to add one to start because there is nothing in this tree
     if (root_ == nullptr)
     {
-        root_ = new Node<Key, Value>(keyValuePair.first, keyValuePair.second, nullptr);
+        root_ = createNode(keyValuePair.first, keyValuePair.second, nullptr);
     }
 
     else
@@ -480,7 +829,7 @@ void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &key
                 //check if the left of my temp is null, bc then we'll put into my temp's left
                 if (temp->getLeft() == nullptr)
                 {
-                    Node<Key, Value>* baby = new Node<Key, Value>(keyValuePair.first, keyValuePair.second, temp);
+                    Node<Key, Value>* baby = createNode(keyValuePair.first, keyValuePair.second, temp);
                     temp->setLeft(baby);
                     inserted = true;
                 }
@@ -496,7 +845,7 @@ void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &key
                 //check if the Right of my temp is null/empty, bc then we'll put into my temp's Right
                 if (temp->getRight() == nullptr)
                 {
-                    Node<Key, Value>* baby = new Node<Key, Value>(keyValuePair.first, keyValuePair.second, temp);
+                    Node<Key, Value>* baby = createNode(keyValuePair.first, keyValuePair.second, temp);
                     temp->setRight(baby);
                     inserted = true;
                 }
@@ -536,15 +885,30 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
         return;
     }
 
-    //attempt to find the key in the tree
-    Node<Key, Value>* curr = this->internalFind(key);
+    //attempt to find the key in the tree, removeNode ignores a miss
+    removeNode(this->internalFind(key));
+}
 
+/**
+* Unlinks and frees curr, which must be a node of this tree (NULL is
+* ignored). remove() and erase() both end up here; the latter already
+* knows the node, so it skips the search.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::removeNode(Node<Key, Value>* curr)
+{
     //check to see if key not found in tree, so then can just return
     if (curr == nullptr)
     {
         return;
     }
 
+    //the finger must never point at a freed node
+    if (finger_ == curr)
+    {
+        finger_ = curr->getParent();
+    }
+
     //if has both children
     if (curr->getLeft() != nullptr && curr->getRight() != nullptr)
     {
@@ -632,18 +996,114 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
 
 		if (curr != root_)
 		{
-			delete curr;
+			destroyNode(curr);
 		}
 
 		else //is root, so need to null root so doesn't point to deleted dead pointer
 		{
-			delete curr;
+			destroyNode(curr);
 			root_ = nullptr;
 		}
 }
 
 
 
+/**
+* Allocates a node for insert(). Trees that need a richer node type
+* override this so the shared insertion code builds the right kind of node.
+*/
+template<class Key, class Value>
+Node<Key, Value>*
+BinarySearchTree<Key, Value>::createNode(const Key& key, const Value& value, Node<Key, Value>* parent)
+{
+    return new Node<Key, Value>(key, value, parent);
+}
+
+/**
+* Makes a copy of src (without its links) hanging off parent. Trees with a
+* richer node type override this so copies keep their extra per-node state.
+*/
+template<class Key, class Value>
+Node<Key, Value>*
+BinarySearchTree<Key, Value>::cloneNode(const Node<Key, Value>* src, Node<Key, Value>* parent) const
+{
+    return new Node<Key, Value>(src->getKey(), src->getValue(), parent);
+}
+
+/**
+* Clones other's nodes and settings into this (empty) tree in O(n), keeping
+* the exact shape so nothing needs re-inserting or rebalancing. Walks other
+* with an explicit stack so degenerate trees are fine.
+*
+* Every node comes from the virtual cloneNode(), which still resolves to the
+* base version while a base constructor runs. Subclass copy constructors
+* therefore default-construct their base and call this from their own body.
+*/
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::copyFrom(const BinarySearchTree<Key, Value>& other)
+{
+    root_ = nullptr;
+    finger_ = nullptr;
+    fingerSearch_ = other.fingerSearch_;
+    if (other.root_ == nullptr)
+    {
+        return;
+    }
+
+    //each entry is a source node plus where its copy has to be attached
+    struct Pending
+    {
+        const Node<Key, Value>* src;
+        Node<Key, Value>* parent;
+        bool isLeft;
+    };
+    std::vector<Pending> stack;
+    Pending first = { other.root_, nullptr, false };
+    stack.push_back(first);
+
+    while (!stack.empty())
+    {
+        Pending next = stack.back();
+        stack.pop_back();
+
+        Node<Key, Value>* copy = cloneNode(next.src, next.parent);
+        if (next.parent == nullptr)
+        {
+            root_ = copy;
+        }
+        else if (next.isLeft)
+        {
+            next.parent->setLeft(copy);
+        }
+        else
+        {
+            next.parent->setRight(copy);
+        }
+
+        if (next.src->getRight() != nullptr)
+        {
+            Pending right = { next.src->getRight(), copy, false };
+            stack.push_back(right);
+        }
+        if (next.src->getLeft() != nullptr)
+        {
+            Pending left = { next.src->getLeft(), copy, true };
+            stack.push_back(left);
+        }
+    }
+}
+
+/**
+* Gives derived trees the node an iterator points at (iterator only
+* befriends BinarySearchTree itself).
+*/
+template<class Key, class Value>
+Node<Key, Value>*
+BinarySearchTree<Key, Value>::nodeOf(const iterator& it)
+{
+    return it.current_;
+}
+
 template<class Key, class Value>
 Node<Key, Value>*
 BinarySearchTree<Key, Value>::predecessor(Node<Key, Value>* current)
@@ -740,32 +1200,251 @@ void BinarySearchTree<Key, Value>::clear()
 {
     // TODO
     helpClear(root_); 
+    finger_ = nullptr;
 }
 
+/**
+* Frees the subtree under curr without recursion or extra memory, so a
+* degenerate tree of any depth can be cleared (and destroyed). A node with a
+* left child is rotated right until it has none; then it goes to
+* destroyNode() and its right child is next. Every node is rotated past at
+* most once per ancestor on its left spine, O(n) in all.
+*/
 template<typename Key, typename Value>
 void BinarySearchTree<Key, Value>::helpClear(Node<Key, Value>* curr)
 {
-    // TODO
-    if (curr == nullptr)
+    if (curr == root_)
     {
+        root_ = nullptr;
+    }
+    while (curr != nullptr)
+    {
+        Node<Key, Value>* left = curr->getLeft();
+        if (left != nullptr)
+        {
+            curr->setLeft(left->getRight());
+            left->setRight(curr);
+            curr = left;
+        }
+        else
+        {
+            Node<Key, Value>* right = curr->getRight();
+            destroyNode(curr);
+            curr = right;
+        }
+    }
+}
+
+/**
+* Frees a node that is no longer linked into the tree. Every removal and
+* clear() goes through here, so trees whose nodes may still be seen by
+* concurrent readers can defer the free instead.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::destroyNode(Node<Key, Value>* node)
+{
+    delete node;
+}
+
+/**
+* Names what save() writes per node, so load() can refuse a file written
+* by a tree whose nodes mean something else: 'B' for key, value and shape.
+* Trees whose nodes hold state save() cannot write return 0, which makes
+* save() and load() fail even when called through a base reference.
+*/
+template<typename Key, typename Value>
+char BinarySearchTree<Key, Value>::saveKind() const
+{
+    return 'B';
+}
+
+/**
+* Balance factor save() stores for node. Plain trees have none, AVLTree
+* overrides this and restoreBalance() so load() needs no rebalancing.
+*/
+template<typename Key, typename Value>
+int8_t BinarySearchTree<Key, Value>::savedBalance(const Node<Key, Value>* node) const
+{
+    (void)node;
+    return 0;
+}
+
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::restoreBalance(Node<Key, Value>* node, int8_t balance)
+{
+    (void)node;
+    (void)balance;
+}
+
+/**
+* Called after the whole tree was relinked at once (load(), and
+* AVLTree::build_parallel()), for trees that keep per-subtree data.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::refreshAll()
+{
+
+}
+
+/*
+* save()/load() format: the magic "BSTSAV2\n", the saveKind() byte of the
+* tree that wrote it, then the nodes in preorder. Each node is one tag byte
+* followed by its key and value as written by the codecs. The low two bits
+* of the tag say whether a left and a right child follow, the next two hold
+* the balance factor plus one. An empty tree is the magic and the kind and
+* nothing else.
+*/
+static const char BST_SAVE_MAGIC[8] = { 'B', 'S', 'T', 'S', 'A', 'V', '2', '\n' };
+static const uint8_t BST_SAVE_LEFT = 1;
+static const uint8_t BST_SAVE_RIGHT = 2;
+static const int BST_SAVE_BALANCE_SHIFT = 2;
+
+/**
+* Writes the tree to out in its exact shape, in one preorder pass. The
+* stream reports any write error as usual; a tree that cannot be saved
+* (see saveKind()) writes nothing and sets failbit.
+*/
+template<typename Key, typename Value>
+template<class KeyCodec, class ValueCodec>
+void BinarySearchTree<Key, Value>::save(std::ostream& out) const
+{
+    char kind = saveKind();
+    if (kind == 0)
+    {
+        out.setstate(std::ios::failbit);
         return;
     }
-    helpClear(curr->getLeft());
-    helpClear(curr->getRight());
-    
-		//if isn't root, just delete
-		if (curr != root_)
-		{
-			delete curr;
-		}
+    CodecWriter writer(out);
+    writer.append(BST_SAVE_MAGIC, sizeof(BST_SAVE_MAGIC));
+    writer.append(&kind, 1);
 
-		else //is root, so need to also set root to null because otherwise will point to dead pointer
-		{
-			delete curr;
-			root_ = nullptr;
-		}
+    std::vector<const Node<Key, Value>*> stack;
+    if (root_ != nullptr)
+    {
+        stack.push_back(root_);
+    }
+    while (!stack.empty())
+    {
+        const Node<Key, Value>* curr = stack.back();
+        stack.pop_back();
+
+        uint8_t tag = (uint8_t)((savedBalance(curr) + 1) << BST_SAVE_BALANCE_SHIFT);
+        if (curr->getLeft() != nullptr)
+        {
+            tag |= BST_SAVE_LEFT;
+        }
+        if (curr->getRight() != nullptr)
+        {
+            tag |= BST_SAVE_RIGHT;
+        }
+        writer.append(&tag, 1);
+        KeyCodec::write(writer, curr->getKey());
+        ValueCodec::write(writer, curr->getValue());
+
+        //right first so the left subtree comes out next
+        if (curr->getRight() != nullptr)
+        {
+            stack.push_back(curr->getRight());
+        }
+        if (curr->getLeft() != nullptr)
+        {
+            stack.push_back(curr->getLeft());
+        }
+    }
 }
 
+/**
+* Replaces the contents of the tree with what save() wrote, rebuilding the
+* same shape (and balance factors) in one linear pass with no comparisons
+* or rotations. Returns false, leaving the tree empty and setting failbit
+* on in, if the data is truncated or malformed or was saved by a different
+* kind of tree. Keys are trusted to be in order, as save() wrote them.
+*/
+template<typename Key, typename Value>
+template<class KeyCodec, class ValueCodec>
+bool BinarySearchTree<Key, Value>::load(std::istream& in)
+{
+    clear();
+
+    CodecReader reader(in);
+    char magic[sizeof(BST_SAVE_MAGIC)];
+    char kind = 0;
+    if (!reader.read(magic, sizeof(magic)) || memcmp(magic, BST_SAVE_MAGIC, sizeof(magic)) != 0
+        || !reader.read(&kind, 1) || kind == 0 || kind != saveKind())
+    {
+        in.setstate(std::ios::failbit);
+        return false;
+    }
+
+    //each entry is a place a node still has to be read for
+    struct Slot
+    {
+        Node<Key, Value>* parent;
+        bool isLeft;
+    };
+    std::vector<Slot> stack;
+    Slot first = { nullptr, false };
+    stack.push_back(first);
+
+    //a stream that ends right after the kind is an empty tree
+    if (in.rdbuf()->sgetc() == std::char_traits<char>::eof())
+    {
+        return true;
+    }
+
+    Key key = Key();
+    Value value = Value();
+    while (!stack.empty())
+    {
+        Slot next = stack.back();
+        stack.pop_back();
+
+        uint8_t tag = 0;
+        int balance = 0;
+        bool ok = reader.read(&tag, 1);
+        if (ok)
+        {
+            balance = (tag >> BST_SAVE_BALANCE_SHIFT) - 1;
+            ok = balance <= 1 && (tag >> (BST_SAVE_BALANCE_SHIFT + 2)) == 0
+                && KeyCodec::read(reader, key) && ValueCodec::read(reader, value);
+        }
+        if (!ok)
+        {
+            clear();
+            in.setstate(std::ios::failbit);
+            return false;
+        }
+
+        Node<Key, Value>* node = createNode(key, value, next.parent);
+        restoreBalance(node, (int8_t)balance);
+        if (next.parent == nullptr)
+        {
+            root_ = node;
+        }
+        else if (next.isLeft)
+        {
+            next.parent->setLeft(node);
+        }
+        else
+        {
+            next.parent->setRight(node);
+        }
+
+        if (tag & BST_SAVE_RIGHT)
+        {
+            Slot right = { node, false };
+            stack.push_back(right);
+        }
+        if (tag & BST_SAVE_LEFT)
+        {
+            Slot left = { node, true };
+            stack.push_back(left);
+        }
+    }
+
+    refreshAll();
+    return true;
+}
 
 /**
 * A helper function to find the smallest node in the tree.
@@ -799,6 +1478,11 @@ template<typename Key, typename Value>
 Node<Key, Value>* BinarySearchTree<Key, Value>::internalFind(const Key& key) const
 {
     // TODO
+    if (fingerSearch_)
+    {
+        return fingerFind(key);
+    }
+
     Node<Key, Value>* curr = root_;
 		
     //go through and do binary search
@@ -823,140 +1507,110 @@ Node<Key, Value>* BinarySearchTree<Key, Value>::internalFind(const Key& key) con
 }
 
 /**
- * Return true iff the BST is balanced.
- */
+* Turns finger search on or off. With it on, every lookup starts from the
+* node the previous lookup ended on and only climbs (using the parent
+* pointers) as far as needed before descending again, so a key d positions
+* away from the last one costs O(log d) on a balanced tree instead of
+* O(log n).
+*
+* The finger moves on const lookups too (find() and the const operator[]),
+* so with it on even two readers race on it. Leave it off for a tree that
+* several threads read at once, unless they hold a lock around every
+* lookup.
+*/
 template<typename Key, typename Value>
-bool BinarySearchTree<Key, Value>::isBalanced() const
+void BinarySearchTree<Key, Value>::setFingerSearch(bool enabled)
 {
-    //return whether differ by at most one
-	//use and because has to be in range of 1 and negative 1
-  int height  = calculateHeightIfBalanced(root_);
-	return (height != -1);
-    
+    fingerSearch_ = enabled;
+    finger_ = nullptr;
 }
 
+/**
+* internalFind() starting from finger_ instead of root_. Leaves finger_ on
+* the last node visited, hit or miss.
+*/
 template<typename Key, typename Value>
-/// Calculates the height of the tree if it is balanced. Otherwise returns -1.
-int BinarySearchTree<Key, Value>::calculateHeightIfBalanced(Node<Key, Value>* root) const {
-	// Base case: an empty tree is always balanced and has a height of 0
-	if (root == nullptr) return 0;
-
-	//either way, need to get height of either subtree
-	//add one to call to increase heigher since base case returns 0;
-	int lefth = calculateHeightIfBalanced(root->getLeft());
-	int righth = calculateHeightIfBalanced(root->getRight());
-
-	//handles possible edge case weirdness where get 0 and negative 1
-	if  ((lefth == -1  || righth == -1))
-	{
-		return -1;
-	}
-
-    //check if is balanced so can calc height, and then do it
-	else if (abs(lefth-righth) <= 1)
-	{
-		if (lefth > righth)
-		{
-			return lefth + 1;
-		}
-		else
-		{
-			return righth + 1;
-		}
-	}
-	else
-	{
-		return -1;
-	}
-
-}
-
-
-
-
-
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2)
+Node<Key, Value>* BinarySearchTree<Key, Value>::fingerFind(const Key& key) const
 {
-    if((n1 == n2) || (n1 == NULL) || (n2 == NULL) ) {
-        return;
+    Node<Key, Value>* curr = (finger_ != nullptr) ? finger_ : root_;
+    if (curr == nullptr)
+    {
+        return nullptr;
     }
-    Node<Key, Value>* n1p = n1->getParent();
-    Node<Key, Value>* n1r = n1->getRight();
-    Node<Key, Value>* n1lt = n1->getLeft();
-    bool n1isLeft = false;
-    if(n1p != NULL && (n1 == n1p->getLeft())) n1isLeft = true;
-    Node<Key, Value>* n2p = n2->getParent();
-    Node<Key, Value>* n2r = n2->getRight();
-    Node<Key, Value>* n2lt = n2->getLeft();
-    bool n2isLeft = false;
-    if(n2p != NULL && (n2 == n2p->getLeft())) n2isLeft = true;
-
-
-    Node<Key, Value>* temp;
-    temp = n1->getParent();
-    n1->setParent(n2->getParent());
-    n2->setParent(temp);
-
-    temp = n1->getLeft();
-    n1->setLeft(n2->getLeft());
-    n2->setLeft(temp);
-
-    temp = n1->getRight();
-    n1->setRight(n2->getRight());
-    n2->setRight(temp);
 
-    if( (n1r != NULL && n1r == n2) ) {
-        n2->setRight(n1);
-        n1->setParent(n2);
+    //climb until curr's subtree covers key. One side is already covered since
+    //the finger is on it, so only the bound on the other side has to be found
+    if (curr->getKey() < key)
+    {
+        //stop below the first ancestor we are left of that is bigger than key
+        while (curr->getParent() != nullptr)
+        {
+            Node<Key, Value>* parent = curr->getParent();
+            if (parent->getLeft() == curr && key < parent->getKey())
+            {
+                break;
+            }
+            curr = parent;
+        }
     }
-    else if( n2r != NULL && n2r == n1) {
-        n1->setRight(n2);
-        n2->setParent(n1);
-
+    else if (key < curr->getKey())
+    {
+        //stop below the first ancestor we are right of that is smaller than key
+        while (curr->getParent() != nullptr)
+        {
+            Node<Key, Value>* parent = curr->getParent();
+            if (parent->getRight() == curr && parent->getKey() < key)
+            {
+                break;
+            }
+            curr = parent;
+        }
     }
-    else if( n1lt != NULL && n1lt == n2) {
-        n2->setLeft(n1);
-        n1->setParent(n2);
 
-    }
-    else if( n2lt != NULL && n2lt == n1) {
-        n1->setLeft(n2);
-        n2->setParent(n1);
+    //then an ordinary descent from there
+    while (true)
+    {
+        finger_ = curr;
+        Node<Key, Value>* next;
+        if (key < curr->getKey())
+        {
+            next = curr->getLeft();
+        }
+        else if (curr->getKey() < key)
+        {
+            next = curr->getRight();
+        }
+        else
+        {
+            return curr;
+        }
 
+        if (next == nullptr)
+        {
+            return nullptr;
+        }
+        curr = next;
     }
+}
 
+/**
+ * Return true iff the BST is balanced.
+ */
+template<typename Key, typename Value>
+bool BinarySearchTree<Key, Value>::isBalanced() const
+{
+    //single non-recursive pass, so a degenerate tree cannot blow the stack
+    return measureShape(root_, SHAPE_BALANCED).balanced;
+}
 
-    if(n1p != NULL && n1p != n2) {
-        if(n1isLeft) n1p->setLeft(n2);
-        else n1p->setRight(n2);
-    }
-    if(n1r != NULL && n1r != n2) {
-        n1r->setParent(n2);
-    }
-    if(n1lt != NULL && n1lt != n2) {
-        n1lt->setParent(n2);
-    }
 
-    if(n2p != NULL && n2p != n1) {
-        if(n2isLeft) n2p->setLeft(n1);
-        else n2p->setRight(n1);
-    }
-    if(n2r != NULL && n2r != n1) {
-        n2r->setParent(n1);
-    }
-    if(n2lt != NULL && n2lt != n1) {
-        n2lt->setParent(n1);
-    }
 
 
-    if(this->root_ == n1) {
-        this->root_ = n2;
-    }
-    else if(this->root_ == n2) {
-        this->root_ = n1;
-    }
 
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2)
+{
+    swapNodeLinks(n1, n2, root_);
 }
 
 /**
@@ -968,6 +1622,9 @@ void BinarySearchTree<Key, Value>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value
    It will print up to 5 levels of the tree rooted at the passed node,
    in ASCII graphics format.
    We hope it will make debugging easier!
+
+   For trees too big for that, tree-export.h writes the whole tree
+   as DOT or JSON to any stream.
   */
 
 // include print function (in its own file because it's fairly long)
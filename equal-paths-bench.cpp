@@ -0,0 +1,69 @@
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include "equal-paths.h"
+#include "equal-paths-fast.h"
+using namespace std;
+
+// Times the equalPaths variants on a perfect tree (every leaf at the same
+// depth, so nothing can exit early) and on a fully skewed chain, which the
+// recursive PathFinder cannot handle without overflowing the stack.
+//
+// usage: ./equal-paths-bench [levels=24] [threads=0 (all cores)]
+
+template<typename Func>
+double timeIt(const char* label, Func f)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    bool result = f();
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cout << "  " << label << ": " << result << " in " << ms << " ms" << endl;
+    return ms;
+}
+
+int main(int argc, char* argv[])
+{
+    int levels = (argc > 1) ? atoi(argv[1]) : 24;
+    unsigned threads = (argc > 2) ? (unsigned)atoi(argv[2]) : 0;
+
+    // perfect tree laid out in heap order: children of i are 2i+1 and 2i+2
+    size_t count = (((size_t)1) << levels) - 1;
+    vector<Node> perfect(count, Node(0));
+    for (size_t i = 0; i < count; ++i)
+    {
+        perfect[i].key = (int)i;
+        if (2 * i + 2 < count)
+        {
+            perfect[i].left = &perfect[2 * i + 1];
+            perfect[i].right = &perfect[2 * i + 2];
+        }
+    }
+
+    cout << "Perfect tree, " << count << " nodes:" << endl;
+    timeIt("recursive ", [&]() { int maxPath = -1; return PathFinder(&perfect[0], maxPath, 0); });
+    timeIt("iterative ", [&]() { return equalPathsIterative(&perfect[0]); });
+    timeIt("parallel  ", [&]() { return equalPathsParallel(&perfect[0], threads); });
+
+    // make one leaf one level shallower, so the mismatch is found early
+    perfect[1].left = nullptr;
+    perfect[1].right = nullptr;
+    cout << "Perfect tree with one short path:" << endl;
+    timeIt("iterative ", [&]() { return equalPathsIterative(&perfect[0]); });
+    timeIt("parallel  ", [&]() { return equalPathsParallel(&perfect[0], threads); });
+    perfect.clear();
+    perfect.shrink_to_fit();
+
+    // fully skewed chain, as deep as the perfect tree was big
+    vector<Node> chain(count, Node(0));
+    for (size_t i = 0; i + 1 < count; ++i)
+    {
+        chain[i].key = (int)i;
+        chain[i].right = &chain[i + 1];
+    }
+    cout << "Skewed chain, " << count << " nodes:" << endl;
+    timeIt("iterative ", [&]() { return equalPathsIterative(&chain[0]); });
+    timeIt("parallel  ", [&]() { return equalPathsParallel(&chain[0], threads); });
+
+    return 0;
+}
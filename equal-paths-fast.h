@@ -0,0 +1,234 @@
+#ifndef EQUAL_PATHS_FAST_H
+#define EQUAL_PATHS_FAST_H
+
+#include <atomic>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "tree-walk.h"
+
+/**
+ * Stack-safe and multi-threaded versions of equalPaths().
+ *
+ * Both templates accept any node type tree-walk.h knows how to walk:
+ * the Node struct from equal-paths.h as well as Node/AVLNode from
+ * bst.h/avlbst.h. A leaf is a node with no children, and the tree has
+ * equal paths when every leaf sits at the same depth (an empty tree
+ * trivially does).
+ */
+
+/**
+ * Leaf depth bookkeeping for a single thread: the first leaf fixes the
+ * target and every later leaf has to match it.
+ */
+struct LocalLeafDepth
+{
+    LocalLeafDepth() : target(-1) {}
+
+    bool accept(int depth)
+    {
+        if (target == -1)
+        {
+            target = depth;
+        }
+        return target == depth;
+    }
+
+    bool abandoned() const
+    {
+        return false;
+    }
+
+    int target;
+};
+
+/**
+ * Leaf depth bookkeeping shared by the worker threads of
+ * equalPathsParallel(). Whichever worker reaches a leaf first publishes its
+ * depth, and the first mismatch raises failed so the others stop early.
+ */
+struct SharedLeafDepth
+{
+    SharedLeafDepth() : target(-1), failed(false) {}
+
+    bool accept(int depth)
+    {
+        int expected = -1;
+        //either we publish our depth or we learn the one somebody else published
+        if (!target.compare_exchange_strong(expected, depth, std::memory_order_relaxed)
+            && expected != depth)
+        {
+            failed.store(true, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    bool abandoned() const
+    {
+        return failed.load(std::memory_order_relaxed);
+    }
+
+    std::atomic<int> target;
+    std::atomic<bool> failed;
+};
+
+/**
+ * Walks the subtree at root (which sits at rootDepth) with an explicit
+ * stack, handing every leaf depth to leafDepth. Returns false as soon as a
+ * leaf does not match, or when another thread has already found one.
+ */
+template<typename NodeT, typename LeafDepth>
+bool walkLeafDepths(NodeT* root, int rootDepth, LeafDepth& leafDepth)
+{
+    if (root == nullptr)
+    {
+        return true;
+    }
+
+    std::vector<std::pair<NodeT*, int> > stack;
+    stack.push_back(std::make_pair(root, rootDepth));
+
+    //how many nodes to visit between checks of the shared failure flag
+    const unsigned POLL_INTERVAL = 4096;
+    unsigned untilPoll = POLL_INTERVAL;
+
+    while (!stack.empty())
+    {
+        NodeT* curr = stack.back().first;
+        int depth = stack.back().second;
+        stack.pop_back();
+
+        NodeT* left = walkLeft(curr);
+        NodeT* right = walkRight(curr);
+
+        if (left == nullptr && right == nullptr)
+        {
+            if (!leafDepth.accept(depth))
+            {
+                return false;
+            }
+        }
+
+        //push right first so the left side is explored first, like the recursive version
+        if (right != nullptr)
+        {
+            stack.push_back(std::make_pair(right, depth + 1));
+        }
+        if (left != nullptr)
+        {
+            stack.push_back(std::make_pair(left, depth + 1));
+        }
+
+        if (--untilPoll == 0)
+        {
+            untilPoll = POLL_INTERVAL;
+            if (leafDepth.abandoned())
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Iterative equalPaths(): uses heap memory proportional to the tree height
+ * instead of call stack, so skewed trees cannot overflow the stack, and
+ * returns on the first leaf whose depth differs from the first one seen.
+ */
+template<typename NodeT>
+bool equalPathsIterative(NodeT* root)
+{
+    LocalLeafDepth leafDepth;
+    return walkLeafDepths(root, 0, leafDepth);
+}
+
+/**
+ * Multi-threaded equalPaths(). The top of the tree is expanded breadth first
+ * until there are a few independent subtrees per thread; those subtrees are
+ * then checked by the workers, which share the expected leaf depth through
+ * an atomic. Small trees, or threads <= 1, fall back to equalPathsIterative().
+ *
+ * @param threads number of threads to use, 0 meaning one per hardware thread
+ */
+template<typename NodeT>
+bool equalPathsParallel(NodeT* root, unsigned threads = 0)
+{
+    if (threads == 0)
+    {
+        threads = std::thread::hardware_concurrency();
+    }
+    if (threads <= 1 || root == nullptr)
+    {
+        return equalPathsIterative(root);
+    }
+
+    SharedLeafDepth leafDepth;
+
+    //expand the frontier level by level until every thread has a few subtrees to chew on
+    const size_t wantedSubtrees = threads * 4;
+    std::vector<std::pair<NodeT*, int> > frontier;
+    frontier.push_back(std::make_pair(root, 0));
+    while (frontier.size() < wantedSubtrees)
+    {
+        std::vector<std::pair<NodeT*, int> > next;
+        bool grew = false;
+        for (size_t i = 0; i < frontier.size(); ++i)
+        {
+            NodeT* curr = frontier[i].first;
+            int depth = frontier[i].second;
+            NodeT* left = walkLeft(curr);
+            NodeT* right = walkRight(curr);
+
+            //leaves found while expanding are checked right here
+            if (left == nullptr && right == nullptr)
+            {
+                if (!leafDepth.accept(depth))
+                {
+                    return false;
+                }
+                continue;
+            }
+            if (left != nullptr)
+            {
+                next.push_back(std::make_pair(left, depth + 1));
+            }
+            if (right != nullptr)
+            {
+                next.push_back(std::make_pair(right, depth + 1));
+            }
+            grew = true;
+        }
+        frontier.swap(next);
+        if (!grew || frontier.empty())
+        {
+            return true;
+        }
+    }
+
+    //workers claim subtrees one at a time so a big subtree does not hold up the rest
+    std::atomic<size_t> nextSubtree(0);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t)
+    {
+        workers.push_back(std::thread([&]() {
+            size_t i;
+            while ((i = nextSubtree.fetch_add(1)) < frontier.size() && !leafDepth.abandoned())
+            {
+                if (!walkLeafDepths(frontier[i].first, frontier[i].second, leafDepth))
+                {
+                    return;
+                }
+            }
+        }));
+    }
+    for (size_t t = 0; t < workers.size(); ++t)
+    {
+        workers[t].join();
+    }
+
+    return !leafDepth.abandoned();
+}
+
+#endif
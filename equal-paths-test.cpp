@@ -1,6 +1,7 @@
 #include <iostream>
 #include <cstdlib>
 #include "equal-paths.h"
+#include "equal-paths-fast.h"
 using namespace std;
 
 
@@ -55,6 +56,15 @@ void test5(const char* msg)
   cout << msg << ": " <<   equalPaths(a) << endl;
 }
 
+void test6(const char* msg)
+{
+  setNode(a,1,b,c);
+  setNode(b,2,d,NULL);
+  setNode(c,3,NULL,NULL);
+  setNode(d,4,NULL,NULL);
+  cout << msg << ": " <<   equalPathsParallel(a, 2) << " " << equalPathsIterative(a) << endl;
+}
+
 int main()
 {
   a = new Node(1);
@@ -67,6 +77,7 @@ int main()
   test3("Test3");
   test4("Test4");
   test5("Test5");
+  test6("Test6");
  
   delete a;
   delete b;
@@ -1,8 +1,8 @@
 #include "equal-paths.h"
-#include <algorithm>
-using namespace std;
+#include "equal-paths-fast.h"
 
 
+//the recursive walk equalPaths() used before it went iterative, kept for equal-paths-bench to time against
 bool PathFinder(Node* root, int& maxLength, int currLength)
 {
     //base case, if get past leaf node, then is true by default as both leaves do not exist and is thus trivially equalpaths for this node onward
@@ -43,8 +43,7 @@ bool PathFinder(Node* root, int& maxLength, int currLength)
 
 bool equalPaths(Node * root)
 {
-    int maxPath = -1;
-    int value = 0;
-    return PathFinder(root, maxPath, value);
+    //iterative walk so deep or skewed trees cannot overflow the call stack
+    return equalPathsIterative(root);
 }
 
@@ -0,0 +1,235 @@
+#ifndef INTERVAL_TREE_H
+#define INTERVAL_TREE_H
+
+#include <iostream>
+#include <limits>
+#include <utility>
+#include <vector>
+#include "avl-augmented.h"
+
+/**
+* Half-open interval [start, end) used as the key of an IntervalTree.
+* Intervals order by start, then by end.
+*/
+template <typename T>
+struct Interval
+{
+    Interval() :
+        start(), end()
+    {}
+
+    Interval(const T& start, const T& end) :
+        start(start), end(end)
+    {}
+
+    T start;
+    T end;
+};
+
+template <typename T>
+bool operator<(const Interval<T>& a, const Interval<T>& b)
+{
+    return (a.start < b.start) || (!(b.start < a.start) && a.end < b.end);
+}
+
+template <typename T>
+bool operator>(const Interval<T>& a, const Interval<T>& b)
+{
+    return b < a;
+}
+
+template <typename T>
+bool operator==(const Interval<T>& a, const Interval<T>& b)
+{
+    return !(a < b) && !(b < a);
+}
+
+template <typename T>
+std::ostream& operator<<(std::ostream& out, const Interval<T>& iv)
+{
+    return out << '[' << iv.start << ", " << iv.end << ')';
+}
+
+/**
+* AugmentedAVLTree policy for IntervalTree: the largest end in a subtree.
+* Only the keys count, so values can change freely. The queries never need
+* identity(), which is T() for a T without numeric_limits.
+*/
+template <typename T>
+struct MaxEndAggregate
+{
+    typedef T type;
+    static type identity() { return std::numeric_limits<T>::lowest(); }
+    template<class V>
+    static type lift(const Interval<T>& key, const V&) { return key.end; }
+    static type combine(const type& a, const type& b) { return (a < b) ? b : a; }
+};
+
+/**
+* An AVLTree keyed by half-open intervals [start, end), ordered by start
+* (ties broken by end, so several intervals may share a start). It is an
+* AugmentedAVLTree whose aggregate is the largest end in each subtree, which
+* lets stab() and overlap() skip whole subtrees that end too early and stop
+* once starts pass the query.
+*
+* Both queries visit matches in key order through a callback taking the
+* node's std::pair<const Interval<T>, Value>&. They cost O(log n + k)
+* when the k matches are clustered, O(log n + k log(n/k)) at worst.
+* T only needs operator<.
+*/
+template <class T, class Value>
+class IntervalTree : public AugmentedAVLTree<Interval<T>, Value, MaxEndAggregate<T> >
+{
+public:
+    IntervalTree();
+    IntervalTree(const IntervalTree& other);
+    IntervalTree(IntervalTree&& other) noexcept;
+    IntervalTree& operator=(const IntervalTree& other);
+    IntervalTree& operator=(IntervalTree&& other) noexcept;
+    void swap(IntervalTree& other) noexcept;
+
+    using AugmentedAVLTree<Interval<T>, Value, MaxEndAggregate<T> >::insert;
+    using AugmentedAVLTree<Interval<T>, Value, MaxEndAggregate<T> >::remove;
+    void insert(const T& start, const T& end, const Value& value);
+    void remove(const T& start, const T& end);
+
+    template<class Visit>
+    void stab(const T& point, Visit visit) const;
+    template<class Visit>
+    void overlap(const T& lo, const T& hi, Visit visit) const;
+
+protected:
+    typedef AugmentedAVLNode<Interval<T>, Value, MaxEndAggregate<T> > INode;
+
+    template<class Visit>
+    void query(const T& lo, const T& hi, bool stabbing, Visit& visit) const;
+};
+
+template<class T, class Value>
+IntervalTree<T, Value>::IntervalTree() :
+    AugmentedAVLTree<Interval<T>, Value, MaxEndAggregate<T> >()
+{
+
+}
+
+template<class T, class Value>
+IntervalTree<T, Value>::IntervalTree(const IntervalTree<T, Value>& other) :
+    AugmentedAVLTree<Interval<T>, Value, MaxEndAggregate<T> >()
+{
+    this->copyFrom(other);
+}
+
+template<class T, class Value>
+IntervalTree<T, Value>::IntervalTree(IntervalTree<T, Value>&& other) noexcept :
+    AugmentedAVLTree<Interval<T>, Value, MaxEndAggregate<T> >()
+{
+    swap(other);
+}
+
+template<class T, class Value>
+IntervalTree<T, Value>& IntervalTree<T, Value>::operator=(const IntervalTree<T, Value>& other)
+{
+    BinarySearchTree<Interval<T>, Value>::operator=(other);
+    return *this;
+}
+
+template<class T, class Value>
+IntervalTree<T, Value>& IntervalTree<T, Value>::operator=(IntervalTree<T, Value>&& other) noexcept
+{
+    if (this != &other)
+    {
+        this->clear();
+        swap(other);
+    }
+    return *this;
+}
+
+template<class T, class Value>
+void IntervalTree<T, Value>::swap(IntervalTree<T, Value>& other) noexcept
+{
+    this->swapTree(other);
+}
+
+/**
+* Adds [start, end) with value, overwriting the value if that exact
+* interval is already stored.
+*/
+template<class T, class Value>
+void IntervalTree<T, Value>::insert(const T& start, const T& end, const Value& value)
+{
+    this->insert(std::make_pair(Interval<T>(start, end), value));
+}
+
+template<class T, class Value>
+void IntervalTree<T, Value>::remove(const T& start, const T& end)
+{
+    this->remove(Interval<T>(start, end));
+}
+
+/**
+* Calls visit on every interval with start <= point < end.
+*/
+template<class T, class Value>
+template<class Visit>
+void IntervalTree<T, Value>::stab(const T& point, Visit visit) const
+{
+    query(point, point, true, visit);
+}
+
+/**
+* Calls visit on every interval sharing at least one point with [lo, hi).
+* Nothing matches when lo is not less than hi.
+*/
+template<class T, class Value>
+template<class Visit>
+void IntervalTree<T, Value>::overlap(const T& lo, const T& hi, Visit visit) const
+{
+    if (!(lo < hi))
+    {
+        return;
+    }
+    query(lo, hi, false, visit);
+}
+
+/**
+* In-order walk shared by stab() and overlap(). A subtree whose largest end
+* is <= lo holds nothing that reaches lo, so it is not entered; once a start
+* is past hi (or >= hi for a half-open query) every later one is too, and
+* the walk stops.
+*/
+template<class T, class Value>
+template<class Visit>
+void IntervalTree<T, Value>::query(const T& lo, const T& hi, bool stabbing, Visit& visit) const
+{
+    std::vector<INode*> stack;
+    INode* curr = static_cast<INode*>(this->root_);
+    while (curr != nullptr || !stack.empty())
+    {
+        //go as far left as there is anything ending after lo
+        while (curr != nullptr && lo < curr->getAggregate())
+        {
+            stack.push_back(curr);
+            curr = static_cast<INode*>(curr->getLeft());
+        }
+        if (stack.empty())
+        {
+            break;
+        }
+
+        INode* n = stack.back();
+        stack.pop_back();
+        const Interval<T>& iv = n->getKey();
+        bool pastEnd = stabbing ? (hi < iv.start) : !(iv.start < hi);
+        if (pastEnd)
+        {
+            break;
+        }
+        if (lo < iv.end)
+        {
+            visit(n->getItem());
+        }
+        curr = static_cast<INode*>(n->getRight());
+    }
+}
+
+#endif
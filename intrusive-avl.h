@@ -0,0 +1,527 @@
+#ifndef INTRUSIVE_AVL_H
+#define INTRUSIVE_AVL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include "avlbst.h"
+
+/**
+* Tag used by AVLHook and IntrusiveAVLTree when an object only ever needs
+* to be in one tree at a time.
+*/
+struct DefaultAVLTag { };
+
+/**
+* The links and balance factor of an intrusive AVL tree, embedded in the
+* user's own type by deriving from it:
+*
+*   struct Job : AVLHook<ByPriority>, AVLHook<ByDeadline> { ... };
+*
+* Each distinct Tag is a separate hook, so an object can be linked into as
+* many trees as it has hooks. The hook does not own anything and copying an
+* object does not copy its tree membership: a copied hook starts unlinked.
+*/
+template <class Tag = DefaultAVLTag>
+class AVLHook
+{
+public:
+    AVLHook();
+    AVLHook(const AVLHook& other);
+    AVLHook& operator=(const AVLHook& other);
+
+    AVLHook* getParent() const;
+    AVLHook* getLeft() const;
+    AVLHook* getRight() const;
+    void setParent(AVLHook* parent);
+    void setLeft(AVLHook* left);
+    void setRight(AVLHook* right);
+
+    int8_t getBalance () const;
+    void setBalance (int8_t balance);
+    void updateBalance(int8_t diff);
+
+    void resetHook();
+
+protected:
+    AVLHook* parent_;
+    AVLHook* left_;
+    AVLHook* right_;
+    int8_t balance_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the AVLHook class.
+  -------------------------------------------------
+*/
+
+template<class Tag>
+AVLHook<Tag>::AVLHook() :
+    parent_(nullptr), left_(nullptr), right_(nullptr), balance_(0)
+{
+
+}
+
+/**
+* The copy starts out in no tree, whatever other is linked into.
+*/
+template<class Tag>
+AVLHook<Tag>::AVLHook(const AVLHook<Tag>& other) :
+    parent_(nullptr), left_(nullptr), right_(nullptr), balance_(0)
+{
+
+}
+
+/**
+* Assigning objects leaves the target's own tree membership alone.
+*/
+template<class Tag>
+AVLHook<Tag>& AVLHook<Tag>::operator=(const AVLHook<Tag>& other)
+{
+    return *this;
+}
+
+template<class Tag>
+AVLHook<Tag>* AVLHook<Tag>::getParent() const
+{
+    return parent_;
+}
+
+template<class Tag>
+AVLHook<Tag>* AVLHook<Tag>::getLeft() const
+{
+    return left_;
+}
+
+template<class Tag>
+AVLHook<Tag>* AVLHook<Tag>::getRight() const
+{
+    return right_;
+}
+
+template<class Tag>
+void AVLHook<Tag>::setParent(AVLHook<Tag>* parent)
+{
+    parent_ = parent;
+}
+
+template<class Tag>
+void AVLHook<Tag>::setLeft(AVLHook<Tag>* left)
+{
+    left_ = left;
+}
+
+template<class Tag>
+void AVLHook<Tag>::setRight(AVLHook<Tag>* right)
+{
+    right_ = right;
+}
+
+template<class Tag>
+int8_t AVLHook<Tag>::getBalance() const
+{
+    return balance_;
+}
+
+template<class Tag>
+void AVLHook<Tag>::setBalance(int8_t balance)
+{
+    balance_ = balance;
+}
+
+template<class Tag>
+void AVLHook<Tag>::updateBalance(int8_t diff)
+{
+    balance_ += diff;
+}
+
+/**
+* Puts the hook back in its unlinked state.
+*/
+template<class Tag>
+void AVLHook<Tag>::resetHook()
+{
+    parent_ = left_ = right_ = nullptr;
+    balance_ = 0;
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the AVLHook class.
+  -----------------------------------------------
+*/
+
+/**
+* An AVL tree that links objects the caller already owns instead of
+* allocating nodes: T must derive from AVLHook<Tag>, and KeyOf is a
+* function object giving the key of a const T&. insert() and remove() never
+* allocate or copy, and remove() needs no search since the object is its
+* own node. Rebalancing is shared with AVLTree through AVLAlgo.
+*
+* Keys are unique within one tree. Objects must stay alive (and their keys
+* unchanged) while linked; destroying the tree unlinks whatever is left.
+*/
+template <class T, class KeyOf, class Tag = DefaultAVLTag>
+class IntrusiveAVLTree
+{
+public:
+    typedef AVLHook<Tag> Hook;
+
+    /**
+    * In-order iterator over the linked objects.
+    */
+    class iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef T* pointer;
+        typedef T& reference;
+
+        iterator();
+
+        T& operator*() const;
+        T* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class IntrusiveAVLTree<T, KeyOf, Tag>;
+        explicit iterator(Hook* ptr);
+        Hook* current_;
+    };
+
+    explicit IntrusiveAVLTree(const KeyOf& keyOf = KeyOf());
+    ~IntrusiveAVLTree();
+
+    // Membership belongs to the objects, so trees are not copyable.
+    IntrusiveAVLTree(const IntrusiveAVLTree&) = delete;
+    IntrusiveAVLTree& operator=(const IntrusiveAVLTree&) = delete;
+
+    bool insert(T& obj);
+    void remove(T& obj);
+    template<class K>
+    T* find(const K& key) const;
+    void clear();
+
+    bool empty() const;
+    size_t size() const;
+
+    iterator begin() const;
+    iterator end() const;
+    iterator iteratorTo(T& obj) const;
+
+protected:
+    static T* objectOf(Hook* h);
+    static Hook* hookOf(T& obj);
+
+    // Used by AVLAlgo during rebalancing
+    void rotateLeft(Hook* n);
+    void rotateRight(Hook* n);
+    void nodeSwap(Hook* n1, Hook* n2);
+    friend struct AVLAlgo;
+
+    Hook* root_;
+    size_t size_;
+    KeyOf keyOf_;
+};
+
+/*
+------------------------------------------------------------
+Begin implementations for the IntrusiveAVLTree::iterator class.
+------------------------------------------------------------
+*/
+
+template<class T, class KeyOf, class Tag>
+IntrusiveAVLTree<T, KeyOf, Tag>::iterator::iterator() :
+    current_(nullptr)
+{
+
+}
+
+template<class T, class KeyOf, class Tag>
+IntrusiveAVLTree<T, KeyOf, Tag>::iterator::iterator(Hook* ptr) :
+    current_(ptr)
+{
+
+}
+
+template<class T, class KeyOf, class Tag>
+T& IntrusiveAVLTree<T, KeyOf, Tag>::iterator::operator*() const
+{
+    return *objectOf(current_);
+}
+
+template<class T, class KeyOf, class Tag>
+T* IntrusiveAVLTree<T, KeyOf, Tag>::iterator::operator->() const
+{
+    return objectOf(current_);
+}
+
+template<class T, class KeyOf, class Tag>
+bool IntrusiveAVLTree<T, KeyOf, Tag>::iterator::operator==(const iterator& rhs) const
+{
+    return current_ == rhs.current_;
+}
+
+template<class T, class KeyOf, class Tag>
+bool IntrusiveAVLTree<T, KeyOf, Tag>::iterator::operator!=(const iterator& rhs) const
+{
+    return current_ != rhs.current_;
+}
+
+/**
+* Steps to the in-order successor using the parent links.
+*/
+template<class T, class KeyOf, class Tag>
+typename IntrusiveAVLTree<T, KeyOf, Tag>::iterator&
+IntrusiveAVLTree<T, KeyOf, Tag>::iterator::operator++()
+{
+    if (current_->getRight() != nullptr)
+    {
+        current_ = current_->getRight();
+        while (current_->getLeft() != nullptr)
+        {
+            current_ = current_->getLeft();
+        }
+        return *this;
+    }
+
+    //go up until we come from a left subtree
+    Hook* child = current_;
+    current_ = current_->getParent();
+    while (current_ != nullptr && current_->getRight() == child)
+    {
+        child = current_;
+        current_ = current_->getParent();
+    }
+    return *this;
+}
+
+/*
+----------------------------------------------------------
+End implementations for the IntrusiveAVLTree::iterator class.
+----------------------------------------------------------
+*/
+
+template<class T, class KeyOf, class Tag>
+IntrusiveAVLTree<T, KeyOf, Tag>::IntrusiveAVLTree(const KeyOf& keyOf) :
+    root_(nullptr), size_(0), keyOf_(keyOf)
+{
+
+}
+
+template<class T, class KeyOf, class Tag>
+IntrusiveAVLTree<T, KeyOf, Tag>::~IntrusiveAVLTree()
+{
+    clear();
+}
+
+/**
+* Links obj into the tree. Returns false, leaving obj unlinked, if an
+* object with the same key is already in the tree.
+* @precondition obj's hook for Tag is not linked into any tree
+*/
+template<class T, class KeyOf, class Tag>
+bool IntrusiveAVLTree<T, KeyOf, Tag>::insert(T& obj)
+{
+    Hook* n = hookOf(obj);
+    n->resetHook();
+
+    if (root_ == nullptr)
+    {
+        root_ = n;
+        ++size_;
+        return true;
+    }
+
+    Hook* temp = root_;
+    while (true)
+    {
+        if (keyOf_(obj) < keyOf_(*objectOf(temp)))
+        {
+            if (temp->getLeft() == nullptr)
+            {
+                AVLAlgo::linkLeaf(*this, temp, n, true);
+                break;
+            }
+            temp = temp->getLeft();
+        }
+        else if (keyOf_(*objectOf(temp)) < keyOf_(obj))
+        {
+            if (temp->getRight() == nullptr)
+            {
+                AVLAlgo::linkLeaf(*this, temp, n, false);
+                break;
+            }
+            temp = temp->getRight();
+        }
+        else
+        {
+            return false;
+        }
+    }
+    ++size_;
+    return true;
+}
+
+/**
+* Unlinks obj in O(log n) without searching for its key.
+* @precondition obj is linked into this tree
+*/
+template<class T, class KeyOf, class Tag>
+void IntrusiveAVLTree<T, KeyOf, Tag>::remove(T& obj)
+{
+    int8_t diff = 0;
+    Hook* parent = AVLAlgo::unlink(*this, hookOf(obj), root_, diff);
+    hookOf(obj)->resetHook();
+    --size_;
+    AVLAlgo::removeFix(*this, parent, diff);
+}
+
+/**
+* Returns the object whose key equals key, or nullptr. K only has to be
+* comparable with the key type using <.
+*/
+template<class T, class KeyOf, class Tag>
+template<class K>
+T* IntrusiveAVLTree<T, KeyOf, Tag>::find(const K& key) const
+{
+    Hook* curr = root_;
+    while (curr != nullptr)
+    {
+        if (key < keyOf_(*objectOf(curr)))
+        {
+            curr = curr->getLeft();
+        }
+        else if (keyOf_(*objectOf(curr)) < key)
+        {
+            curr = curr->getRight();
+        }
+        else
+        {
+            return objectOf(curr);
+        }
+    }
+    return nullptr;
+}
+
+/**
+* Unlinks every object (nothing is freed). Uses the links themselves as
+* the traversal state, so it needs no extra memory.
+*/
+template<class T, class KeyOf, class Tag>
+void IntrusiveAVLTree<T, KeyOf, Tag>::clear()
+{
+    Hook* curr = root_;
+    while (curr != nullptr)
+    {
+        //descend to a leaf, then reset it and climb back to its parent
+        if (curr->getLeft() != nullptr)
+        {
+            curr = curr->getLeft();
+        }
+        else if (curr->getRight() != nullptr)
+        {
+            curr = curr->getRight();
+        }
+        else
+        {
+            Hook* parent = curr->getParent();
+            if (parent != nullptr)
+            {
+                if (parent->getLeft() == curr)
+                {
+                    parent->setLeft(nullptr);
+                }
+                else
+                {
+                    parent->setRight(nullptr);
+                }
+            }
+            curr->resetHook();
+            curr = parent;
+        }
+    }
+    root_ = nullptr;
+    size_ = 0;
+}
+
+template<class T, class KeyOf, class Tag>
+bool IntrusiveAVLTree<T, KeyOf, Tag>::empty() const
+{
+    return root_ == nullptr;
+}
+
+template<class T, class KeyOf, class Tag>
+size_t IntrusiveAVLTree<T, KeyOf, Tag>::size() const
+{
+    return size_;
+}
+
+template<class T, class KeyOf, class Tag>
+typename IntrusiveAVLTree<T, KeyOf, Tag>::iterator
+IntrusiveAVLTree<T, KeyOf, Tag>::begin() const
+{
+    Hook* curr = root_;
+    while (curr != nullptr && curr->getLeft() != nullptr)
+    {
+        curr = curr->getLeft();
+    }
+    return iterator(curr);
+}
+
+template<class T, class KeyOf, class Tag>
+typename IntrusiveAVLTree<T, KeyOf, Tag>::iterator
+IntrusiveAVLTree<T, KeyOf, Tag>::end() const
+{
+    return iterator(nullptr);
+}
+
+/**
+* Iterator positioned at obj, found in O(1).
+* @precondition obj is linked into this tree
+*/
+template<class T, class KeyOf, class Tag>
+typename IntrusiveAVLTree<T, KeyOf, Tag>::iterator
+IntrusiveAVLTree<T, KeyOf, Tag>::iteratorTo(T& obj) const
+{
+    return iterator(hookOf(obj));
+}
+
+template<class T, class KeyOf, class Tag>
+T* IntrusiveAVLTree<T, KeyOf, Tag>::objectOf(Hook* h)
+{
+    return static_cast<T*>(h);
+}
+
+template<class T, class KeyOf, class Tag>
+typename IntrusiveAVLTree<T, KeyOf, Tag>::Hook* IntrusiveAVLTree<T, KeyOf, Tag>::hookOf(T& obj)
+{
+    return static_cast<Hook*>(&obj);
+}
+
+template<class T, class KeyOf, class Tag>
+void IntrusiveAVLTree<T, KeyOf, Tag>::rotateLeft(Hook* n)
+{
+    AVLAlgo::rotateLeft(n, root_);
+}
+
+template<class T, class KeyOf, class Tag>
+void IntrusiveAVLTree<T, KeyOf, Tag>::rotateRight(Hook* n)
+{
+    AVLAlgo::rotateRight(n, root_);
+}
+
+template<class T, class KeyOf, class Tag>
+void IntrusiveAVLTree<T, KeyOf, Tag>::nodeSwap(Hook* n1, Hook* n2)
+{
+    AVLAlgo::swapNodes(n1, n2, root_);
+}
+
+#endif
@@ -0,0 +1,141 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "avlbst.h"
+#include "avl-sharded.h"
+using namespace std;
+
+// Write scaling of ShardedAVLMap against a single AVLTree behind one
+// mutex, for 1, 2, 4, ... up to max threads. Each thread does ops
+// operations on random keys: 80% inserts, 10% finds, 10% removes.
+//
+// usage: ./sharded-bench [ops per thread=200000] [max threads=64] [shards=64]
+
+// Collected here so the optimizer cannot drop the finds
+static std::atomic<size_t> sink(0);
+
+struct LockedAVL
+{
+    std::mutex lock;
+    AVLTree<uint64_t, uint64_t> tree;
+
+    void insert(uint64_t key)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        tree.insert(std::make_pair(key, key));
+    }
+    bool find(uint64_t key)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return tree.find(key) != tree.end();
+    }
+    void remove(uint64_t key)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        tree.remove(key);
+    }
+};
+
+struct Sharded
+{
+    explicit Sharded(size_t shards) :
+        map(shards)
+    {
+        //split points from a sample of the same key distribution the workers use
+        vector<uint64_t> sample;
+        uint64_t state = 12345;
+        for (int i = 0; i < 4096; ++i)
+        {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            sample.push_back(state >> 33);
+        }
+        map.presplit(sample);
+    }
+
+    ShardedAVLMap<uint64_t, uint64_t> map;
+
+    void insert(uint64_t key)
+    {
+        map.insert(std::make_pair(key, key));
+    }
+    bool find(uint64_t key)
+    {
+        uint64_t value;
+        return map.find(key, value);
+    }
+    void remove(uint64_t key)
+    {
+        map.remove(key);
+    }
+};
+
+template<class Map>
+double run(Map& map, unsigned threads, size_t ops)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    vector<thread> workers;
+    for (unsigned t = 0; t < threads; ++t)
+    {
+        workers.push_back(thread([&map, t, ops]() {
+            uint64_t state = 0x9E3779B97F4A7C15ULL * (t + 1);
+            size_t found = 0;
+            for (size_t i = 0; i < ops; ++i)
+            {
+                state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+                uint64_t key = state >> 33;
+                unsigned roll = (unsigned)(state >> 8) % 10;
+                if (roll < 8)
+                {
+                    map.insert(key);
+                }
+                else if (roll < 9)
+                {
+                    found += map.find(key);
+                }
+                else
+                {
+                    map.remove(key);
+                }
+            }
+            sink += found;
+        }));
+    }
+    for (size_t i = 0; i < workers.size(); ++i)
+    {
+        workers[i].join();
+    }
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return threads * ops / secs;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t ops = (argc > 1) ? (size_t)atol(argv[1]) : 200000;
+    unsigned maxThreads = (argc > 2) ? (unsigned)atoi(argv[2]) : 64;
+    size_t shards = (argc > 3) ? (size_t)atol(argv[3]) : 64;
+
+    cout << "hardware threads: " << thread::hardware_concurrency() << ", ops per thread: " << ops << endl;
+    cout << "threads   single lock ops/s   sharded ops/s   speedup" << endl;
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        LockedAVL single;
+        double singleRate = run(single, threads, ops);
+        Sharded sharded(shards);
+        double shardedRate = run(sharded, threads, ops);
+
+        cout.width(7);
+        cout << threads;
+        cout.width(20);
+        cout << (uint64_t)singleRate;
+        cout.width(16);
+        cout << (uint64_t)shardedRate;
+        cout.width(10);
+        cout << shardedRate / singleRate << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,194 @@
+#ifndef STATIC_MAP_H
+#define STATIC_MAP_H
+
+#include <cstddef>
+#include <stdexcept>
+
+/**
+ * One key/value pair of a StaticMap. An aggregate, so tables can be
+ * written as constexpr arrays of braced pairs.
+ */
+template<typename Key, typename Value>
+struct StaticEntry
+{
+    Key key;
+    Value value;
+};
+
+/**
+ * Compile-time index list, C++11's stand-in for std::index_sequence.
+ * MakeStaticIndices<N> builds 0 ... N-1 by doubling, so the template
+ * depth stays logarithmic in N.
+ */
+template<size_t... I>
+struct StaticIndices
+{
+    typedef StaticIndices type;
+};
+
+template<typename A, typename B>
+struct ConcatStaticIndices;
+
+template<size_t... A, size_t... B>
+struct ConcatStaticIndices<StaticIndices<A...>, StaticIndices<B...> >
+    : StaticIndices<A..., (sizeof...(A) + B)...>
+{};
+
+template<size_t N>
+struct MakeStaticIndices
+    : ConcatStaticIndices<typename MakeStaticIndices<N / 2>::type, typename MakeStaticIndices<N - N / 2>::type>
+{};
+
+template<>
+struct MakeStaticIndices<0> : StaticIndices<>
+{};
+
+template<>
+struct MakeStaticIndices<1> : StaticIndices<0>
+{};
+
+/**
+ * A fixed, ordered map whose whole layout is computed by the compiler.
+ *
+ * The entries are stored in Eytzinger (breadth-first) order: slot 1 holds
+ * the root of a complete binary search tree over the keys and slot k has
+ * its children in slots 2k and 2k+1. A lookup touches the same O(log n)
+ * keys a balanced BinarySearchTree::find() would, but the top levels share
+ * a few cache lines and there are no pointers to chase. Declared constexpr,
+ * the table lives in read-only data: no startup work and no allocation.
+ *
+ *   constexpr StaticEntry<int, char> grades[] = { {50, 'F'}, {60, 'D'}, {70, 'C'} };
+ *   constexpr StaticMap<int, char, 3> table(grades);
+ *   static_assert(table.at(60) == 'D', "");
+ *
+ * The entries passed in must be sorted by key with no duplicates; a table
+ * that is not fails to compile when the map is constexpr (and throws
+ * std::logic_error otherwise). Keys are compared with < and ==, as in
+ * BinarySearchTree, and must be literal types.
+ */
+template<typename Key, typename Value, size_t N>
+class StaticMap
+{
+    static_assert(N > 0, "StaticMap needs at least one entry");
+
+public:
+    typedef StaticEntry<Key, Value> Entry;
+
+    constexpr explicit StaticMap(const Entry (&sorted)[N]) :
+        StaticMap(sorted, typename MakeStaticIndices<N>::type())
+    {}
+
+    /**
+     * Pointer to the value stored for key, or nullptr.
+     */
+    constexpr const Value* find(const Key& key) const
+    {
+        return findFrom(1, key);
+    }
+
+    constexpr bool contains(const Key& key) const
+    {
+        return find(key) != nullptr;
+    }
+
+    /**
+     * The value stored for key; throws std::out_of_range for a missing key
+     * like BinarySearchTree::operator[] const.
+     */
+    constexpr const Value& at(const Key& key) const
+    {
+        return atFrom(1, key);
+    }
+
+    constexpr size_t size() const
+    {
+        return N;
+    }
+
+    /**
+     * Entry in Eytzinger slot k, 1 <= k <= N (slot 1 is the root).
+     */
+    constexpr const Entry& slot(size_t k) const
+    {
+        return slots_[k - 1];
+    }
+
+private:
+    template<size_t... I>
+    constexpr StaticMap(const Entry (&sorted)[N], StaticIndices<I...>) :
+        slots_{ checkedEntry(sorted, sortedIndex(I + 1))... }
+    {}
+
+    constexpr const Value* findFrom(size_t k, const Key& key) const
+    {
+        return (k > N) ? nullptr
+            : (key == slots_[k - 1].key) ? &slots_[k - 1].value
+            : (key < slots_[k - 1].key) ? findFrom(2 * k, key)
+            : findFrom(2 * k + 1, key);
+    }
+
+    constexpr const Value& atFrom(size_t k, const Key& key) const
+    {
+        return (k > N) ? throw std::out_of_range("Invalid key")
+            : (key == slots_[k - 1].key) ? slots_[k - 1].value
+            : (key < slots_[k - 1].key) ? atFrom(2 * k, key)
+            : atFrom(2 * k + 1, key);
+    }
+
+    /**
+     * Number of slots in the subtree rooted at slot k, one level at a time:
+     * the level below [first, first + width) is [2 * first, 2 * first + 2 * width).
+     */
+    static constexpr size_t subtreeSize(size_t k)
+    {
+        return levelSizes(k, 1);
+    }
+
+    static constexpr size_t levelSizes(size_t first, size_t width)
+    {
+        return (first > N) ? 0
+            : ((first + width - 1 < N) ? width : N - first + 1) + levelSizes(2 * first, 2 * width);
+    }
+
+    /**
+     * Number of keys that sort before every key in the subtree at slot k:
+     * a left child inherits its parent's count, a right child adds the
+     * parent and the parent's left subtree.
+     */
+    static constexpr size_t keysBefore(size_t k)
+    {
+        return (k == 1) ? 0
+            : (k % 2 == 0) ? keysBefore(k / 2)
+            : keysBefore(k / 2) + subtreeSize(k - 1) + 1;
+    }
+
+    /**
+     * Position in the sorted input of the entry that goes into slot k.
+     */
+    static constexpr size_t sortedIndex(size_t k)
+    {
+        return keysBefore(k) + subtreeSize(2 * k);
+    }
+
+    static constexpr const Entry& checkedEntry(const Entry (&sorted)[N], size_t i)
+    {
+        return (i + 1 < N && !(sorted[i].key < sorted[i + 1].key))
+            ? throw std::logic_error("StaticMap entries must be sorted by key with no duplicates")
+            : sorted[i];
+    }
+
+    Entry slots_[N];
+};
+
+/**
+ * Deduces the size, so a table can be declared with auto:
+ *
+ *   constexpr auto table = makeStaticMap(grades);
+ */
+template<typename Key, typename Value, size_t N>
+constexpr StaticMap<Key, Value, N> makeStaticMap(const StaticEntry<Key, Value> (&sorted)[N])
+{
+    return StaticMap<Key, Value, N>(sorted);
+}
+
+#endif
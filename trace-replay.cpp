@@ -0,0 +1,354 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <chrono>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include "bst.h"
+#include "avlbst.h"
+using namespace std;
+
+// Replays an operation trace against BinarySearchTree, AVLTree and/or
+// std::map and reports throughput plus per-operation latency percentiles.
+//
+// usage: ./trace-replay <bst|avl|map|all> <trace file>
+//        ./trace-replay --gen <trace file> <ops> [text|binary]
+//
+// Text traces have one operation per line ('#' starts a comment):
+//   i <key> [value]   insert, or overwrite the value of an existing key
+//   f <key>           find
+//   r <key>           remove
+//   g <lo> <hi>       range scan over the keys in [lo, hi]
+// Keys and values are 64-bit integers.
+//
+// Binary traces start with the 8 bytes "BSTTRC1\n" followed by 17-byte
+// records: the op letter as above, then key and value/hi as int64 in the
+// byte order of the machine that wrote them.
+//
+// Each engine replays the trace twice from empty: once untimed per op to
+// measure throughput, then once timing every op for the percentiles.
+
+static const char BINARY_MAGIC[8] = { 'B', 'S', 'T', 'T', 'R', 'C', '1', '\n' };
+static const size_t RECORD_BYTES = 17;
+
+struct TraceOp
+{
+    char op;
+    int64_t key;
+    int64_t arg;    // value for inserts, hi for range scans
+};
+
+// Collected here so the optimizer cannot drop lookups whose result is unused
+static volatile int64_t sink;
+
+bool readText(istream& in, vector<TraceOp>& ops)
+{
+    string line;
+    size_t lineNo = 0;
+    while (getline(in, line))
+    {
+        ++lineNo;
+        size_t start = line.find_first_not_of(" \t\r");
+        if (start == string::npos || line[start] == '#')
+        {
+            continue;
+        }
+
+        istringstream fields(line);
+        TraceOp t;
+        t.arg = 0;
+        fields >> t.op >> t.key;
+        bool ok = !fields.fail() && (t.op == 'i' || t.op == 'f' || t.op == 'r' || t.op == 'g');
+        if (ok && (t.op == 'i' || t.op == 'g'))
+        {
+            fields >> t.arg;
+            //the value of an insert is optional, the hi of a range is not
+            if (fields.fail())
+            {
+                ok = (t.op == 'i');
+                t.arg = 0;
+            }
+        }
+        if (!ok)
+        {
+            cerr << "bad trace line " << lineNo << ": " << line << endl;
+            return false;
+        }
+        ops.push_back(t);
+    }
+    return true;
+}
+
+bool readBinary(istream& in, vector<TraceOp>& ops)
+{
+    char record[RECORD_BYTES];
+    while (in.read(record, RECORD_BYTES))
+    {
+        TraceOp t;
+        t.op = record[0];
+        memcpy(&t.key, record + 1, sizeof(int64_t));
+        memcpy(&t.arg, record + 9, sizeof(int64_t));
+        if (t.op != 'i' && t.op != 'f' && t.op != 'r' && t.op != 'g')
+        {
+            cerr << "bad op '" << t.op << "' in record " << ops.size() << endl;
+            return false;
+        }
+        ops.push_back(t);
+    }
+    if (in.gcount() != 0)
+    {
+        cerr << "trace ends with a partial record" << endl;
+        return false;
+    }
+    return true;
+}
+
+bool readTrace(const char* path, vector<TraceOp>& ops)
+{
+    ifstream in(path, ios::binary);
+    if (!in)
+    {
+        cerr << "cannot open " << path << endl;
+        return false;
+    }
+
+    char magic[sizeof(BINARY_MAGIC)];
+    in.read(magic, sizeof(magic));
+    if (in.gcount() == (streamsize)sizeof(magic) && memcmp(magic, BINARY_MAGIC, sizeof(magic)) == 0)
+    {
+        return readBinary(in, ops);
+    }
+    in.clear();
+    in.seekg(0);
+    return readText(in, ops);
+}
+
+// Writes a synthetic trace: 50% finds, 30% inserts, 10% removes and 10%
+// short range scans over uniformly random keys.
+bool writeTrace(const char* path, size_t count, bool binary)
+{
+    ofstream out(path, ios::binary);
+    if (!out)
+    {
+        cerr << "cannot create " << path << endl;
+        return false;
+    }
+    if (binary)
+    {
+        out.write(BINARY_MAGIC, sizeof(BINARY_MAGIC));
+    }
+
+    srand(1);
+    int64_t keySpace = (int64_t)count + 1;
+    for (size_t i = 0; i < count; ++i)
+    {
+        TraceOp t;
+        int roll = rand() % 10;
+        t.op = (roll < 5) ? 'f' : (roll < 8) ? 'i' : (roll < 9) ? 'r' : 'g';
+        t.key = rand() % keySpace;
+        t.arg = (t.op == 'g') ? t.key + rand() % 64 : (t.op == 'i') ? (int64_t)i : 0;
+
+        if (binary)
+        {
+            char record[RECORD_BYTES];
+            record[0] = t.op;
+            memcpy(record + 1, &t.key, sizeof(int64_t));
+            memcpy(record + 9, &t.arg, sizeof(int64_t));
+            out.write(record, RECORD_BYTES);
+        }
+        else if (t.op == 'i' || t.op == 'g')
+        {
+            out << t.op << ' ' << t.key << ' ' << t.arg << '\n';
+        }
+        else
+        {
+            out << t.op << ' ' << t.key << '\n';
+        }
+    }
+    return (bool)out;
+}
+
+// Engine adapters: each gives the replay loop the same four operations.
+template<class Tree>
+struct TreeEngine
+{
+    Tree tree;
+
+    void insert(int64_t key, int64_t value)
+    {
+        tree.insert(std::make_pair(key, value));
+    }
+    bool find(int64_t key)
+    {
+        return tree.find(key) != tree.end();
+    }
+    void remove(int64_t key)
+    {
+        tree.remove(key);
+    }
+    int64_t range(int64_t lo, int64_t hi)
+    {
+        int64_t sum = 0;
+        for (typename Tree::iterator it = tree.lower_bound(lo); it != tree.end() && !(hi < it->first); ++it)
+        {
+            sum += it->second;
+        }
+        return sum;
+    }
+};
+
+struct MapEngine
+{
+    std::map<int64_t, int64_t> tree;
+
+    void insert(int64_t key, int64_t value)
+    {
+        tree[key] = value;
+    }
+    bool find(int64_t key)
+    {
+        return tree.find(key) != tree.end();
+    }
+    void remove(int64_t key)
+    {
+        tree.erase(key);
+    }
+    int64_t range(int64_t lo, int64_t hi)
+    {
+        int64_t sum = 0;
+        for (std::map<int64_t, int64_t>::iterator it = tree.lower_bound(lo); it != tree.end() && it->first <= hi; ++it)
+        {
+            sum += it->second;
+        }
+        return sum;
+    }
+};
+
+template<class Engine>
+inline void apply(Engine& engine, const TraceOp& t)
+{
+    switch (t.op)
+    {
+    case 'i':
+        engine.insert(t.key, t.arg);
+        break;
+    case 'f':
+        sink = sink + engine.find(t.key);
+        break;
+    case 'r':
+        engine.remove(t.key);
+        break;
+    default:
+        sink = sink + engine.range(t.key, t.arg);
+        break;
+    }
+}
+
+int opIndex(char op)
+{
+    return (op == 'i') ? 0 : (op == 'f') ? 1 : (op == 'r') ? 2 : 3;
+}
+
+// Nearest-rank percentile of already sorted samples
+uint64_t percentile(const vector<uint64_t>& sorted, double p)
+{
+    size_t rank = (size_t)(p * sorted.size());
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+template<class Engine>
+void replay(const char* name, const vector<TraceOp>& ops)
+{
+    typedef chrono::steady_clock clock;
+
+    //throughput pass, no per-op timing overhead
+    {
+        Engine engine;
+        clock::time_point start = clock::now();
+        for (size_t i = 0; i < ops.size(); ++i)
+        {
+            apply(engine, ops[i]);
+        }
+        double secs = chrono::duration<double>(clock::now() - start).count();
+        cout << name << ": " << ops.size() << " ops in " << secs * 1000 << " ms, "
+             << (secs > 0 ? (uint64_t)(ops.size() / secs) : 0) << " ops/s" << endl;
+    }
+
+    //latency pass
+    vector<uint64_t> samples[4];
+    {
+        Engine engine;
+        for (size_t i = 0; i < ops.size(); ++i)
+        {
+            clock::time_point start = clock::now();
+            apply(engine, ops[i]);
+            clock::time_point stop = clock::now();
+            samples[opIndex(ops[i].op)].push_back(
+                (uint64_t)chrono::duration_cast<chrono::nanoseconds>(stop - start).count());
+        }
+    }
+
+    static const char* const opNames[4] = { "insert", "find  ", "remove", "range " };
+    cout << "  latency ns     count      p50      p99     p999      max" << endl;
+    for (int k = 0; k < 4; ++k)
+    {
+        if (samples[k].empty())
+        {
+            continue;
+        }
+        sort(samples[k].begin(), samples[k].end());
+        char row[128];
+        snprintf(row, sizeof(row), "  %s %12zu %8llu %8llu %8llu %8llu", opNames[k], samples[k].size(),
+            (unsigned long long)percentile(samples[k], 0.50), (unsigned long long)percentile(samples[k], 0.99),
+            (unsigned long long)percentile(samples[k], 0.999), (unsigned long long)samples[k].back());
+        cout << row << endl;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc >= 4 && strcmp(argv[1], "--gen") == 0)
+    {
+        bool binary = (argc > 4 && strcmp(argv[4], "binary") == 0);
+        return writeTrace(argv[2], (size_t)strtoull(argv[3], NULL, 10), binary) ? 0 : 1;
+    }
+    if (argc != 3)
+    {
+        cerr << "usage: " << argv[0] << " <bst|avl|map|all> <trace file>" << endl;
+        cerr << "       " << argv[0] << " --gen <trace file> <ops> [text|binary]" << endl;
+        return 1;
+    }
+
+    string engine = argv[1];
+    if (engine != "bst" && engine != "avl" && engine != "map" && engine != "all")
+    {
+        cerr << "unknown engine " << engine << endl;
+        return 1;
+    }
+
+    vector<TraceOp> ops;
+    if (!readTrace(argv[2], ops))
+    {
+        return 1;
+    }
+
+    if (engine == "bst" || engine == "all")
+    {
+        replay<TreeEngine<BinarySearchTree<int64_t, int64_t> > >("BinarySearchTree", ops);
+    }
+    if (engine == "avl" || engine == "all")
+    {
+        replay<TreeEngine<AVLTree<int64_t, int64_t> > >("AVLTree", ops);
+    }
+    if (engine == "map" || engine == "all")
+    {
+        replay<MapEngine>("std::map", ops);
+    }
+    return 0;
+}
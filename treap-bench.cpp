@@ -0,0 +1,201 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstdint>
+#include <chrono>
+#include <vector>
+#include "avlbst.h"
+#include "treap.h"
+using namespace std;
+
+// Treap against AVLTree on three traces over a tree of n random keys:
+//   point  - n random operations: 50% inserts, 30% finds, 20% removes
+//   cut    - ops times: split the tree at a random key and join it back
+//   range  - ops times: take the keys in a random range of width about
+//            width out into a second tree, then put them back
+// The treap does cut and range with split()/merge(). AVLTree has no split,
+// so it moves the same keys the way a caller would today: copy them out,
+// erase(first, last), and apply_batch() them into the other tree.
+//
+// usage: ./treap-bench [n=200000] [ops=200] [width=1000]
+
+// Collected here so the optimizer cannot drop the finds
+static volatile size_t sink = 0;
+
+static uint64_t nextKey(uint64_t& state)
+{
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return state >> 33;
+}
+
+static double since(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+template<class Tree>
+void fill(Tree& tree, size_t n)
+{
+    uint64_t state = 1;
+    for (size_t i = 0; i < n; ++i)
+    {
+        uint64_t key = nextKey(state);
+        tree.insert(make_pair(key, key));
+    }
+}
+
+template<class Tree>
+size_t count(const Tree& tree)
+{
+    size_t n = 0;
+    for (typename Tree::iterator it = tree.begin(); it != tree.end(); ++it)
+    {
+        ++n;
+    }
+    return n;
+}
+
+template<class Tree>
+double point(Tree& tree, size_t ops)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    uint64_t state = 2;
+    for (size_t i = 0; i < ops; ++i)
+    {
+        uint64_t key = nextKey(state);
+        unsigned roll = (unsigned)(key % 10);
+        if (roll < 5)
+        {
+            tree.insert(make_pair(key, key));
+        }
+        else if (roll < 8)
+        {
+            sink += tree.find(key) != tree.end();
+        }
+        else
+        {
+            tree.remove(key);
+        }
+    }
+    return since(start);
+}
+
+// moves the keys in [low, high) of from into to, which holds none of them
+void moveRange(AVLTree<uint64_t, uint64_t>& from, AVLTree<uint64_t, uint64_t>& to, uint64_t low, uint64_t high)
+{
+    AVLTree<uint64_t, uint64_t>::iterator first = from.lower_bound(low);
+    AVLTree<uint64_t, uint64_t>::iterator last = from.lower_bound(high);
+    vector<BatchOp<uint64_t, uint64_t> > ops;
+    for (AVLTree<uint64_t, uint64_t>::iterator it = first; it != last; ++it)
+    {
+        ops.push_back(BatchOp<uint64_t, uint64_t>::upsert(it->first, it->second));
+    }
+    from.erase(first, last);
+    to.apply_batch(ops);
+}
+
+double cut(AVLTree<uint64_t, uint64_t>& tree, size_t ops)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    AVLTree<uint64_t, uint64_t> greater;
+    uint64_t state = 3;
+    for (size_t i = 0; i < ops; ++i)
+    {
+        uint64_t key = nextKey(state);
+        moveRange(tree, greater, key, UINT64_MAX);
+        moveRange(greater, tree, 0, UINT64_MAX);
+    }
+    return since(start);
+}
+
+double cut(Treap<uint64_t, uint64_t>& tree, size_t ops)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    Treap<uint64_t, uint64_t> greater;
+    uint64_t state = 3;
+    for (size_t i = 0; i < ops; ++i)
+    {
+        uint64_t key = nextKey(state);
+        tree.split(key, greater);
+        tree.merge(greater);
+    }
+    return since(start);
+}
+
+double range(AVLTree<uint64_t, uint64_t>& tree, size_t ops, uint64_t span)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    AVLTree<uint64_t, uint64_t> side;
+    uint64_t state = 4;
+    for (size_t i = 0; i < ops; ++i)
+    {
+        uint64_t low = nextKey(state);
+        moveRange(tree, side, low, low + span);
+        sink += side.empty();
+        moveRange(side, tree, 0, UINT64_MAX);
+    }
+    return since(start);
+}
+
+double range(Treap<uint64_t, uint64_t>& tree, size_t ops, uint64_t span)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    Treap<uint64_t, uint64_t> side;
+    Treap<uint64_t, uint64_t> rest;
+    uint64_t state = 4;
+    for (size_t i = 0; i < ops; ++i)
+    {
+        uint64_t low = nextKey(state);
+        tree.split(low, side);
+        side.split(low + span, rest);
+        tree.merge(rest);
+        sink += side.empty();
+        //put the range back: everything at or above low leaves again, then both rejoin
+        tree.split(low, rest);
+        side.merge(rest);
+        tree.merge(side);
+    }
+    return since(start);
+}
+
+int main(int argc, char* argv[])
+{
+    size_t n = (argc > 1) ? (size_t)atol(argv[1]) : 200000;
+    size_t ops = (argc > 2) ? (size_t)atol(argv[2]) : 200;
+    size_t width = (argc > 3) ? (size_t)atol(argv[3]) : 1000;
+    //keys are uniform over 31 bits, so a span this wide holds about width of them
+    uint64_t span = (uint64_t)width * ((1ULL << 31) / (n == 0 ? 1 : n));
+
+    cout << "keys: " << n << ", split/merge ops: " << ops << ", range width: " << width << endl;
+    cout << "trace         AVLTree ms     Treap ms" << endl;
+
+    AVLTree<uint64_t, uint64_t> avl;
+    Treap<uint64_t, uint64_t> treap;
+    fill(avl, n);
+    fill(treap, n);
+
+    double avlMs[3];
+    double treapMs[3];
+    avlMs[0] = point(avl, n);
+    treapMs[0] = point(treap, n);
+    avlMs[1] = cut(avl, ops);
+    treapMs[1] = cut(treap, ops);
+    avlMs[2] = range(avl, ops, span);
+    treapMs[2] = range(treap, ops, span);
+
+    const char* names[3] = { "point", "cut", "range" };
+    for (int i = 0; i < 3; ++i)
+    {
+        cout.width(5);
+        cout << left << names[i] << right;
+        cout.width(20);
+        cout << avlMs[i];
+        cout.width(13);
+        cout << treapMs[i] << endl;
+    }
+    if (count(avl) != count(treap))
+    {
+        cout << "size mismatch: " << count(avl) << " vs " << count(treap) << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,495 @@
+#ifndef TREAP_H
+#define TREAP_H
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "bst.h"
+#include "avlbst.h"
+
+/**
+* A search tree node with a random heap priority.
+*/
+template <typename Key, typename Value>
+class TreapNode : public Node<Key, Value>
+{
+public:
+    TreapNode(const Key& key, const Value& value, TreapNode<Key, Value>* parent, uint32_t priority);
+    virtual ~TreapNode();
+
+    uint32_t getPriority() const;
+    void setPriority(uint32_t priority);
+
+    virtual TreapNode<Key, Value>* getParent() const override;
+    virtual TreapNode<Key, Value>* getLeft() const override;
+    virtual TreapNode<Key, Value>* getRight() const override;
+
+protected:
+    uint32_t priority_;
+};
+
+template<class Key, class Value>
+TreapNode<Key, Value>::TreapNode(const Key& key, const Value& value, TreapNode<Key, Value>* parent, uint32_t priority) :
+    Node<Key, Value>(key, value, parent), priority_(priority)
+{
+
+}
+
+template<class Key, class Value>
+TreapNode<Key, Value>::~TreapNode()
+{
+
+}
+
+template<class Key, class Value>
+uint32_t TreapNode<Key, Value>::getPriority() const
+{
+    return priority_;
+}
+
+template<class Key, class Value>
+void TreapNode<Key, Value>::setPriority(uint32_t priority)
+{
+    priority_ = priority;
+}
+
+/**
+* Overridden like AVLNode's, so the shared rotations see TreapNodes.
+*/
+template<class Key, class Value>
+TreapNode<Key, Value>* TreapNode<Key, Value>::getParent() const
+{
+    return static_cast<TreapNode<Key, Value>*>(this->parent_);
+}
+
+template<class Key, class Value>
+TreapNode<Key, Value>* TreapNode<Key, Value>::getLeft() const
+{
+    return static_cast<TreapNode<Key, Value>*>(this->left_);
+}
+
+template<class Key, class Value>
+TreapNode<Key, Value>* TreapNode<Key, Value>::getRight() const
+{
+    return static_cast<TreapNode<Key, Value>*>(this->right_);
+}
+
+/**
+* A randomized balanced search tree: a binary search tree on the keys that
+* is also a max-heap on random node priorities, which keeps its expected
+* depth O(log n) with no balance bookkeeping.
+*
+* Besides the usual interface it can split and merge whole trees by key
+* range in expected O(log n), relinking nodes without copying them:
+* split(key, greater) moves every key >= key into greater, and
+* merge(greater) takes all of greater back, as long as its keys are all
+* larger. That makes moving a key range between owners a pair of pointer
+* walks instead of a remove and insert per key.
+*/
+template <class Key, class Value>
+class Treap : public BinarySearchTree<Key, Value>
+{
+public:
+    Treap();
+    Treap(const Treap& other);
+    Treap(Treap&& other) noexcept;
+    virtual ~Treap();
+    Treap& operator=(const Treap& other);
+    Treap& operator=(Treap&& other) noexcept;
+    void swap(Treap& other) noexcept;
+
+    virtual void insert(const std::pair<const Key, Value>& keyValuePair) override;
+    void split(const Key& key, Treap& greater);
+    void merge(Treap& greater);
+
+protected:
+    virtual TreapNode<Key, Value>* createNode(const Key& key, const Value& value, Node<Key, Value>* parent) override;
+    virtual TreapNode<Key, Value>* cloneNode(const Node<Key, Value>* src, Node<Key, Value>* parent) const override;
+    virtual void removeNode(Node<Key, Value>* node) override;
+    virtual void refreshAll() override;
+    virtual char saveKind() const override;
+    TreapNode<Key, Value>* treapRoot() const;
+    uint32_t nextPriority();
+    static TreapNode<Key, Value>* mergeNodes(TreapNode<Key, Value>* lo, TreapNode<Key, Value>* hi, TreapNode<Key, Value>* parent);
+
+    uint64_t seed_;     // xorshift state for priorities
+};
+
+template<class Key, class Value>
+Treap<Key, Value>::Treap() :
+    BinarySearchTree<Key, Value>(), seed_(0x9E3779B97F4A7C15ULL ^ (uint64_t)(uintptr_t)this)
+{
+
+}
+
+/**
+* Copies keep their shape and priorities; only the generator is fresh.
+*/
+template<class Key, class Value>
+Treap<Key, Value>::Treap(const Treap<Key, Value>& other) :
+    BinarySearchTree<Key, Value>(), seed_(0x9E3779B97F4A7C15ULL ^ (uint64_t)(uintptr_t)this)
+{
+    this->copyFrom(other);
+}
+
+template<class Key, class Value>
+Treap<Key, Value>::Treap(Treap<Key, Value>&& other) noexcept :
+    BinarySearchTree<Key, Value>(), seed_(other.seed_)
+{
+    this->swapTree(other);
+}
+
+template<class Key, class Value>
+Treap<Key, Value>::~Treap()
+{
+
+}
+
+template<class Key, class Value>
+Treap<Key, Value>& Treap<Key, Value>::operator=(const Treap<Key, Value>& other)
+{
+    BinarySearchTree<Key, Value>::operator=(other);
+    return *this;
+}
+
+template<class Key, class Value>
+Treap<Key, Value>& Treap<Key, Value>::operator=(Treap<Key, Value>&& other) noexcept
+{
+    if (this != &other)
+    {
+        this->clear();
+        swap(other);
+    }
+    return *this;
+}
+
+/**
+* Each treap keeps its own priority generator.
+*/
+template<class Key, class Value>
+void Treap<Key, Value>::swap(Treap<Key, Value>& other) noexcept
+{
+    this->swapTree(other);
+}
+
+/**
+* Inserts as a leaf (or overwrites the value of an existing key), then
+* rotates the new node up past every parent with a lower priority.
+*/
+template<class Key, class Value>
+void Treap<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    const Key& key = keyValuePair.first;
+    TreapNode<Key, Value>* parent = nullptr;
+    TreapNode<Key, Value>* curr = treapRoot();
+    while (curr != nullptr)
+    {
+        if (key < curr->getKey())
+        {
+            parent = curr;
+            curr = curr->getLeft();
+        }
+        else if (curr->getKey() < key)
+        {
+            parent = curr;
+            curr = curr->getRight();
+        }
+        else
+        {
+            curr->setValue(keyValuePair.second);
+            return;
+        }
+    }
+
+    TreapNode<Key, Value>* n = createNode(key, keyValuePair.second, parent);
+    if (parent == nullptr)
+    {
+        this->root_ = n;
+        return;
+    }
+    if (key < parent->getKey())
+    {
+        parent->setLeft(n);
+    }
+    else
+    {
+        parent->setRight(n);
+    }
+
+    while (n->getParent() != nullptr && n->getParent()->getPriority() < n->getPriority())
+    {
+        if (n->getParent()->getLeft() == n)
+        {
+            AVLAlgo::rotateRight(n->getParent(), this->root_);
+        }
+        else
+        {
+            AVLAlgo::rotateLeft(n->getParent(), this->root_);
+        }
+    }
+}
+
+/**
+* Moves every key >= key into greater, whose old contents are cleared.
+* One walk down the tree: each node on the path goes to whichever side
+* its key belongs to, taking the subtree on that side along.
+*/
+template<class Key, class Value>
+void Treap<Key, Value>::split(const Key& key, Treap<Key, Value>& greater)
+{
+    if (&greater == this)
+    {
+        return;
+    }
+    greater.clear();
+
+    //lowHook/highHook: the nodes whose right/left child the next node of that side becomes
+    TreapNode<Key, Value>* lowRoot = nullptr;
+    TreapNode<Key, Value>* highRoot = nullptr;
+    TreapNode<Key, Value>* lowHook = nullptr;
+    TreapNode<Key, Value>* highHook = nullptr;
+    TreapNode<Key, Value>* curr = treapRoot();
+    while (curr != nullptr)
+    {
+        TreapNode<Key, Value>* next;
+        if (curr->getKey() < key)
+        {
+            next = curr->getRight();
+            curr->setParent(lowHook);
+            if (lowHook == nullptr)
+            {
+                lowRoot = curr;
+            }
+            else
+            {
+                lowHook->setRight(curr);
+            }
+            lowHook = curr;
+        }
+        else
+        {
+            next = curr->getLeft();
+            curr->setParent(highHook);
+            if (highHook == nullptr)
+            {
+                highRoot = curr;
+            }
+            else
+            {
+                highHook->setLeft(curr);
+            }
+            highHook = curr;
+        }
+        curr = next;
+    }
+    if (lowHook != nullptr)
+    {
+        lowHook->setRight(nullptr);
+    }
+    if (highHook != nullptr)
+    {
+        highHook->setLeft(nullptr);
+    }
+
+    this->root_ = lowRoot;
+    this->finger_ = nullptr;
+    greater.root_ = highRoot;
+}
+
+/**
+* Moves all of greater into this tree, leaving greater empty. Every key in
+* greater must be larger than every key here; throws std::invalid_argument
+* (changing nothing) otherwise.
+*/
+template<class Key, class Value>
+void Treap<Key, Value>::merge(Treap<Key, Value>& greater)
+{
+    if (&greater == this || greater.root_ == nullptr)
+    {
+        return;
+    }
+    if (this->root_ != nullptr)
+    {
+        Node<Key, Value>* largest = this->root_;
+        while (largest->getRight() != nullptr)
+        {
+            largest = largest->getRight();
+        }
+        if (!(largest->getKey() < greater.getSmallestNode()->getKey()))
+        {
+            throw std::invalid_argument("Treap::merge needs every key of the other treap to be larger");
+        }
+    }
+
+    this->root_ = mergeNodes(treapRoot(), greater.treapRoot(), nullptr);
+    this->finger_ = nullptr;
+    greater.root_ = nullptr;
+    greater.finger_ = nullptr;
+}
+
+template<class Key, class Value>
+TreapNode<Key, Value>* Treap<Key, Value>::createNode(const Key& key, const Value& value, Node<Key, Value>* parent)
+{
+    return new TreapNode<Key, Value>(key, value, static_cast<TreapNode<Key, Value>*>(parent), nextPriority());
+}
+
+template<class Key, class Value>
+TreapNode<Key, Value>* Treap<Key, Value>::cloneNode(const Node<Key, Value>* src, Node<Key, Value>* parent) const
+{
+    const TreapNode<Key, Value>* from = static_cast<const TreapNode<Key, Value>*>(src);
+    return new TreapNode<Key, Value>(from->getKey(), from->getValue(), static_cast<TreapNode<Key, Value>*>(parent), from->getPriority());
+}
+
+/**
+* Replaces node with the merge of its two subtrees, which needs no
+* rotations and keeps the heap order.
+*/
+template<class Key, class Value>
+void Treap<Key, Value>::removeNode(Node<Key, Value>* node)
+{
+    TreapNode<Key, Value>* curr = static_cast<TreapNode<Key, Value>*>(node);
+    if (curr == nullptr)
+    {
+        return;
+    }
+    if (this->finger_ == curr)
+    {
+        this->finger_ = curr->getParent();
+    }
+
+    TreapNode<Key, Value>* parent = curr->getParent();
+    TreapNode<Key, Value>* joined = mergeNodes(curr->getLeft(), curr->getRight(), parent);
+    if (parent == nullptr)
+    {
+        this->root_ = joined;
+    }
+    else if (parent->getLeft() == curr)
+    {
+        parent->setLeft(joined);
+    }
+    else
+    {
+        parent->setRight(joined);
+    }
+    this->destroyNode(curr);
+}
+
+/**
+* load() rebuilds the saved shape with freshly drawn priorities, which need
+* not form a heap. Hands the same kind of random priorities back out in
+* breadth-first order, highest first, so every parent outranks its children.
+*/
+template<class Key, class Value>
+void Treap<Key, Value>::refreshAll()
+{
+    std::vector<TreapNode<Key, Value>*> order;
+    if (this->root_ != nullptr)
+    {
+        order.push_back(treapRoot());
+    }
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        if (order[i]->getLeft() != nullptr)
+        {
+            order.push_back(order[i]->getLeft());
+        }
+        if (order[i]->getRight() != nullptr)
+        {
+            order.push_back(order[i]->getRight());
+        }
+    }
+
+    std::vector<uint32_t> priorities(order.size());
+    for (size_t i = 0; i < priorities.size(); ++i)
+    {
+        priorities[i] = nextPriority();
+    }
+    std::sort(priorities.begin(), priorities.end(), std::greater<uint32_t>());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        order[i]->setPriority(priorities[i]);
+    }
+}
+
+/**
+* 'T': same node layout as 'B', but only a shape a treap built is a
+* random one. A plain tree's file may hold a degenerate chain, which a
+* treap must not take over as its own shape.
+*/
+template<class Key, class Value>
+char Treap<Key, Value>::saveKind() const
+{
+    return 'T';
+}
+
+template<class Key, class Value>
+TreapNode<Key, Value>* Treap<Key, Value>::treapRoot() const
+{
+    return static_cast<TreapNode<Key, Value>*>(this->root_);
+}
+
+template<class Key, class Value>
+uint32_t Treap<Key, Value>::nextPriority()
+{
+    seed_ ^= seed_ << 13;
+    seed_ ^= seed_ >> 7;
+    seed_ ^= seed_ << 17;
+    return (uint32_t)(seed_ >> 32);
+}
+
+/**
+* Joins two treaps, every key of lo below every key of hi, into one hung
+* under parent, and returns its root. Walks down the right spine of lo and
+* the left spine of hi, always taking the higher priority next.
+*/
+template<class Key, class Value>
+TreapNode<Key, Value>* Treap<Key, Value>::mergeNodes(TreapNode<Key, Value>* lo, TreapNode<Key, Value>* hi, TreapNode<Key, Value>* parent)
+{
+    TreapNode<Key, Value>* root = nullptr;
+    TreapNode<Key, Value>* hook = parent;
+    bool hookLeft = false;      //which child of hook the next node becomes; the child it replaces
+                                //is always the one just descended into, so nothing is left stale
+
+    while (lo != nullptr || hi != nullptr)
+    {
+        bool takeLo = (hi == nullptr) || (lo != nullptr && lo->getPriority() >= hi->getPriority());
+        TreapNode<Key, Value>* next = takeLo ? lo : hi;
+
+        next->setParent(hook);
+        if (root == nullptr)
+        {
+            root = next;
+        }
+        else if (hookLeft)
+        {
+            hook->setLeft(next);
+        }
+        else
+        {
+            hook->setRight(next);
+        }
+
+        //with one side used up, next brings its whole subtree along
+        if (lo == nullptr || hi == nullptr)
+        {
+            break;
+        }
+        hook = next;
+        if (takeLo)
+        {
+            lo = lo->getRight();
+            hookLeft = false;
+        }
+        else
+        {
+            hi = hi->getLeft();
+            hookLeft = true;
+        }
+    }
+    return root;
+}
+
+#endif
@@ -0,0 +1,563 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+#include "avlbst.h"
+#include "avl-lazy.h"
+#include "avl-multimap.h"
+#include "avl-seqlock.h"
+#include "avl-compact.h"
+#include "avl-augmented.h"
+#include "avl-wal.h"
+#include "treap.h"
+using namespace std;
+
+// Behaviour checks against std::map. Unlike bst-test, which prints its
+// results for a person to read, this reports every mismatch and exits
+// non-zero if there was any, so it can run unattended.
+
+static int failures = 0;
+
+static void check(bool ok, const char* what)
+{
+    if (!ok)
+    {
+        cout << "FAILED: " << what << endl;
+        ++failures;
+    }
+}
+
+// true if iterating tree gives exactly the pairs of expected, in order
+template<class Tree>
+bool sameContents(const Tree& tree, const map<int, int>& expected)
+{
+    map<int, int>::const_iterator want = expected.begin();
+    for (typename Tree::iterator it = tree.begin(); it != tree.end(); ++it, ++want)
+    {
+        if (want == expected.end() || it->first != want->first || it->second != want->second)
+        {
+            return false;
+        }
+    }
+    return want == expected.end();
+}
+
+static uint64_t nextRandom(uint64_t& state)
+{
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return state >> 33;
+}
+
+// n pairs over about n/2 keys, so many keys repeat
+static vector<pair<int, int> > randomPairs(size_t n, uint64_t seed)
+{
+    vector<pair<int, int> > pairs;
+    for (size_t i = 0; i < n; ++i)
+    {
+        int key = (int)(nextRandom(seed) % (n / 2 + 1));
+        pairs.push_back(make_pair(key, (int)i));
+    }
+    return pairs;
+}
+
+// what build_parallel() should leave: the last pair for each key
+static map<int, int> lastWins(const vector<pair<int, int> >& pairs)
+{
+    map<int, int> result;
+    for (size_t i = 0; i < pairs.size(); ++i)
+    {
+        result[pairs[i].first] = pairs[i].second;
+    }
+    return result;
+}
+
+template<class Tree>
+void checkBuild(Tree& tree, const vector<pair<int, int> >& pairs, unsigned threads, const char* what)
+{
+    tree.insert(make_pair(-1, -1));
+    tree.build_parallel(pairs.begin(), pairs.end(), threads);
+    check(sameContents(tree, lastWins(pairs)), what);
+    check(tree.isBalanced(), what);
+}
+
+void checkBuildParallel()
+{
+    // big enough that sorting and linking are both split over threads
+    vector<pair<int, int> > pairs = randomPairs(40000, 1);
+    map<int, int> expected = lastWins(pairs);
+
+    AVLTree<int, int> plain;
+    checkBuild(plain, pairs, 4, "AVLTree::build_parallel");
+
+    LazyAVLTree<int, int> lazy;
+    checkBuild(lazy, pairs, 4, "LazyAVLTree::build_parallel contents");
+    check(lazy.size() == expected.size(), "LazyAVLTree::build_parallel size");
+    lazy.remove(expected.begin()->first);
+    expected.erase(expected.begin());
+    check(lazy.size() == expected.size(), "LazyAVLTree remove after build_parallel");
+    check(sameContents(lazy, expected), "LazyAVLTree contents after remove");
+
+    CompactingAVLTree<int, int> packed;
+    checkBuild(packed, pairs, 4, "CompactingAVLTree::build_parallel");
+    packed.compact();
+    check(sameContents(packed, lastWins(pairs)), "CompactingAVLTree compact after build_parallel");
+
+    SeqlockAVLTree<int, int> seq;
+    checkBuild(seq, pairs, 4, "SeqlockAVLTree::build_parallel");
+    int value = 0;
+    check(seq.lookup(pairs.back().first, value) && value == pairs.back().second, "SeqlockAVLTree lookup after build_parallel");
+    check(seq[pairs.back().first] == pairs.back().second, "SeqlockAVLTree const operator[]");
+    seq.erase(seq.find(pairs.back().first));
+    check(!seq.contains(pairs.back().first), "SeqlockAVLTree erase through its iterator");
+
+    AugmentedAVLTree<int, int, SumAggregate<int> > sums;
+    checkBuild(sums, pairs, 4, "AugmentedAVLTree::build_parallel");
+    map<int, int> built = lastWins(pairs);
+    long long total = 0;
+    for (map<int, int>::iterator it = built.begin(); it != built.end(); ++it)
+    {
+        total += it->second;
+    }
+    check(sums.aggregate() == (int)total, "AugmentedAVLTree aggregate after build_parallel");
+
+    // a multimap keeps every pair, in input order per key
+    AVLMultiMap<int, int> multi;
+    vector<pair<int, int> > repeats;
+    repeats.push_back(make_pair(1, 10));
+    repeats.push_back(make_pair(2, 20));
+    repeats.push_back(make_pair(1, 11));
+    repeats.push_back(make_pair(1, 12));
+    multi.build_parallel(repeats.begin(), repeats.end());
+    check(multi.count(1) == 3 && multi.count(2) == 1, "AVLMultiMap::build_parallel counts");
+    pair<AVLMultiMap<int, int>::value_iterator, AVLMultiMap<int, int>::value_iterator> run = multi.equal_range(1);
+    int expectedRun[] = { 10, 11, 12 };
+    int i = 0;
+    for (; run.first != run.second && i < 3; ++run.first, ++i)
+    {
+        check(*run.first == expectedRun[i], "AVLMultiMap::build_parallel value order");
+    }
+    check(i == 3 && run.first == run.second, "AVLMultiMap::build_parallel run length");
+
+    // through a base reference the subclass rebuild still runs
+    AVLMultiMap<int, int> viaBase;
+    AVLTree<int, int>& base = viaBase;
+    base.build_parallel(repeats.begin(), repeats.end(), 2);
+    check(viaBase.count(1) == 3 && viaBase.count(2) == 1, "build_parallel through an AVLTree reference");
+
+    // a lazy tree with only dead nodes is empty
+    lazy.clear();
+    lazy.insert(make_pair(1, 1));
+    lazy.remove(1);
+    check(lazy.empty() && lazy.deadCount() == 1, "LazyAVLTree empty with only dead nodes");
+}
+
+void checkSaveLoad()
+{
+    vector<pair<int, int> > pairs = randomPairs(5000, 2);
+    map<int, int> expected = lastWins(pairs);
+    AVLTree<int, int> tree;
+    for (size_t i = 0; i < pairs.size(); ++i)
+    {
+        tree.insert(pairs[i]);
+    }
+
+    stringstream saved;
+    tree.save(saved);
+    AVLTree<int, int> restored;
+    restored.insert(make_pair(-1, -1));
+    check(restored.load(saved), "AVLTree load of its own save");
+    check(sameContents(restored, expected), "AVLTree save/load contents");
+    check(restored.isBalanced(), "AVLTree save/load balance");
+
+    // a plain tree's file has no balance factors, so an AVLTree must refuse it
+    BinarySearchTree<int, int> plain;
+    plain.insert(make_pair(2, 2));
+    plain.insert(make_pair(1, 1));
+    stringstream plainSaved;
+    plain.save(plainSaved);
+    check(!restored.load(plainSaved), "AVLTree load of a BinarySearchTree file");
+    check(restored.empty(), "AVLTree empty after a rejected load");
+
+    // and the reverse
+    stringstream avlSaved;
+    tree.save(avlSaved);
+    check(!plain.load(avlSaved), "BinarySearchTree load of an AVLTree file");
+
+    // a treap reloads its own files, but not a plain tree's, which may be a chain
+    Treap<int, int> treap;
+    BinarySearchTree<int, int> chain;
+    for (int i = 0; i < 100; ++i)
+    {
+        treap.insert(make_pair(i * 7 % 100, i));
+        chain.insert(make_pair(i, i));
+    }
+    stringstream treapSaved;
+    treap.save(treapSaved);
+    Treap<int, int> treapRestored;
+    check(treapRestored.load(treapSaved), "Treap load of its own save");
+    map<int, int> treapExpected;
+    for (int i = 0; i < 100; ++i)
+    {
+        treapExpected[i * 7 % 100] = i;
+    }
+    check(sameContents(treapRestored, treapExpected), "Treap save/load contents");
+    stringstream chainSaved;
+    chain.save(chainSaved);
+    check(!treapRestored.load(chainSaved), "Treap load of a BinarySearchTree file");
+
+    // a string whose length runs past the end of the data fails without reserving that length
+    AVLTree<int, string> named;
+    named.insert(make_pair(1, string("abc")));
+    stringstream namedSaved;
+    named.save(namedSaved);
+    string bytes = namedSaved.str();
+    size_t lengthAt = bytes.size() - 3 - sizeof(uint32_t);
+    uint32_t huge = 0x7FFFFFFF;
+    bytes.replace(lengthAt, sizeof(huge), reinterpret_cast<const char*>(&huge), sizeof(huge));
+    stringstream corrupt(bytes);
+    check(!named.load(corrupt) && named.empty(), "load of a string with a corrupt length");
+
+    // a multimap cannot be saved, even through a base reference
+    AVLMultiMap<int, int> multi;
+    multi.insert(make_pair(1, 1));
+    multi.insert(make_pair(1, 2));
+    AVLTree<int, int>& base = multi;
+    stringstream multiSaved;
+    base.save(multiSaved);
+    check(multiSaved.fail() && multiSaved.str().empty(), "save through an AVLMultiMap reference");
+    stringstream again;
+    tree.save(again);
+    check(!base.load(again), "load through an AVLMultiMap reference");
+}
+
+void checkCompaction()
+{
+    CompactingAVLTree<int, int> tree;
+    map<int, int> expected;
+    uint64_t seed = 5;
+
+    // small steps between changes, so removals keep hitting nodes the pass
+    // has moved, has yet to move, and the one it would resume after
+    bool mismatch = false;
+    for (int i = 0; i < 20000; ++i)
+    {
+        int key = (int)(nextRandom(seed) % 3000);
+        if (nextRandom(seed) % 3 == 0)
+        {
+            tree.remove(key);
+            expected.erase(key);
+        }
+        else
+        {
+            tree.insert(make_pair(key, i));
+            expected[key] = i;
+        }
+        tree.compactStep(7);
+        if (i % 1000 == 999 && !sameContents(tree, expected))
+        {
+            mismatch = true;
+        }
+    }
+    check(!mismatch, "CompactingAVLTree contents during stepped passes");
+    check(tree.isBalanced(), "CompactingAVLTree balance during stepped passes");
+
+    tree.compact();
+    check(!tree.compacting(), "CompactingAVLTree compact() finishes its pass");
+    check(sameContents(tree, expected), "CompactingAVLTree contents after compact");
+
+    // a pass cut short by erase(range), clear() or a copy
+    tree.compactStep(100);
+    tree.erase(tree.lower_bound(500), tree.lower_bound(2500));
+    expected.erase(expected.lower_bound(500), expected.lower_bound(2500));
+    while (!tree.compactStep(50))
+    {
+    }
+    check(sameContents(tree, expected), "CompactingAVLTree contents after erase mid-pass");
+
+    tree.compactStep(10);
+    CompactingAVLTree<int, int> copy(tree);
+    check(sameContents(copy, expected), "CompactingAVLTree copy taken mid-pass");
+    copy.compact();
+    check(sameContents(copy, expected), "CompactingAVLTree compact of a copy");
+
+    tree.clear();
+    expected.clear();
+    check(tree.compactStep(5) && tree.empty(), "CompactingAVLTree step after clear mid-pass");
+    tree.insert(make_pair(1, 1));
+    expected[1] = 1;
+    tree.compact();
+    check(sameContents(tree, expected), "CompactingAVLTree reuse after clear");
+}
+
+// n random inserts, mirrored into expected
+template<class Tree>
+void fillRandom(Tree& tree, map<int, int>& expected, size_t n, uint64_t seed)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        int key = (int)(nextRandom(seed) % (n * 2));
+        tree.insert(make_pair(key, (int)i));
+        expected[key] = (int)i;
+    }
+}
+
+static_assert(is_nothrow_move_constructible<BinarySearchTree<int, int> >::value, "BinarySearchTree move may throw");
+static_assert(is_nothrow_move_constructible<AVLTree<int, int> >::value, "AVLTree move may throw");
+static_assert(is_nothrow_move_assignable<AVLTree<int, int> >::value, "AVLTree move assignment may throw");
+static_assert(is_nothrow_move_constructible<CompactingAVLTree<int, int> >::value, "CompactingAVLTree move may throw");
+
+void checkSwapMove()
+{
+    // same kind through base references: the arenas must follow the nodes
+    CompactingAVLTree<int, int> packedA;
+    CompactingAVLTree<int, int> packedB;
+    map<int, int> expectedA;
+    map<int, int> expectedB;
+    fillRandom(packedA, expectedA, 3000, 6);
+    packedA.compact();
+    fillRandom(packedB, expectedB, 10, 7);
+    BinarySearchTree<int, int>& baseA = packedA;
+    BinarySearchTree<int, int>& baseB = packedB;
+    baseA.swap(baseB);
+    check(sameContents(packedA, expectedB) && sameContents(packedB, expectedA), "CompactingAVLTree swap through base references");
+    while (!expectedA.empty())
+    {
+        packedB.remove(expectedA.begin()->first);
+        expectedA.erase(expectedA.begin());
+    }
+    check(packedB.empty(), "CompactingAVLTree removes after a base swap");
+
+    LazyAVLTree<int, int> lazyA;
+    LazyAVLTree<int, int> lazyB;
+    for (int i = 0; i < 10; ++i)
+    {
+        lazyA.insert(make_pair(i, i));
+    }
+    lazyA.swap(lazyB);
+    check(lazyA.size() == 0 && lazyB.size() == 10, "LazyAVLTree swap moves the live count");
+
+    // different kinds through base references trade items, not nodes
+    AVLTree<int, int> avl;
+    AVLMultiMap<int, int> multi;
+    map<int, int> expectedAvl;
+    fillRandom(avl, expectedAvl, 500, 8);
+    multi.insert(make_pair(1, 10));
+    multi.insert(make_pair(1, 11));
+    multi.insert(make_pair(2, 20));
+    BinarySearchTree<int, int>& baseAvl = avl;
+    BinarySearchTree<int, int>& baseMulti = multi;
+    baseAvl.swap(baseMulti);
+    check(sameContents(multi, expectedAvl) && multi.isBalanced(), "swap of AVLTree and AVLMultiMap: multimap side");
+    check(avl.isBalanced() && avl.find(1) != avl.end() && avl.find(1)->second == 11 && avl.find(2)->second == 20,
+        "swap of AVLTree and AVLMultiMap: AVLTree side");
+
+    BinarySearchTree<int, int> plain;
+    plain.insert(make_pair(1, 1));
+    BinarySearchTree<int, int> moved(std::move(baseAvl));
+    check(avl.empty() && moved.find(2) != moved.end(), "move of an AVLTree into a plain tree");
+
+    // copying nodes of another kind would clone them as the wrong type
+    bool threw = false;
+    try
+    {
+        baseAvl = plain;
+    }
+    catch (invalid_argument&)
+    {
+        threw = true;
+    }
+    check(threw && avl.empty(), "copy assignment across kinds through a base reference");
+}
+
+// k ops around a random spot, sorted by key with each key's ops in order
+static vector<BatchOp<int, int> > randomBatch(size_t k, int keys, uint64_t& seed)
+{
+    vector<BatchOp<int, int> > ops;
+    int from = (int)(nextRandom(seed) % keys);
+    int span = 1 + (int)(nextRandom(seed) % keys);
+    for (size_t i = 0; i < k; ++i)
+    {
+        int key = from + (int)(nextRandom(seed) % span);
+        if (nextRandom(seed) % 3 == 0)
+        {
+            ops.push_back(BatchOp<int, int>::erase(key));
+        }
+        else
+        {
+            ops.push_back(BatchOp<int, int>::upsert(key, (int)i));
+        }
+    }
+    stable_sort(ops.begin(), ops.end(),
+        [](const BatchOp<int, int>& a, const BatchOp<int, int>& b) { return a.key < b.key; });
+    return ops;
+}
+
+void checkApplyBatch()
+{
+    AVLTree<int, int> tree;
+    AugmentedAVLTree<int, int, SumAggregate<int> > sums;
+    map<int, int> expected;
+    uint64_t seed = 6;
+
+    // batches from one op to many times the tree size, so both small joins
+    // and whole new subtrees get built
+    size_t sizes[] = { 1, 3, 40, 5000, 2, 300, 20000, 7, 1000 };
+    for (size_t round = 0; round < 3; ++round)
+    {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+        {
+            vector<BatchOp<int, int> > ops = randomBatch(sizes[s], 8000, seed);
+            tree.apply_batch(ops);
+            sums.apply_batch(ops);
+            for (size_t i = 0; i < ops.size(); ++i)
+            {
+                if (ops[i].kind == BatchOp<int, int>::UPSERT)
+                {
+                    expected[ops[i].key] = ops[i].value;
+                }
+                else
+                {
+                    expected.erase(ops[i].key);
+                }
+            }
+
+            check(sameContents(tree, expected), "AVLTree::apply_batch contents");
+            check(tree.isBalanced(), "AVLTree::apply_batch balance");
+            check(sameContents(sums, expected), "AugmentedAVLTree::apply_batch contents");
+            long long total = 0;
+            for (map<int, int>::iterator it = expected.begin(); it != expected.end(); ++it)
+            {
+                total += it->second;
+            }
+            check(sums.aggregate() == (int)total, "AugmentedAVLTree aggregate after apply_batch");
+
+            // the balance factors left behind must hold up to ordinary updates
+            for (int i = 0; i < 200; ++i)
+            {
+                int key = (int)(nextRandom(seed) % 8000);
+                if (i % 2 == 0)
+                {
+                    tree.insert(make_pair(key, i));
+                    sums.insert(make_pair(key, i));
+                    expected[key] = i;
+                }
+                else
+                {
+                    tree.remove(key);
+                    sums.remove(key);
+                    expected.erase(key);
+                }
+            }
+            check(sameContents(tree, expected) && tree.isBalanced(), "AVLTree updates after apply_batch");
+        }
+    }
+}
+
+static void removeWalFiles(const string& base)
+{
+    remove((base + ".wal").c_str());
+    remove((base + ".ckpt").c_str());
+    remove((base + ".ckpt.tmp").c_str());
+}
+
+void checkWalRecovery()
+{
+    typedef WalAVLTree<int, int> Wal;
+    const string base = "tree-check-wal";
+    removeWalFiles(base);
+    WalOptions options;
+    options.sync = false;
+    map<int, int> expected;
+    uint64_t seed = 3;
+
+    {
+        Wal tree;
+        check(tree.open(base, options), "WalAVLTree open of a new base");
+        for (int i = 0; i < 3000; ++i)
+        {
+            int key = (int)(nextRandom(seed) % 1000);
+            if (i % 4 == 3)
+            {
+                tree.remove(key);
+                expected.erase(key);
+            }
+            else
+            {
+                tree.insert(make_pair(key, i));
+                expected[key] = i;
+            }
+        }
+        tree.erase(tree.lower_bound(100), tree.lower_bound(200));
+        expected.erase(expected.lower_bound(100), expected.lower_bound(200));
+        check(tree.checkpoint(), "WalAVLTree checkpoint");
+
+        // after the checkpoint the rest lives only in the log
+        int last = expected.rbegin()->first;
+        vector<BatchOp<int, int> > ops;
+        ops.push_back(BatchOp<int, int>::upsert(5, 50));
+        ops.push_back(BatchOp<int, int>::erase(last));
+        ops.push_back(BatchOp<int, int>::upsert(5000, 1));
+        tree.apply_batch(ops);
+        expected[5] = 50;
+        expected.erase(last);
+        expected[5000] = 1;
+        check(sameContents(tree, expected), "WalAVLTree contents before close");
+    }
+
+    {
+        // half a record at the end, as a crash in the middle of a write leaves it
+        ofstream log((base + ".wal").c_str(), ios::binary | ios::app);
+        const char torn[] = { 9, 0, 0, 0, 1, 2 };
+        log.write(torn, sizeof(torn));
+    }
+    {
+        Wal tree;
+        check(tree.open(base, options), "WalAVLTree reopen with a torn tail");
+        check(sameContents(tree, expected), "WalAVLTree contents after a torn tail");
+        check(tree.isBalanced(), "WalAVLTree balance after recovery");
+        tree.insert(make_pair(-5, -5));
+        expected[-5] = -5;
+    }
+    {
+        Wal tree;
+        check(tree.open(base, options), "WalAVLTree reopen after writing past a torn tail");
+        check(sameContents(tree, expected), "WalAVLTree contents after writing past a torn tail");
+
+        // a bulk rebuild replaces everything, and must be logged as such
+        vector<pair<int, int> > pairs = randomPairs(2000, 4);
+        tree.build_parallel(pairs.begin(), pairs.end(), 2);
+        expected = lastWins(pairs);
+    }
+    {
+        Wal tree;
+        check(tree.open(base, options), "WalAVLTree reopen after build_parallel");
+        check(sameContents(tree, expected), "WalAVLTree contents after build_parallel");
+    }
+    removeWalFiles(base);
+}
+
+int main()
+{
+    checkBuildParallel();
+    checkSaveLoad();
+    checkCompaction();
+    checkSwapMove();
+    checkApplyBatch();
+    checkWalRecovery();
+
+    if (failures != 0)
+    {
+        cout << failures << " check(s) failed" << endl;
+        return 1;
+    }
+    cout << "All checks passed" << endl;
+    return 0;
+}
@@ -0,0 +1,162 @@
+#ifndef TREE_CODEC_H
+#define TREE_CODEC_H
+
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+/**
+ * Buffered byte sink used by BinarySearchTree::save(). Bytes are collected
+ * and handed to the stream in large chunks rather than one field at a time.
+ * The second constructor appends to a string instead, for callers that
+ * frame the encoded bytes themselves (see avl-wal.h).
+ */
+class CodecWriter
+{
+public:
+    explicit CodecWriter(std::ostream& out, size_t flushAt = 1 << 16) :
+        out_(&out), flushAt_(flushAt), buf_(&own_)
+    {
+        own_.reserve(flushAt + 64);
+    }
+
+    explicit CodecWriter(std::string& sink) :
+        out_(nullptr), flushAt_(0), buf_(&sink)
+    {}
+
+    ~CodecWriter()
+    {
+        flush();
+    }
+
+    void append(const void* bytes, size_t count)
+    {
+        buf_->append(static_cast<const char*>(bytes), count);
+        if (out_ != nullptr && buf_->size() >= flushAt_)
+        {
+            flush();
+        }
+    }
+
+    void flush()
+    {
+        if (out_ != nullptr)
+        {
+            out_->write(buf_->data(), (std::streamsize)buf_->size());
+            buf_->clear();
+        }
+    }
+
+private:
+    std::ostream* out_;
+    size_t flushAt_;
+    std::string own_;
+    std::string* buf_;
+};
+
+/**
+ * Byte source used by BinarySearchTree::load(). Reads straight from the
+ * stream's buffer, skipping the per-call overhead of istream::read(). The
+ * second constructor reads from bytes already in memory.
+ */
+class CodecReader
+{
+public:
+    explicit CodecReader(std::istream& in) :
+        buf_(in.rdbuf()), next_(nullptr), end_(nullptr)
+    {}
+
+    CodecReader(const char* bytes, size_t count) :
+        buf_(nullptr), next_(bytes), end_(bytes + count)
+    {}
+
+    bool read(void* bytes, size_t count)
+    {
+        if (buf_ != nullptr)
+        {
+            return buf_->sgetn(static_cast<char*>(bytes), (std::streamsize)count) == (std::streamsize)count;
+        }
+        if ((size_t)(end_ - next_) < count)
+        {
+            return false;
+        }
+        memcpy(bytes, next_, count);
+        next_ += count;
+        return true;
+    }
+
+    // true once a memory reader has used up all its bytes
+    bool atEnd() const
+    {
+        return buf_ == nullptr && next_ == end_;
+    }
+
+private:
+    std::streambuf* buf_;
+    const char* next_;
+    const char* end_;
+};
+
+/**
+ * Default key/value codec for save()/load(): the raw bytes of the object,
+ * in the byte order of the machine that wrote them. Types that are not
+ * trivially copyable need a specialization (std::string has one below) or
+ * a codec of their own with the same two static members.
+ */
+template<typename T>
+struct BinaryCodec
+{
+    static_assert(std::is_trivially_copyable<T>::value,
+        "BinaryCodec only copies raw bytes; specialize it or pass save()/load() a codec for this type");
+
+    static void write(CodecWriter& out, const T& value)
+    {
+        out.append(&value, sizeof(T));
+    }
+
+    static bool read(CodecReader& in, T& value)
+    {
+        return in.read(&value, sizeof(T));
+    }
+};
+
+/**
+ * Strings are written as a 32-bit length followed by their characters.
+ */
+template<>
+struct BinaryCodec<std::string>
+{
+    static void write(CodecWriter& out, const std::string& value)
+    {
+        uint32_t length = (uint32_t)value.size();
+        out.append(&length, sizeof(length));
+        out.append(value.data(), value.size());
+    }
+
+    static bool read(CodecReader& in, std::string& value)
+    {
+        uint32_t length = 0;
+        if (!in.read(&length, sizeof(length)))
+        {
+            return false;
+        }
+        //grow with the bytes actually read, so a corrupt length cannot allocate gigabytes up front
+        static const uint32_t CHUNK = 64 * 1024;
+        value.clear();
+        while (value.size() < length)
+        {
+            size_t at = value.size();
+            size_t step = (length - at < CHUNK) ? length - at : CHUNK;
+            value.resize(at + step);
+            if (!in.read(&value[at], step))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,339 @@
+#ifndef TREE_EXPORT_H
+#define TREE_EXPORT_H
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "bst.h"
+#include "tree-walk.h"
+
+/**
+ * Exporters that write whole trees to any std::ostream as Graphviz DOT or
+ * as JSON. Unlike printRoot() they have no depth cap: the tree is walked
+ * once, level by level, and output is collected in a buffer that is only
+ * flushed to the stream in large chunks.
+ *
+ * Nodes are numbered in breadth-first order (the root is 0). The options
+ * below can cut the output down for very large trees; numbering is not
+ * affected by them, so ids stay comparable between exports.
+ */
+struct ExportOptions
+{
+    ExportOptions() :
+        minDepth(0), maxDepth(-1), sampleEvery(1), bufferBytes(1 << 16)
+    {}
+
+    int minDepth;           // shallowest depth written (the root is depth 0)
+    int maxDepth;           // deepest depth written, -1 for no limit
+    size_t sampleEvery;     // only write nodes whose id is a multiple of this
+    size_t bufferBytes;     // flush to the stream once the buffer gets this big
+};
+
+/**
+ * Output buffer used by the exporters, plus the scalar formatting they share.
+ */
+class ExportBuffer
+{
+public:
+    ExportBuffer(std::ostream& out, size_t flushAt) :
+        out_(out), flushAt_(flushAt)
+    {
+        buf_.reserve(flushAt + 256);
+    }
+
+    ~ExportBuffer()
+    {
+        flush();
+    }
+
+    void append(const char* text)
+    {
+        buf_ += text;
+        maybeFlush();
+    }
+
+    void append(const std::string& text)
+    {
+        buf_ += text;
+        maybeFlush();
+    }
+
+    void appendId(size_t id)
+    {
+        buf_ += std::to_string(id);
+    }
+
+    /**
+     * Appends v as a JSON value: numbers as they are, everything else as an
+     * escaped string produced by operator<<.
+     */
+    template<typename T>
+    void appendJsonScalar(const T& v)
+    {
+        appendScalar(v, true, typename UseToString<T>::type());
+    }
+
+    /**
+     * Appends v escaped for use inside a double quoted DOT label.
+     */
+    template<typename T>
+    void appendLabelText(const T& v)
+    {
+        appendScalar(v, false, typename UseToString<T>::type());
+    }
+
+    void flush()
+    {
+        if (!buf_.empty())
+        {
+            out_.write(buf_.data(), buf_.size());
+            buf_.clear();
+        }
+    }
+
+private:
+    //integers other than char/bool are formatted with std::to_string, which skips the stream
+    template<typename T>
+    struct UseToString : std::integral_constant<bool,
+        std::is_integral<T>::value && !std::is_same<T, char>::value && !std::is_same<T, bool>::value>
+    {};
+
+    //numbers are written bare in JSON, everything else (including char) is quoted
+    template<typename T>
+    struct IsJsonNumber : std::integral_constant<bool,
+        std::is_arithmetic<T>::value && !std::is_same<T, char>::value>
+    {};
+
+    void maybeFlush()
+    {
+        if (buf_.size() >= flushAt_)
+        {
+            flush();
+        }
+    }
+
+    template<typename T>
+    void appendScalar(const T& v, bool json, std::true_type /* use to_string */)
+    {
+        buf_ += std::to_string(v);
+    }
+
+    template<typename T>
+    void appendScalar(const T& v, bool json, std::false_type /* use operator<< */)
+    {
+        scratch_.str(std::string());
+        scratch_.clear();
+        scratch_ << v;
+        const std::string& text = scratch_.str();
+
+        bool quote = json && !IsJsonNumber<T>::value;
+        if (quote)
+        {
+            buf_ += '"';
+        }
+        for (size_t i = 0; i < text.size(); ++i)
+        {
+            char c = text[i];
+            if (c == '"' || c == '\\')
+            {
+                buf_ += '\\';
+                buf_ += c;
+            }
+            else if (c == '\n')
+            {
+                buf_ += "\\n";
+            }
+            else if ((unsigned char)c < 0x20)
+            {
+                //other control characters are dropped rather than escaped
+                continue;
+            }
+            else
+            {
+                buf_ += c;
+            }
+        }
+        if (quote)
+        {
+            buf_ += '"';
+        }
+    }
+
+    std::ostream& out_;
+    size_t flushAt_;
+    std::string buf_;
+    std::ostringstream scratch_;
+};
+
+/**
+ * Walks the tree breadth first and calls visit(node, id, depth, leftId,
+ * rightId) for every node the options select. leftId/rightId are -1 when
+ * the child is missing or not selected itself. Only one level of the tree
+ * is held in memory at a time.
+ */
+template<typename NodeT, typename Visit>
+void exportWalk(NodeT* root, const ExportOptions& options, Visit visit)
+{
+    if (root == nullptr)
+    {
+        return;
+    }
+
+    size_t sampleEvery = (options.sampleEvery == 0) ? 1 : options.sampleEvery;
+    std::vector<std::pair<NodeT*, size_t> > level;
+    std::vector<std::pair<NodeT*, size_t> > next;
+    level.push_back(std::make_pair(root, (size_t)0));
+    size_t nextId = 1;
+
+    for (int depth = 0; !level.empty(); ++depth)
+    {
+        if (options.maxDepth >= 0 && depth > options.maxDepth)
+        {
+            break;
+        }
+        bool levelShown = (depth >= options.minDepth);
+        bool childrenShown = (depth + 1 >= options.minDepth)
+            && (options.maxDepth < 0 || depth + 1 <= options.maxDepth);
+
+        next.clear();
+        for (size_t i = 0; i < level.size(); ++i)
+        {
+            NodeT* curr = level[i].first;
+            size_t id = level[i].second;
+            NodeT* left = walkLeft(curr);
+            NodeT* right = walkRight(curr);
+
+            //ids are handed out in breadth-first order whether or not the node gets written
+            long long leftId = -1;
+            long long rightId = -1;
+            if (left != nullptr)
+            {
+                if (childrenShown && nextId % sampleEvery == 0)
+                {
+                    leftId = (long long)nextId;
+                }
+                next.push_back(std::make_pair(left, nextId++));
+            }
+            if (right != nullptr)
+            {
+                if (childrenShown && nextId % sampleEvery == 0)
+                {
+                    rightId = (long long)nextId;
+                }
+                next.push_back(std::make_pair(right, nextId++));
+            }
+
+            if (levelShown && id % sampleEvery == 0)
+            {
+                visit(curr, id, depth, leftId, rightId);
+            }
+        }
+        level.swap(next);
+    }
+}
+
+/**
+ * Writes the tree rooted at root as a Graphviz digraph. Each node is
+ * labelled "key: value" and edges are labelled L/R.
+ */
+template<typename NodeT>
+void exportDot(std::ostream& out, NodeT* root, const ExportOptions& options = ExportOptions())
+{
+    ExportBuffer buf(out, options.bufferBytes);
+    buf.append("digraph bst {\n  node [shape=box];\n");
+
+    exportWalk(root, options, [&](NodeT* n, size_t id, int depth, long long leftId, long long rightId) {
+        buf.append("  n");
+        buf.appendId(id);
+        buf.append(" [label=\"");
+        buf.appendLabelText(n->getKey());
+        buf.append(": ");
+        buf.appendLabelText(n->getValue());
+        buf.append("\"];\n");
+
+        if (leftId >= 0)
+        {
+            buf.append("  n");
+            buf.appendId(id);
+            buf.append(" -> n");
+            buf.appendId((size_t)leftId);
+            buf.append(" [label=\"L\"];\n");
+        }
+        if (rightId >= 0)
+        {
+            buf.append("  n");
+            buf.appendId(id);
+            buf.append(" -> n");
+            buf.appendId((size_t)rightId);
+            buf.append(" [label=\"R\"];\n");
+        }
+    });
+
+    buf.append("}\n");
+}
+
+/**
+ * Writes the tree rooted at root as JSON of the form
+ * {"nodes":[{"id":0,"depth":0,"key":...,"value":...,"left":1,"right":null},...]}
+ */
+template<typename NodeT>
+void exportJson(std::ostream& out, NodeT* root, const ExportOptions& options = ExportOptions())
+{
+    ExportBuffer buf(out, options.bufferBytes);
+    buf.append("{\"nodes\":[");
+
+    bool first = true;
+    exportWalk(root, options, [&](NodeT* n, size_t id, int depth, long long leftId, long long rightId) {
+        buf.append(first ? "\n" : ",\n");
+        first = false;
+
+        buf.append("{\"id\":");
+        buf.appendId(id);
+        buf.append(",\"depth\":");
+        buf.appendId((size_t)depth);
+        buf.append(",\"key\":");
+        buf.appendJsonScalar(n->getKey());
+        buf.append(",\"value\":");
+        buf.appendJsonScalar(n->getValue());
+        buf.append(",\"left\":");
+        if (leftId >= 0)
+        {
+            buf.appendId((size_t)leftId);
+        }
+        else
+        {
+            buf.append("null");
+        }
+        buf.append(",\"right\":");
+        if (rightId >= 0)
+        {
+            buf.appendId((size_t)rightId);
+        }
+        else
+        {
+            buf.append("null");
+        }
+        buf.append("}");
+    });
+
+    buf.append("\n]}\n");
+}
+
+/**
+ * Convenience overloads that export a whole BinarySearchTree (or AVLTree).
+ */
+template<typename Key, typename Value>
+void exportDot(std::ostream& out, const BinarySearchTree<Key, Value>& tree, const ExportOptions& options = ExportOptions())
+{
+    exportDot(out, TreeAccess::root(tree), options);
+}
+
+template<typename Key, typename Value>
+void exportJson(std::ostream& out, const BinarySearchTree<Key, Value>& tree, const ExportOptions& options = ExportOptions())
+{
+    exportJson(out, TreeAccess::root(tree), options);
+}
+
+#endif
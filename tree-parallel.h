@@ -0,0 +1,226 @@
+#ifndef TREE_PARALLEL_H
+#define TREE_PARALLEL_H
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "bst.h"
+#include "tree-walk.h"
+
+/**
+ * Whole-tree passes spread over several threads.
+ *
+ * The top levels of the tree are cut off at a depth that gives a few
+ * segments per thread: every subtree hanging below the cut is one segment,
+ * and so is every node above it, so the segments in order cover the keys
+ * in order. Worker threads take segments off a shared counter until none
+ * are left, which evens out subtrees that turned out bigger than others.
+ * Nothing is written to the tree, so the only requirement is that no one
+ * modifies it during the pass.
+ *
+ * The passes see the raw nodes, so trees whose items are not simply their
+ * nodes' pairs are turned away at compile time by the deleted overloads
+ * below: LazyAVLTree (dead nodes) and AVLMultiMap (extra values) for both
+ * passes, and for parallel_for_each also the trees that must see every
+ * value change (SeqlockAVLTree, AugmentedAVLTree, WalAVLTree). Called
+ * through a BinarySearchTree reference they cannot be told apart, so do
+ * not do that.
+ */
+
+template <class Key, class Value> class LazyAVLTree;
+template <class Key, class Value> class AVLMultiMap;
+template <class Key, class Value> class SeqlockAVLTree;
+template <class Key, class Value, class Agg> class AugmentedAVLTree;
+template <class Key, class Value, class KeyCodec, class ValueCodec> class WalAVLTree;
+
+/**
+ * One piece of the in-order sequence: either node alone or the whole
+ * subtree rooted at node.
+ */
+template<typename NodeT>
+struct TreeSegment
+{
+    NodeT* node;
+    bool whole;
+};
+
+/**
+ * Visits every node of the subtree rooted at root in key order with an
+ * explicit stack, so no parent links or successor() calls are needed.
+ */
+template<typename NodeT, typename Visit>
+void walkInOrder(NodeT* root, Visit& visit)
+{
+    std::vector<NodeT*> stack;
+    NodeT* curr = root;
+    while (curr != nullptr || !stack.empty())
+    {
+        while (curr != nullptr)
+        {
+            stack.push_back(curr);
+            curr = walkLeft(curr);
+        }
+        curr = stack.back();
+        stack.pop_back();
+        visit(curr);
+        curr = walkRight(curr);
+    }
+}
+
+/**
+ * Appends the segments of the subtree rooted at n to out in key order,
+ * cutting at cutDepth levels below n.
+ */
+template<typename NodeT>
+void splitSegments(NodeT* n, int cutDepth, std::vector<TreeSegment<NodeT> >& out)
+{
+    if (n == nullptr)
+    {
+        return;
+    }
+    if (cutDepth == 0)
+    {
+        TreeSegment<NodeT> whole = { n, true };
+        out.push_back(whole);
+        return;
+    }
+    splitSegments(walkLeft(n), cutDepth - 1, out);
+    TreeSegment<NodeT> single = { n, false };
+    out.push_back(single);
+    splitSegments(walkRight(n), cutDepth - 1, out);
+}
+
+/**
+ * Resolves a thread count (0 means one per hardware thread) and cuts the
+ * tree rooted at root into about four segments per thread, so one oversized
+ * subtree does not leave the other threads idle. Returns the thread count.
+ */
+template<typename NodeT>
+unsigned planSegments(NodeT* root, unsigned threads, std::vector<TreeSegment<NodeT> >& segments)
+{
+    static const unsigned SEGMENTS_PER_THREAD = 4;
+
+    if (threads == 0)
+    {
+        threads = std::thread::hardware_concurrency();
+    }
+    int cutDepth = 0;
+    while (threads > 1 && (1u << cutDepth) < threads * SEGMENTS_PER_THREAD)
+    {
+        ++cutDepth;
+    }
+    splitSegments(root, cutDepth, segments);
+    return (threads > 0) ? threads : 1;
+}
+
+/**
+ * Runs work(segment index, segment) for every segment, on the calling
+ * thread plus up to threads - 1 others.
+ */
+template<typename NodeT, typename Work>
+void runSegments(const std::vector<TreeSegment<NodeT> >& segments, unsigned threads, Work work)
+{
+    std::atomic<size_t> next(0);
+    auto drain = [&]() {
+        for (size_t i = next++; i < segments.size(); i = next++)
+        {
+            work(i, segments[i]);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < threads && t < segments.size(); ++t)
+    {
+        workers.push_back(std::thread(drain));
+    }
+    drain();
+    for (size_t t = 0; t < workers.size(); ++t)
+    {
+        workers[t].join();
+    }
+}
+
+/**
+ * Calls fn(item) for every key/value pair of tree, from several threads at
+ * once and in no particular order. fn must be safe to call concurrently;
+ * it may change the value but not the key.
+ *
+ * @param threads 0 means one per hardware thread
+ */
+template<typename Key, typename Value, typename Fn>
+void parallel_for_each(BinarySearchTree<Key, Value>& tree, Fn fn, unsigned threads = 0)
+{
+    typedef Node<Key, Value> NodeT;
+
+    std::vector<TreeSegment<NodeT> > segments;
+    threads = planSegments(TreeAccess::root(tree), threads, segments);
+    runSegments(segments, threads, [&fn](size_t, const TreeSegment<NodeT>& segment) {
+        if (!segment.whole)
+        {
+            fn(segment.node->getItem());
+            return;
+        }
+        auto visit = [&fn](NodeT* n) { fn(n->getItem()); };
+        walkInOrder(segment.node, visit);
+    });
+}
+
+template<typename Key, typename Value, typename Fn>
+void parallel_for_each(LazyAVLTree<Key, Value>& tree, Fn fn, unsigned threads = 0) = delete;
+template<typename Key, typename Value, typename Fn>
+void parallel_for_each(AVLMultiMap<Key, Value>& tree, Fn fn, unsigned threads = 0) = delete;
+template<typename Key, typename Value, typename Fn>
+void parallel_for_each(SeqlockAVLTree<Key, Value>& tree, Fn fn, unsigned threads = 0) = delete;
+template<typename Key, typename Value, typename Agg, typename Fn>
+void parallel_for_each(AugmentedAVLTree<Key, Value, Agg>& tree, Fn fn, unsigned threads = 0) = delete;
+template<typename Key, typename Value, typename KeyCodec, typename ValueCodec, typename Fn>
+void parallel_for_each(WalAVLTree<Key, Value, KeyCodec, ValueCodec>& tree, Fn fn, unsigned threads = 0) = delete;
+
+/**
+ * Ordered parallel reduction: every segment folds its items, in key order,
+ * into its own copy of identity with acc = fold(acc, item), and the segment
+ * results are then combined from the smallest keys to the largest with
+ * result = combine(result, part). Gives the same answer as a single-threaded
+ * fold as long as combine is associative and identity is neutral for it;
+ * it need not be commutative, so order-sensitive results such as
+ * concatenations work. fold gets each item as a const pair and must be
+ * safe to run on separate threads.
+ *
+ * @param threads 0 means one per hardware thread
+ */
+template<typename Key, typename Value, typename T, typename Fold, typename Combine>
+T parallel_reduce(const BinarySearchTree<Key, Value>& tree, const T& identity, Fold fold, Combine combine, unsigned threads = 0)
+{
+    typedef Node<Key, Value> NodeT;
+
+    std::vector<TreeSegment<NodeT> > segments;
+    threads = planSegments(TreeAccess::root(tree), threads, segments);
+    std::vector<T> parts(segments.size(), identity);
+
+    runSegments(segments, threads, [&](size_t i, const TreeSegment<NodeT>& segment) {
+        T& acc = parts[i];
+        if (!segment.whole)
+        {
+            acc = fold(acc, static_cast<const NodeT*>(segment.node)->getItem());
+            return;
+        }
+        auto visit = [&](const NodeT* n) { acc = fold(acc, n->getItem()); };
+        walkInOrder(segment.node, visit);
+    });
+
+    T result = identity;
+    for (size_t i = 0; i < parts.size(); ++i)
+    {
+        result = combine(result, parts[i]);
+    }
+    return result;
+}
+
+template<typename Key, typename Value, typename T, typename Fold, typename Combine>
+T parallel_reduce(const LazyAVLTree<Key, Value>& tree, const T& identity, Fold fold, Combine combine, unsigned threads = 0) = delete;
+template<typename Key, typename Value, typename T, typename Fold, typename Combine>
+T parallel_reduce(const AVLMultiMap<Key, Value>& tree, const T& identity, Fold fold, Combine combine, unsigned threads = 0) = delete;
+
+#endif
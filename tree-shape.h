@@ -0,0 +1,170 @@
+#ifndef TREE_SHAPE_H
+#define TREE_SHAPE_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <vector>
+#include "tree-walk.h"
+
+/**
+ * Shape metrics that measureShape() can compute. Combine them with |,
+ * the engine only does the work needed for the requested ones.
+ */
+enum ShapeMetric
+{
+    SHAPE_HEIGHT      = 1 << 0,   // height (empty tree 0, single node 1)
+    SHAPE_LEAF_DEPTHS = 1 << 1,   // min/max leaf depth (the root is at depth 0)
+    SHAPE_COUNTS      = 1 << 2,   // node and leaf counts
+    SHAPE_EQUAL_PATHS = 1 << 3,   // every leaf at the same depth, see equalPaths()
+    SHAPE_BALANCED    = 1 << 4,   // every node's subtrees differ in height by at most 1
+    SHAPE_ALL         = (1 << 5) - 1
+};
+
+/**
+ * Result of measureShape(). Fields whose metric was not requested are left
+ * at their defaults.
+ */
+struct TreeShape
+{
+    TreeShape() :
+        height(0), minLeafDepth(-1), maxLeafDepth(-1),
+        leafCount(0), nodeCount(0), equalPaths(true), balanced(true)
+    {}
+
+    int height;
+    int minLeafDepth;
+    int maxLeafDepth;
+    size_t leafCount;
+    size_t nodeCount;
+    bool equalPaths;
+    bool balanced;
+};
+
+/**
+ * Computes the requested shape metrics of the tree rooted at root in one
+ * O(n) pass that uses an explicit stack instead of recursion, so it also
+ * copes with degenerate trees. Works on any node type tree-walk.h can walk
+ * (the equal-paths.h Node, and the bst.h/avlbst.h nodes via
+ * TreeAccess::root()).
+ *
+ * @param metrics bitwise or of ShapeMetric values
+ */
+template<typename NodeT>
+TreeShape measureShape(NodeT* root, unsigned metrics = SHAPE_ALL)
+{
+    TreeShape shape;
+    if (root == nullptr)
+    {
+        return shape;
+    }
+
+    bool wantLeaves = (metrics & (SHAPE_LEAF_DEPTHS | SHAPE_EQUAL_PATHS | SHAPE_COUNTS)) != 0;
+    bool wantHeights = (metrics & (SHAPE_HEIGHT | SHAPE_BALANCED)) != 0;
+
+    //a frame is visited twice when heights are wanted: once on the way down and once after its children
+    struct Frame
+    {
+        NodeT* node;
+        int depth;
+        bool expanded;
+    };
+    std::vector<Frame> stack;
+    std::vector<int> heights;   //heights of finished subtrees, only used when wantHeights
+
+    Frame first = { root, 0, false };
+    stack.push_back(first);
+
+    while (!stack.empty())
+    {
+        Frame frame = stack.back();
+        stack.pop_back();
+
+        NodeT* left = walkLeft(frame.node);
+        NodeT* right = walkRight(frame.node);
+
+        if (frame.expanded)
+        {
+            //children pushed their heights in the order left, right
+            int rightHeight = (right != nullptr) ? heights.back() : 0;
+            if (right != nullptr)
+            {
+                heights.pop_back();
+            }
+            int leftHeight = (left != nullptr) ? heights.back() : 0;
+            if (left != nullptr)
+            {
+                heights.pop_back();
+            }
+
+            if (abs(leftHeight - rightHeight) > 1)
+            {
+                shape.balanced = false;
+            }
+            heights.push_back((leftHeight > rightHeight ? leftHeight : rightHeight) + 1);
+            continue;
+        }
+
+        ++shape.nodeCount;
+        if (wantLeaves && left == nullptr && right == nullptr)
+        {
+            ++shape.leafCount;
+            if (shape.minLeafDepth == -1 || frame.depth < shape.minLeafDepth)
+            {
+                shape.minLeafDepth = frame.depth;
+            }
+            if (frame.depth > shape.maxLeafDepth)
+            {
+                shape.maxLeafDepth = frame.depth;
+            }
+        }
+
+        if (wantHeights)
+        {
+            frame.expanded = true;
+            stack.push_back(frame);
+        }
+
+        //right goes on the stack first so the left subtree finishes (and pushes its height) first
+        if (right != nullptr)
+        {
+            Frame child = { right, frame.depth + 1, false };
+            stack.push_back(child);
+        }
+        if (left != nullptr)
+        {
+            Frame child = { left, frame.depth + 1, false };
+            stack.push_back(child);
+        }
+    }
+
+    if (wantHeights)
+    {
+        shape.height = heights.back();
+    }
+    shape.equalPaths = (shape.minLeafDepth == shape.maxLeafDepth);
+
+    //clear whatever was computed along the way but not asked for
+    if (!(metrics & SHAPE_HEIGHT))
+    {
+        shape.height = 0;
+    }
+    if (!(metrics & SHAPE_LEAF_DEPTHS))
+    {
+        shape.minLeafDepth = shape.maxLeafDepth = -1;
+    }
+    if (!(metrics & SHAPE_COUNTS))
+    {
+        shape.leafCount = shape.nodeCount = 0;
+    }
+    if (!(metrics & SHAPE_EQUAL_PATHS))
+    {
+        shape.equalPaths = true;
+    }
+    if (!(metrics & SHAPE_BALANCED))
+    {
+        shape.balanced = true;
+    }
+    return shape;
+}
+
+#endif
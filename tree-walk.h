@@ -0,0 +1,61 @@
+#ifndef TREE_WALK_H
+#define TREE_WALK_H
+
+/**
+ * Child accessors shared by the node-generic traversal helpers
+ * (equal-paths-fast.h, tree-shape.h, ...).
+ *
+ * The plain Node struct from equal-paths.h exposes its children as the
+ * public members left/right, while the search tree nodes from bst.h and
+ * avlbst.h use getLeft()/getRight(). walkLeft()/walkRight() pick the
+ * right spelling at compile time so one traversal template can run over
+ * either kind of node. The int/long overload trick prefers the member
+ * version when both would compile.
+ *
+ * This header deliberately does not include bst.h or equal-paths.h, since
+ * those two headers both declare a type called Node.
+ */
+
+template<typename NodeT>
+auto walkLeftImpl(NodeT* n, int) -> decltype(n->left)
+{
+    return n->left;
+}
+
+template<typename NodeT>
+auto walkLeftImpl(NodeT* n, long) -> decltype(n->getLeft())
+{
+    return n->getLeft();
+}
+
+template<typename NodeT>
+auto walkRightImpl(NodeT* n, int) -> decltype(n->right)
+{
+    return n->right;
+}
+
+template<typename NodeT>
+auto walkRightImpl(NodeT* n, long) -> decltype(n->getRight())
+{
+    return n->getRight();
+}
+
+/**
+ * Returns the left child of n, whichever node type it is.
+ */
+template<typename NodeT>
+auto walkLeft(NodeT* n) -> decltype(walkLeftImpl(n, 0))
+{
+    return walkLeftImpl(n, 0);
+}
+
+/**
+ * Returns the right child of n, whichever node type it is.
+ */
+template<typename NodeT>
+auto walkRight(NodeT* n) -> decltype(walkRightImpl(n, 0))
+{
+    return walkRightImpl(n, 0);
+}
+
+#endif